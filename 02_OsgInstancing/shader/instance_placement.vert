@@ -0,0 +1,66 @@
+#version 150 compatibility
+
+uniform uint hashedSeed;
+uniform uint gridHeight;
+uniform uint gridStepX;
+uniform uint gridStepY;
+uniform uint numTextureLayers;
+uniform vec2 yawTable[NUM_YAW_STEPS];
+uniform sampler2DRect heightMap;
+uniform usampler2DRect densityMap;
+uniform bool useHeightMap;
+uniform bool useDensityMap;
+
+flat out vec4 candidateRow0;
+flat out vec4 candidateRow1;
+flat out vec4 candidateRow2;
+flat out vec4 candidateRow3;
+flat out vec4 candidateTint;
+flat out vec4 candidateParams;
+flat out int candidatePlaced;
+
+// has to stay identical to ProceduralInstanceGenerator::hash
+uint hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+void main()
+{
+	// one candidate per point, see ProceduralInstanceGenerator::computeMatrix
+	uint instance = uint(gl_VertexID);
+	uint random = hash(instance ^ hashedSeed);
+
+	uvec2 fixedPosition = uvec2(instance / gridHeight, instance % gridHeight) * uvec2(gridStepX, gridStepY) +
+						  uvec2(random & 511u, (random >> 9) & 511u);
+	ivec2 nearestSample = useHeightMap ? min(ivec2((fixedPosition + 128u) / 256u), textureSize(heightMap) - 1) : ivec2(0);
+	float height = useHeightMap ? texelFetch(heightMap, nearestSample).r : 0.0;
+
+	vec2 yaw = yawTable[(random >> 18) & uint(NUM_YAW_STEPS - 1)];
+	float scale = float((random >> 24) % 10u + 1u);
+	float scaledCos = yaw.x * scale;
+	float scaledSin = yaw.y * scale;
+
+	// the rows of the osg matrix, which are the columns of the matrix in the shaders
+	candidateRow0 = vec4(scaledCos, scaledSin, 0.0, 0.0);
+	candidateRow1 = vec4(-scaledSin, scaledCos, 0.0, 0.0);
+	candidateRow2 = vec4(0.0, 0.0, scale, 0.0);
+	candidateRow3 = vec4(vec2(fixedPosition) * (2.0 / 256.0), height, 1.0);
+
+	// see ProceduralInstanceGenerator::computeAttributes
+	uint attributeRandom = hash(random);
+	float brightness = 0.8 + float((attributeRandom >> 18) & 255u) * (1.0 / 512.0);
+	candidateTint = vec4(brightness, brightness, 0.8 + float(attributeRandom >> 26) * (1.0 / 256.0), 1.0);
+	candidateParams = vec4(float(attributeRandom % numTextureLayers), float((attributeRandom >> 8) & 1023u) * (6.28318530718 / 1024.0), 1.0, 0.0);
+
+	// see ProceduralInstanceGenerator::isPlaced
+	uint density = useDensityMap ? texelFetch(densityMap, nearestSample).r : 255u;
+	candidatePlaced = (density == 255u || (hash(attributeRandom) & 255u) < density) ? 1 : 0;
+
+	gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+// shared by all instancing shaders, InstancedGeometryBuilder::readShaderSource inserts it after the version and
+// extension lines and the definitions, WIND_SWAY is defined there from InstanceBounds::WIND_SWAY
+uniform float osg_SimulationTime;
+uniform mat4 osg_ModelViewProjectionMatrix;
+uniform mat3 osg_NormalMatrix;
+uniform vec3 lightDirection;
+
+smooth out vec2 texCoord;
+smooth out vec3 normal;
+smooth out vec3 lightDir;
+flat out vec4 instanceColor;
+flat out float textureLayer;
+
+// let the top of the instance sway with its own wind phase
+vec4 swayVertex(vec4 position, float windPhase)
+{
+	position.x += sin(osg_SimulationTime + windPhase) * WIND_SWAY * position.z;
+	return position;
+}
+
+// writes the outputs besides the position, the params are (texture layer, wind phase, fade, 0) like InstanceAttributes
+void emitInstanceAttributes(vec4 instanceTint, vec4 instanceParams, vec2 vertexTexCoord, vec3 eyeNormal)
+{
+	texCoord = vertexTexCoord;
+	normal   = eyeNormal;
+	lightDir = lightDirection;
+	instanceColor = vec4(instanceTint.rgb, instanceTint.a * instanceParams.z);
+	textureLayer  = instanceParams.x;
+}
+
+// writes all outputs of one vertex of an instance
+void emitInstanceVertex(mat4 instanceModelMatrix, vec4 instanceTint, vec4 instanceParams, vec4 position, vec3 vertexNormal, vec2 vertexTexCoord)
+{
+	gl_Position = osg_ModelViewProjectionMatrix * instanceModelMatrix * swayVertex(position, instanceParams.y);
+	emitInstanceAttributes(instanceTint, instanceParams, vertexTexCoord, osg_NormalMatrix * mat3(instanceModelMatrix) * vertexNormal);
+}
\ No newline at end of file
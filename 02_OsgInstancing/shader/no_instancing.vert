@@ -1,15 +1,10 @@
 #version 150 compatibility
 
-uniform vec3 lightDirection;
-
-smooth out vec2 texCoord;
-smooth out vec3 normal;
-smooth out vec3 lightDir;
+uniform vec4 instanceAttributes[2];
 
 void main()
 {
-	gl_Position = gl_ModelViewProjectionMatrix *gl_Vertex;
-	texCoord = gl_MultiTexCoord0.xy;
-	normal   = gl_NormalMatrix * gl_Normal;
-	lightDir = lightDirection;
+	// the model matrix is part of the model view matrix of the transform above the instance
+	gl_Position = gl_ModelViewProjectionMatrix * swayVertex(gl_Vertex, instanceAttributes[1].y);
+	emitInstanceAttributes(instanceAttributes[0], instanceAttributes[1], gl_MultiTexCoord0.xy, gl_NormalMatrix * gl_Normal);
 }
\ No newline at end of file
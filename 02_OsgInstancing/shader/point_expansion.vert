@@ -0,0 +1,20 @@
+#version 150 compatibility
+uniform samplerBuffer instanceBuffer;
+
+flat out mat4 vInstanceModelMatrix;
+flat out vec4 vInstanceTint;
+flat out vec4 vInstanceParams;
+
+void main()
+{
+	// every point is one instance of the shared float instance data
+	int instanceTexel = gl_VertexID * TEXELS_PER_INSTANCE;
+	vInstanceModelMatrix = mat4(texelFetch(instanceBuffer, instanceTexel),
+								texelFetch(instanceBuffer, instanceTexel + 1),
+								texelFetch(instanceBuffer, instanceTexel + 2),
+								texelFetch(instanceBuffer, instanceTexel + 3));
+	vInstanceTint   = texelFetch(instanceBuffer, instanceTexel + 4);
+	vInstanceParams = texelFetch(instanceBuffer, instanceTexel + 5);
+
+	gl_Position = vInstanceModelMatrix[3];
+}
\ No newline at end of file
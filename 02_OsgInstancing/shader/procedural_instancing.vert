@@ -0,0 +1,52 @@
+#version 150 compatibility
+
+uniform uint hashedSeed;
+uniform uint gridHeight;
+uniform uint gridStepX;
+uniform uint gridStepY;
+uniform uint numTextureLayers;
+uniform vec2 yawTable[NUM_YAW_STEPS];
+uniform sampler2DRect heightMap;
+
+// has to stay identical to ProceduralInstanceGenerator::hash
+uint hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+void main()
+{
+	// everything is derived from the instance id, see ProceduralInstanceGenerator::computeMatrix
+	uint instance = uint(gl_InstanceID);
+	uint random = hash(instance ^ hashedSeed);
+
+	// fixed point position in 1/256 height map samples
+	uvec2 fixedPosition = uvec2(instance / gridHeight, instance % gridHeight) * uvec2(gridStepX, gridStepY) +
+						  uvec2(random & 511u, (random >> 9) & 511u);
+	ivec2 nearestSample = min(ivec2((fixedPosition + 128u) / 256u), textureSize(heightMap) - 1);
+	vec3 instancePosition = vec3(vec2(fixedPosition) * (2.0 / 256.0), texelFetch(heightMap, nearestSample).r);
+
+	vec2 yaw = yawTable[(random >> 18) & uint(NUM_YAW_STEPS - 1)];
+	float scale = float((random >> 24) % 10u + 1u);
+	float scaledCos = yaw.x * scale;
+	float scaledSin = yaw.y * scale;
+
+	mat4 instanceModelMatrix = mat4(vec4(scaledCos, scaledSin, 0.0, 0.0),
+									vec4(-scaledSin, scaledCos, 0.0, 0.0),
+									vec4(0.0, 0.0, scale, 0.0),
+									vec4(instancePosition, 1.0));
+
+	// see ProceduralInstanceGenerator::computeAttributes
+	uint attributeRandom = hash(random);
+	float brightness = 0.8 + float((attributeRandom >> 18) & 255u) * (1.0 / 512.0);
+	vec4 instanceTint = vec4(brightness, brightness, 0.8 + float(attributeRandom >> 26) * (1.0 / 256.0), 1.0);
+	float windPhase = float((attributeRandom >> 8) & 1023u) * (6.28318530718 / 1024.0);
+	vec4 instanceParams = vec4(float(attributeRandom % numTextureLayers), windPhase, 1.0, 0.0);
+
+	emitInstanceVertex(instanceModelMatrix, instanceTint, instanceParams, gl_Vertex, gl_Normal, gl_MultiTexCoord0.xy);
+}
\ No newline at end of file
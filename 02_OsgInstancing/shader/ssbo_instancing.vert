@@ -0,0 +1,20 @@
+#version 430 compatibility
+struct InstanceData
+{
+	mat4 modelMatrix;
+	vec4 tint;
+	vec4 params;
+};
+layout(std430, binding = 0) readonly buffer instanceData
+{
+	InstanceData instances[];
+};
+
+void main()
+{
+	mat4 _instanceModelMatrix = instances[gl_InstanceID].modelMatrix;
+	vec4 instanceTint   = instances[gl_InstanceID].tint;
+	vec4 instanceParams = instances[gl_InstanceID].params;
+
+	emitInstanceVertex(_instanceModelMatrix, instanceTint, instanceParams, gl_Vertex, gl_Normal, gl_MultiTexCoord0.xy);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 150 compatibility
+
+// position and normal are already in world space, the sway is the world space offset at full wind
+in vec3 vSway;
+in vec4 vInstanceTint;
+in vec3 vInstanceParams;
+
+void main()
+{
+	// let the top of the instance sway with its own wind phase
+	vec3 position = gl_Vertex.xyz + sin(osg_SimulationTime + vInstanceParams.y) * vSway;
+
+	gl_Position = osg_ModelViewProjectionMatrix * vec4(position, 1.0);
+	emitInstanceAttributes(vInstanceTint, vec4(vInstanceParams, 0.0), gl_MultiTexCoord0.xy, osg_NormalMatrix * gl_Normal);
+}
\ No newline at end of file
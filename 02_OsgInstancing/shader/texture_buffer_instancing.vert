@@ -0,0 +1,58 @@
+#version 150 compatibility
+#extension GL_ARB_shader_bit_encoding : enable
+#if defined(PACKED_INSTANCES) || defined(QUANTIZED_INSTANCES)
+uniform usamplerBuffer instanceBuffer;
+#else
+uniform samplerBuffer instanceBuffer;
+#endif
+#ifdef QUANTIZED_INSTANCES
+uniform vec3 chunkOrigin;
+uniform vec3 chunkExtent;
+uniform vec2 scaleRange;
+#endif
+
+void main()
+{
+	int instanceTexel = gl_InstanceID * TEXELS_PER_INSTANCE;
+#if defined(QUANTIZED_INSTANCES)
+	// (x | y << 16, z | yaw << 16 | scale << 26, rgba8 tint, layer | wind phase << 8 | fade << 16)
+	uvec4 quantized = texelFetch(instanceBuffer, instanceTexel);
+	vec3 instancePosition = chunkOrigin + vec3(quantized.x & 65535u, quantized.x >> 16, quantized.y & 65535u) / 65535.0 * chunkExtent;
+	float yaw   = float((quantized.y >> 16) & 1023u) / 1024.0 * 6.28318530718;
+	float scale = mix(scaleRange.x, scaleRange.y, float(quantized.y >> 26) / 63.0);
+	float scaledCos = cos(yaw) * scale;
+	float scaledSin = sin(yaw) * scale;
+
+	mat4 instanceModelMatrix = mat4(vec4(scaledCos, scaledSin, 0.0, 0.0),
+									vec4(-scaledSin, scaledCos, 0.0, 0.0),
+									vec4(0.0, 0.0, scale, 0.0),
+									vec4(instancePosition, 1.0));
+	vec4 instanceTint   = vec4((uvec4(quantized.z) >> uvec4(0u, 8u, 16u, 24u)) & 255u) / 255.0;
+	vec4 instanceParams = vec4(float(quantized.w & 255u),
+							   float((quantized.w >> 8) & 255u) / 256.0 * 6.28318530718,
+							   float((quantized.w >> 16) & 255u) / 255.0,
+							   0.0);
+#elif defined(PACKED_INSTANCES)
+	// three rows of an affine matrix followed by (rgba8 tint, layer, wind phase, fade)
+	vec4 row0 = uintBitsToFloat(texelFetch(instanceBuffer, instanceTexel));
+	vec4 row1 = uintBitsToFloat(texelFetch(instanceBuffer, instanceTexel + 1));
+	vec4 row2 = uintBitsToFloat(texelFetch(instanceBuffer, instanceTexel + 2));
+	uvec4 packedAttributes = texelFetch(instanceBuffer, instanceTexel + 3);
+
+	mat4 instanceModelMatrix = mat4(vec4(row0.x, row1.x, row2.x, 0.0),
+									vec4(row0.y, row1.y, row2.y, 0.0),
+									vec4(row0.z, row1.z, row2.z, 0.0),
+									vec4(row0.w, row1.w, row2.w, 1.0));
+	vec4 instanceTint   = vec4((uvec4(packedAttributes.x) >> uvec4(0u, 8u, 16u, 24u)) & 255u) / 255.0;
+	vec4 instanceParams = vec4(float(packedAttributes.y), uintBitsToFloat(packedAttributes.z), uintBitsToFloat(packedAttributes.w), 0.0);
+#else
+	mat4 instanceModelMatrix = mat4(texelFetch(instanceBuffer, instanceTexel),
+									texelFetch(instanceBuffer, instanceTexel + 1),
+									texelFetch(instanceBuffer, instanceTexel + 2),
+									texelFetch(instanceBuffer, instanceTexel + 3));
+	vec4 instanceTint   = texelFetch(instanceBuffer, instanceTexel + 4);
+	vec4 instanceParams = texelFetch(instanceBuffer, instanceTexel + 5);
+#endif
+
+	emitInstanceVertex(instanceModelMatrix, instanceTint, instanceParams, gl_Vertex, gl_Normal, gl_MultiTexCoord0.xy);
+}
\ No newline at end of file
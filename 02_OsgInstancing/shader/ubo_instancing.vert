@@ -1,27 +1,21 @@
 #version 150 compatibility
 #extension GL_ARB_uniform_buffer_object : enable
+struct InstanceData
+{
+	mat4 modelMatrix;
+	vec4 tint;
+	vec4 params;
+};
 layout(std140) uniform instanceData
 {
-	mat4 instanceModelMatrix[MAX_INSTANCES];
+	InstanceData instances[MAX_INSTANCES];
 };
-uniform mat4 osg_ModelViewProjectionMatrix;
-uniform mat3 osg_NormalMatrix;
-uniform vec3 lightDirection;
-
-smooth out vec2 texCoord;
-smooth out vec3 normal;
-smooth out vec3 lightDir;
 
 void main()
 {
-	mat4 _instanceModelMatrix = instanceModelMatrix[gl_InstanceID];
-	gl_Position = osg_ModelViewProjectionMatrix * _instanceModelMatrix * gl_Vertex;
-	texCoord = gl_MultiTexCoord0.xy;
-
-	mat3 normalMatrix = mat3(_instanceModelMatrix[0][0], _instanceModelMatrix[0][1], _instanceModelMatrix[0][2],
-							 _instanceModelMatrix[1][0], _instanceModelMatrix[1][1], _instanceModelMatrix[1][2],
-							 _instanceModelMatrix[2][0], _instanceModelMatrix[2][1], _instanceModelMatrix[2][2]);
+	mat4 _instanceModelMatrix = instances[gl_InstanceID].modelMatrix;
+	vec4 instanceTint   = instances[gl_InstanceID].tint;
+	vec4 instanceParams = instances[gl_InstanceID].params;
 
-	normal = osg_NormalMatrix * normalMatrix * gl_Normal;
-	lightDir = lightDirection;
+	emitInstanceVertex(_instanceModelMatrix, instanceTint, instanceParams, gl_Vertex, gl_Normal, gl_MultiTexCoord0.xy);
 }
\ No newline at end of file
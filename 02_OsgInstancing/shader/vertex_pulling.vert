@@ -0,0 +1,25 @@
+#version 150 compatibility
+
+uniform samplerBuffer instanceBuffer;
+uniform samplerBuffer vertexBuffer;
+uniform usamplerBuffer indexBuffer;
+uniform int firstVertex;
+uniform int firstIndex;
+
+void main()
+{
+	// nothing is bound as vertex attribute, the vertex id selects the index and the index the vertex
+	int vertexTexel = (firstVertex + int(texelFetch(indexBuffer, firstIndex + gl_VertexID).r)) * TEXELS_PER_VERTEX;
+	vec4 positionAndS = texelFetch(vertexBuffer, vertexTexel);
+	vec4 normalAndT   = texelFetch(vertexBuffer, vertexTexel + 1);
+
+	int instanceTexel = gl_InstanceID * TEXELS_PER_INSTANCE;
+	mat4 instanceModelMatrix = mat4(texelFetch(instanceBuffer, instanceTexel),
+									texelFetch(instanceBuffer, instanceTexel + 1),
+									texelFetch(instanceBuffer, instanceTexel + 2),
+									texelFetch(instanceBuffer, instanceTexel + 3));
+	vec4 instanceTint   = texelFetch(instanceBuffer, instanceTexel + 4);
+	vec4 instanceParams = texelFetch(instanceBuffer, instanceTexel + 5);
+
+	emitInstanceVertex(instanceModelMatrix, instanceTint, instanceParams, vec4(positionAndS.xyz, 1.0), normalAndT.xyz, vec2(positionAndS.w, normalAndT.w));
+}
\ No newline at end of file
@@ -40,6 +40,8 @@ public:
 
 	inline unsigned int getWidth() const { return m_width; }
 	inline unsigned int getHeight() const { return m_height; }
+	// width * height samples, row by row
+	inline const float* getHeightMap() const { return m_heightMap; }
 
 private:
 	float*			m_heightMap;
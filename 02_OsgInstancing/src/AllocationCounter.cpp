@@ -0,0 +1,105 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "AllocationCounter.h"
+
+// c-std
+#include <cstdlib>
+#include <new>
+
+// osg
+#include <OpenThreads/Atomic>
+
+namespace
+{
+
+OpenThreads::Atomic s_numAllocations;
+// only the counting thread allocates while the tests measure, so the sum doesn't need to be atomic
+size_t s_numBytes = 0;
+bool s_counting = false;
+
+void* allocate(std::size_t size)
+{
+	if (s_counting)
+	{
+		++s_numAllocations;
+		s_numBytes += size;
+	}
+
+	void* memory = malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void* memory) throw()
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) throw()
+{
+	free(memory);
+}
+
+namespace osgExample
+{
+
+void AllocationCounter::start()
+{
+	s_numAllocations.exchange(0);
+	s_numBytes = 0;
+	s_counting = true;
+}
+
+void AllocationCounter::stop()
+{
+	s_counting = false;
+}
+
+unsigned int AllocationCounter::getNumAllocations()
+{
+	return s_numAllocations;
+}
+
+size_t AllocationCounter::getNumBytes()
+{
+	return s_numBytes;
+}
+
+}
\ No newline at end of file
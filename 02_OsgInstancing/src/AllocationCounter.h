@@ -0,0 +1,49 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _ALLOCATION_COUNTER_H
+#define _ALLOCATION_COUNTER_H
+
+// c-std
+#include <cstddef>
+
+namespace osgExample
+{
+
+// Counts the heap allocations and their bytes between start and stop by replacing the global operator new.
+// Only the tests link it, the bytes are what was requested, freed memory isn't subtracted.
+class AllocationCounter
+{
+public:
+	static void start();
+	static void stop();
+
+	static unsigned int getNumAllocations();
+	static size_t getNumBytes();
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _ANIMATE_INSTANCES_UPDATE_CALLBACK_H
+#define _ANIMATE_INSTANCES_UPDATE_CALLBACK_H
+
+// std
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Drawable>
+#include <osg/NodeVisitor>
+#include <osg/FrameStamp>
+#include <osg/Matrix>
+
+// osgExample
+#include "InstancedDrawable.h"
+#include "InstanceAttributes.h"
+
+namespace osgExample
+{
+
+// rotates every instance back and forth around its up axis, the new matrices are written into the
+// dynamic instance buffer of the drawable every frame. A static drawable is hit by a gust of wind
+// instead, only a band of instances moving through the buffer is changed and uploaded every frame.
+class AnimateInstancesUpdateCallback : public osg::Drawable::UpdateCallback
+{
+public:
+	// the gust covers this share of the instances
+	static const unsigned int NUM_GUST_BANDS = 16;
+
+	AnimateInstancesUpdateCallback(const std::vector<osg::Matrixd>& matrices, const std::vector<InstanceAttributes>& attributes)
+		:	m_matrices(matrices.begin(), matrices.end()),
+			m_attributes(attributes)
+	{
+	}
+
+	virtual void update(osg::NodeVisitor* nv, osg::Drawable* drawable)
+	{
+		InstancedDrawable* instancedDrawable = dynamic_cast<InstancedDrawable*>(drawable);
+
+		if (!instancedDrawable || !nv->getFrameStamp() || m_matrices.empty())
+			return;
+
+		float time = (float)nv->getFrameStamp()->getSimulationTime();
+
+		if (!instancedDrawable->getDynamic())
+		{
+			// setMatrix marks the changed instances dirty, the band is uploaded as one range
+			unsigned int bandSize = (m_matrices.size() + NUM_GUST_BANDS - 1) / NUM_GUST_BANDS;
+			unsigned int start = (nv->getFrameStamp()->getFrameNumber() % NUM_GUST_BANDS) * bandSize;
+			unsigned int end = std::min(start + bandSize, (unsigned int)m_matrices.size());
+			for (unsigned int i = start; i < end; ++i)
+			{
+				instancedDrawable->setMatrix(i, computeMatrix(i, time));
+			}
+			return;
+		}
+
+		float* data = instancedDrawable->beginInstanceUpdate();
+
+		if (!data)
+			return;
+
+		for (unsigned int i = 0; i < m_matrices.size(); ++i)
+		{
+			osg::Matrixf matrix = computeMatrix(i, time);
+
+			float* instance = data + i * InstancedDrawable::FLOATS_PER_INSTANCE;
+			memcpy(instance, matrix.ptr(), 16 * sizeof(float));
+			m_attributes[i].pack(instance + 16);
+		}
+
+		instancedDrawable->endInstanceUpdate();
+	}
+
+private:
+	inline osg::Matrixf computeMatrix(unsigned int index, float time) const
+	{
+		float angle = sinf(time + m_attributes[index].windPhase) * 0.2f;
+		return osg::Matrixf::rotate(angle, osg::Vec3f(0.0f, 0.0f, 1.0f)) * m_matrices[index];
+	}
+
+	std::vector<osg::Matrixf>		m_matrices;
+	std::vector<InstanceAttributes> m_attributes;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BufferSubAllocator.h"
+
+// std
+#include <algorithm>
+
+namespace osgExample
+{
+
+BufferSubAllocator::BufferSubAllocator()
+	:	m_capacity(0u),
+		m_allocatedSize(0u)
+{
+}
+
+unsigned int BufferSubAllocator::allocate(unsigned int size)
+{
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+	{
+		if (it->second < size)
+			continue;
+
+		// take the front of the first range that fits
+		unsigned int offset = it->first;
+		unsigned int remaining = it->second - size;
+		m_freeRanges.erase(it);
+		if (remaining > 0)
+			m_freeRanges[offset + size] = remaining;
+
+		m_allocatedSize += size;
+		return offset;
+	}
+
+	// nothing fits, so the buffer at least doubles and the new space joins a free range at its end
+	unsigned int oldCapacity = m_capacity;
+	m_capacity = std::max(m_capacity * 2, m_capacity + size);
+	addFreeRange(oldCapacity, m_capacity - oldCapacity);
+
+	return allocate(size);
+}
+
+void BufferSubAllocator::free(unsigned int offset, unsigned int size)
+{
+	if (size == 0)
+		return;
+
+	m_allocatedSize -= size;
+	addFreeRange(offset, size);
+}
+
+void BufferSubAllocator::addFreeRange(unsigned int offset, unsigned int size)
+{
+	// merge with the following free range
+	auto next = m_freeRanges.find(offset + size);
+	if (next != m_freeRanges.end())
+	{
+		size += next->second;
+		m_freeRanges.erase(next);
+	}
+
+	// and with the preceding one
+	auto it = m_freeRanges.lower_bound(offset);
+	if (it != m_freeRanges.begin())
+	{
+		--it;
+		if (it->first + it->second == offset)
+		{
+			it->second += size;
+			return;
+		}
+	}
+
+	m_freeRanges[offset] = size;
+}
+
+}
\ No newline at end of file
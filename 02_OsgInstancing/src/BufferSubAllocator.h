@@ -0,0 +1,60 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _BUFFER_SUB_ALLOCATOR_H
+#define _BUFFER_SUB_ALLOCATOR_H
+
+// std
+#include <map>
+
+namespace osgExample
+{
+
+// First fit allocator for ranges of one large buffer. It only does the bookkeeping, the owner of the buffer
+// grows it whenever getCapacity increases. Sizes and offsets are in elements, not bytes.
+class BufferSubAllocator
+{
+public:
+	BufferSubAllocator();
+
+	// returns the offset of a free range of size elements, grows the capacity if nothing fits
+	unsigned int allocate(unsigned int size);
+	// gives the range back, adjacent free ranges are merged
+	void free(unsigned int offset, unsigned int size);
+
+	inline unsigned int getCapacity() const { return m_capacity; }
+	inline unsigned int getAllocatedSize() const { return m_allocatedSize; }
+
+private:
+	void addFreeRange(unsigned int offset, unsigned int size);
+
+	// free ranges by offset
+	std::map<unsigned int, unsigned int> m_freeRanges;
+	unsigned int m_capacity;
+	unsigned int m_allocatedSize;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,176 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "CameraPathReplay.h"
+
+// std
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+// osg
+#include <osg/Timer>
+#include <osg/Stats>
+
+// osgExample
+#include "InstanceStatistics.h"
+
+namespace osgExample
+{
+
+CameraPathReplay::CameraPathReplay()
+	:	m_frameStep(1.0 / 60.0)
+{
+}
+
+bool CameraPathReplay::load(const std::string& fileName)
+{
+	std::ifstream file(fileName.c_str());
+	if (!file)
+	{
+		std::cout << "Error could not load camera path: " << fileName << std::endl;
+		return false;
+	}
+
+	m_path = new osg::AnimationPath;
+	m_path->read(file);
+	if (m_path->empty())
+	{
+		std::cout << "Error camera path is empty: " << fileName << std::endl;
+		m_path = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void CameraPathReplay::run(osgViewer::Viewer& viewer)
+{
+	m_timings.clear();
+	if (!m_path.valid() || m_frameStep <= 0.0)
+		return;
+
+	// the timings of a frame must not overlap with the next one
+	viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+	if (!viewer.isRealized())
+		viewer.realize();
+
+	unsigned int numFrames = (unsigned int)(m_path->getPeriod() / m_frameStep) + 1;
+	const unsigned int numLagFrames = 4;
+
+	// keep the stats of all frames, the gpu times arrive a few frames late
+	osg::Stats* cameraStats = viewer.getCamera()->getStats();
+	osg::Stats* viewerStats = viewer.getViewerStats();
+	if (cameraStats)
+	{
+		cameraStats->allocate(numFrames + numLagFrames + 1);
+		cameraStats->collectStats("rendering", true);
+		cameraStats->collectStats("gpu", true);
+	}
+	if (viewerStats)
+		viewerStats->allocate(numFrames + numLagFrames + 1);
+
+	std::vector<unsigned int> frameNumbers;
+	for (unsigned int i = 0; i < numFrames + numLagFrames && !viewer.done(); ++i)
+	{
+		double time = std::min(i, numFrames - 1) * m_frameStep;
+		osg::Matrixd viewMatrix;
+		m_path->getInverse(m_path->getFirstTime() + time, viewMatrix);
+		viewer.getCamera()->setViewMatrix(viewMatrix);
+
+		osg::Timer_t startTick = osg::Timer::instance()->tick();
+		viewer.frame(time);
+		double frameTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+		if (i < numFrames)
+		{
+			FrameTiming timing;
+			timing.time = time;
+			timing.frameTime = frameTime;
+			m_timings.push_back(timing);
+			frameNumbers.push_back(viewer.getFrameStamp()->getFrameNumber());
+		}
+	}
+
+	// missing values stay at -1
+	for (unsigned int i = 0; i < m_timings.size(); ++i)
+	{
+		FrameTiming& timing = m_timings[i];
+		timing.cullTime = timing.drawTime = timing.gpuTime = -1.0;
+		timing.visibleInstances = timing.drawCalls = -1.0;
+		timing.techniqueGpuTime = timing.maxChunkGpuTime = -1.0;
+		if (cameraStats)
+		{
+			if (cameraStats->getAttribute(frameNumbers[i], "Cull traversal time taken", timing.cullTime))
+				timing.cullTime *= 1000.0;
+			if (cameraStats->getAttribute(frameNumbers[i], "Draw traversal time taken", timing.drawTime))
+				timing.drawTime *= 1000.0;
+			if (cameraStats->getAttribute(frameNumbers[i], "GPU draw time taken", timing.gpuTime))
+				timing.gpuTime *= 1000.0;
+		}
+		if (viewerStats)
+		{
+			viewerStats->getAttribute(frameNumbers[i], InstanceStatistics::VISIBLE_INSTANCES, timing.visibleInstances);
+			viewerStats->getAttribute(frameNumbers[i], InstanceStatistics::DRAW_CALLS, timing.drawCalls);
+			viewerStats->getAttribute(frameNumbers[i], InstanceStatistics::TECHNIQUE_GPU_TIME, timing.techniqueGpuTime);
+			viewerStats->getAttribute(frameNumbers[i], InstanceStatistics::MAX_CHUNK_GPU_TIME, timing.maxChunkGpuTime);
+		}
+	}
+}
+
+bool CameraPathReplay::writeTiming(const std::string& fileName) const
+{
+	std::ofstream file(fileName.c_str());
+	if (!file)
+		return false;
+
+	file << "frame,time,frame_ms,cull_ms,draw_ms,gpu_ms,visible_instances,draw_calls,technique_gpu_ms,max_chunk_gpu_ms" << std::endl;
+	for (unsigned int i = 0; i < m_timings.size(); ++i)
+	{
+		const FrameTiming& timing = m_timings[i];
+		file << i << "," << timing.time << "," << timing.frameTime << "," << timing.cullTime << "," << timing.drawTime << ","
+			 << timing.gpuTime << "," << timing.visibleInstances << "," << timing.drawCalls << ","
+			 << timing.techniqueGpuTime << "," << timing.maxChunkGpuTime << std::endl;
+	}
+
+	return true;
+}
+
+void CameraPathReplay::printSummary() const
+{
+	if (m_timings.empty())
+		return;
+
+	double frameTime = 0.0;
+	double maxFrameTime = 0.0;
+	for (unsigned int i = 0; i < m_timings.size(); ++i)
+	{
+		frameTime += m_timings[i].frameTime;
+		maxFrameTime = std::max(maxFrameTime, m_timings[i].frameTime);
+	}
+
+	std::cout << "Replayed " << m_timings.size() << " frames, " << frameTime / m_timings.size() << " ms per frame on average, "
+			  << maxFrameTime << " ms at most" << std::endl;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _CAMERA_PATH_REPLAY_H
+#define _CAMERA_PATH_REPLAY_H
+
+// std
+#include <string>
+#include <vector>
+
+// osg
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/AnimationPath>
+#include <osgViewer/Viewer>
+
+namespace osgExample
+{
+
+// Drives the camera of a viewer along a recorded camera path(the format of the osgViewer::RecordCameraPathHandler)
+// with a fixed time step per frame. Every replay renders exactly the same views no matter how fast the frames are,
+// so together with a fixed seed two runs can be compared frame by frame.
+class CameraPathReplay : public osg::Referenced
+{
+public:
+	CameraPathReplay();
+
+	bool load(const std::string& fileName);
+
+	// simulated seconds between two frames
+	inline void setFrameStep(double frameStep) { m_frameStep = frameStep; }
+	inline double getFrameStep() const { return m_frameStep; }
+
+	// renders one frame per step from the start to the end of the path, the viewer must not have a camera manipulator
+	void run(osgViewer::Viewer& viewer);
+
+	// one line per frame with its time on the path and its timings in milliseconds
+	bool writeTiming(const std::string& fileName) const;
+	void printSummary() const;
+
+private:
+	struct FrameTiming
+	{
+		double	time;
+		double	frameTime;
+		double	cullTime;
+		double	drawTime;
+		double	gpuTime;
+		double	visibleInstances;
+		double	drawCalls;
+		double	techniqueGpuTime;
+		double	maxChunkGpuTime;
+	};
+
+	osg::ref_ptr<osg::AnimationPath>	m_path;
+	double								m_frameStep;
+	std::vector<FrameTiming>			m_timings;
+};
+
+}
+
+#endif
\ No newline at end of file
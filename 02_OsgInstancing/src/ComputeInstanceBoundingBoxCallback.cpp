@@ -37,21 +37,22 @@ osg::BoundingBox ComputeInstancedBoundingBoxCallback::computeBound(const osg::Dr
 	if (!geometry)
 		return bounds;
 
-	const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+	m_bounds.setLocalBound(InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray())));
 
-	for (unsigned int i = 0; i < m_instanceMatrices->getNumElements(); ++i)
+	// only read the matrices back from the uniform if it changed since the last time
+	const osg::FloatArray* data = m_instanceMatrices->getFloatArray();
+	if (data && m_modifiedCount != m_instanceMatrices->getModifiedCount())
 	{
-		osg::Matrixd matrix;
-		m_instanceMatrices->getElement(i, matrix);
-
-
-		for (auto it = vertices->begin(); it != vertices->end(); ++it)
+		m_modifiedCount = m_instanceMatrices->getModifiedCount();
+		m_matrices.resize(m_instanceMatrices->getNumElements());
+		for (unsigned int i = 0; i < m_matrices.size(); ++i)
 		{
-			bounds.expandBy(*it * matrix);
+			m_matrices[i].set(&data->at(i * 16));
 		}
+		m_bounds.dirtyAll();
 	}
 
-	return bounds;
+	return m_bounds.computeBound(m_matrices);
 }
 
 }
\ No newline at end of file
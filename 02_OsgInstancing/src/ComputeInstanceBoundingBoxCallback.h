@@ -29,6 +29,9 @@
 #include <osg/Uniform>
 #include <osg/Drawable>
 
+// osgExample
+#include "InstanceBounds.h"
+
 namespace osgExample
 {
 
@@ -36,13 +39,22 @@ class ComputeInstancedBoundingBoxCallback : public osg::Drawable::ComputeBoundin
 {
 public:
 	ComputeInstancedBoundingBoxCallback(osg::ref_ptr<osg::Uniform> instanceMatrices)
-		: m_instanceMatrices(instanceMatrices)
+		: m_instanceMatrices(instanceMatrices),
+		  m_modifiedCount(~0u)
 	{
 	}
 
 	virtual osg::BoundingBox computeBound(const osg::Drawable& drawable) const;
+
+	// bytes of the matrix copy and the cached block bounds
+	inline size_t getMemoryUsage() const { return m_matrices.capacity() * sizeof(osg::Matrixd) + m_bounds.getMemoryUsage(); }
 private:
 	osg::ref_ptr<osg::Uniform> m_instanceMatrices;
+
+	// matrices read from the uniform the last time it was modified
+	mutable std::vector<osg::Matrixd>	m_matrices;
+	mutable unsigned int				m_modifiedCount;
+	mutable InstanceBounds				m_bounds;
 };
 
 }
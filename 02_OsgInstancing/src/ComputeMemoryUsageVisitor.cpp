@@ -0,0 +1,168 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ComputeMemoryUsageVisitor.h"
+
+// osg
+#include <osg/Texture>
+#include <osg/Image>
+#include <osg/Uniform>
+#include <osg/BufferIndexBinding>
+
+// osgExample
+#include "InstancedDrawable.h"
+#include "ComputeInstanceBoundingBoxCallback.h"
+#include "ComputeTextureBoundingBoxCallback.h"
+
+namespace osgExample
+{
+
+ComputeMemoryUsageVisitor::ComputeMemoryUsageVisitor(MemoryUsage& usage)
+	:	osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+		m_usage(usage)
+{
+}
+
+void ComputeMemoryUsageVisitor::apply(osg::Node& node)
+{
+	applyStateSet(node.getStateSet());
+	traverse(node);
+}
+
+void ComputeMemoryUsageVisitor::apply(osg::Geode& geode)
+{
+	applyStateSet(geode.getStateSet());
+	for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
+	{
+		applyStateSet(geode.getDrawable(i)->getStateSet());
+		applyDrawable(geode.getDrawable(i));
+	}
+}
+
+void ComputeMemoryUsageVisitor::applyStateSet(const osg::StateSet* stateSet)
+{
+	// the software technique shares one state set between all its instances
+	if (!stateSet || !m_usage.addOnce(stateSet, MemoryUsage::TEXTURES, 0, 0))
+		return;
+
+	const osg::StateSet::TextureAttributeList& textureAttributes = stateSet->getTextureAttributeList();
+	for (unsigned int unit = 0; unit < textureAttributes.size(); ++unit)
+	{
+		for (osg::StateSet::AttributeList::const_iterator itr = textureAttributes[unit].begin(); itr != textureAttributes[unit].end(); ++itr)
+		{
+			const osg::Texture* texture = dynamic_cast<const osg::Texture*>(itr->second.first.get());
+			if (!texture)
+				continue;
+
+			// images that only point into the instance data or the mesh pool own no memory, but all are uploaded
+			size_t cpuBytes = 0;
+			size_t gpuBytes = 0;
+			for (unsigned int i = 0; i < texture->getNumImages(); ++i)
+			{
+				const osg::Image* image = texture->getImage(i);
+				if (!image)
+					continue;
+
+				gpuBytes += image->getTotalSizeInBytesIncludingMipmaps();
+				if (image->getAllocationMode() != osg::Image::NO_DELETE)
+					cpuBytes += image->getTotalSizeInBytesIncludingMipmaps();
+			}
+			m_usage.addOnce(texture, MemoryUsage::TEXTURES, cpuBytes, gpuBytes);
+		}
+	}
+
+	// the bindings of a shared buffer cover disjoint ranges, so their sizes add up to the buffer
+	const osg::StateSet::AttributeList& attributes = stateSet->getAttributeList();
+	for (osg::StateSet::AttributeList::const_iterator itr = attributes.begin(); itr != attributes.end(); ++itr)
+	{
+		const osg::BufferIndexBinding* binding = dynamic_cast<const osg::BufferIndexBinding*>(itr->second.first.get());
+		if (binding)
+			m_usage.addOnce(binding, MemoryUsage::BUFFER_BINDINGS, 0, binding->getSize());
+	}
+
+	const osg::StateSet::UniformList& uniforms = stateSet->getUniformList();
+	for (osg::StateSet::UniformList::const_iterator itr = uniforms.begin(); itr != uniforms.end(); ++itr)
+	{
+		const osg::Uniform* uniform = itr->second.first.get();
+		size_t bytes = 0;
+		if (uniform->getFloatArray())
+			bytes += uniform->getFloatArray()->getTotalDataSize();
+		if (uniform->getDoubleArray())
+			bytes += uniform->getDoubleArray()->getTotalDataSize();
+		if (uniform->getIntArray())
+			bytes += uniform->getIntArray()->getTotalDataSize();
+		if (uniform->getUIntArray())
+			bytes += uniform->getUIntArray()->getTotalDataSize();
+		m_usage.addOnce(uniform, MemoryUsage::UNIFORMS, bytes, bytes);
+	}
+}
+
+void ComputeMemoryUsageVisitor::applyDrawable(const osg::Drawable* drawable)
+{
+	if (!m_usage.addOnce(drawable, MemoryUsage::OSG_ARRAYS, 0, 0))
+		return;
+
+	const InstancedDrawable* instancedDrawable = dynamic_cast<const InstancedDrawable*>(drawable);
+	if (instancedDrawable)
+		instancedDrawable->computeMemoryUsage(m_usage);
+
+	const osg::Geometry* geometry = drawable->asGeometry();
+	if (geometry)
+		applyGeometry(geometry);
+
+	const osg::Drawable::ComputeBoundingBoxCallback* callback = drawable->getComputeBoundingBoxCallback();
+	if (const ComputeInstancedBoundingBoxCallback* instancedCallback = dynamic_cast<const ComputeInstancedBoundingBoxCallback*>(callback))
+		m_usage.addOnce(instancedCallback, MemoryUsage::BOUNDS_MATRICES, instancedCallback->getMemoryUsage(), 0);
+	else if (const ComputeTextureBoundingBoxCallback* textureCallback = dynamic_cast<const ComputeTextureBoundingBoxCallback*>(callback))
+		m_usage.addOnce(textureCallback, MemoryUsage::BOUNDS_MATRICES, textureCallback->getMemoryUsage(), 0);
+}
+
+void ComputeMemoryUsageVisitor::applyGeometry(const osg::Geometry* geometry)
+{
+	bool useVertexBufferObjects = geometry->getUseVertexBufferObjects();
+	applyArray(geometry->getVertexArray(), useVertexBufferObjects);
+	applyArray(geometry->getNormalArray(), useVertexBufferObjects);
+	applyArray(geometry->getColorArray(), useVertexBufferObjects);
+	applyArray(geometry->getSecondaryColorArray(), useVertexBufferObjects);
+	applyArray(geometry->getFogCoordArray(), useVertexBufferObjects);
+	for (unsigned int i = 0; i < geometry->getNumTexCoordArrays(); ++i)
+		applyArray(geometry->getTexCoordArray(i), useVertexBufferObjects);
+	for (unsigned int i = 0; i < geometry->getNumVertexAttribArrays(); ++i)
+		applyArray(geometry->getVertexAttribArray(i), useVertexBufferObjects);
+
+	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+	{
+		const osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+		size_t bytes = primitiveSet->getTotalDataSize();
+		m_usage.addOnce(primitiveSet, MemoryUsage::OSG_ARRAYS, bytes, useVertexBufferObjects ? bytes : 0);
+	}
+}
+
+void ComputeMemoryUsageVisitor::applyArray(const osg::Array* array, bool useVertexBufferObjects)
+{
+	if (array)
+		m_usage.addOnce(array, MemoryUsage::OSG_ARRAYS, array->getTotalDataSize(), useVertexBufferObjects ? array->getTotalDataSize() : 0);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _COMPUTE_MEMORY_USAGE_VISITOR_H
+#define _COMPUTE_MEMORY_USAGE_VISITOR_H
+
+// osg
+#include <osg/NodeVisitor>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/StateSet>
+
+// osgExample
+#include "MemoryUsage.h"
+
+namespace osgExample
+{
+
+// Adds the arrays, textures, uniforms, buffer bindings and InstancedDrawables of a subgraph to a MemoryUsage,
+// including the switched off children. Objects shared between nodes count once.
+class ComputeMemoryUsageVisitor : public osg::NodeVisitor
+{
+public:
+	ComputeMemoryUsageVisitor(MemoryUsage& usage);
+
+	virtual void apply(osg::Node& node);
+	virtual void apply(osg::Geode& geode);
+
+	// for state sets above the visited subgraph
+	void applyStateSet(const osg::StateSet* stateSet);
+
+private:
+	void applyDrawable(const osg::Drawable* drawable);
+	void applyGeometry(const osg::Geometry* geometry);
+	void applyArray(const osg::Array* array, bool useVertexBufferObjects);
+
+	MemoryUsage& m_usage;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -26,6 +26,7 @@
 
 // osgExample
 #include "ComputeTextureBoundingBoxCallback.h"
+#include "InstancedDrawable.h"
 
 namespace osgExample
 {
@@ -38,14 +39,20 @@ osg::BoundingBox ComputeTextureBoundingBoxCallback::computeBound(const osg::Draw
 	if (!geometry)
 		return bounds;
 
-	const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+	// the matrices never change, so the blocks are only recomputed if the mesh changes
+	if (m_localBound.valid())
+		m_bounds.setLocalBound(m_localBound);
+	else
+		m_bounds.setLocalBound(InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray())));
 
-	for (unsigned int i = 0; i < m_instanceMatrices.size(); ++i)
+	if (m_start >= m_end || m_end * InstancedDrawable::FLOATS_PER_INSTANCE > m_instanceData->size())
+		return bounds;
+
+	bounds = m_bounds.computeBound(&(*m_instanceData)[m_start * InstancedDrawable::FLOATS_PER_INSTANCE], m_end - m_start, InstancedDrawable::FLOATS_PER_INSTANCE);
+	if (bounds.valid())
 	{
-		for (auto it = vertices->begin(); it != vertices->end(); ++it)
-		{
-			bounds.expandBy(*it * m_instanceMatrices[i]);
-		}
+		bounds._min -= osg::Vec3(m_padding, m_padding, m_padding);
+		bounds._max += osg::Vec3(m_padding, m_padding, m_padding);
 	}
 
 	return bounds;
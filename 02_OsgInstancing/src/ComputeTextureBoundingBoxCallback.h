@@ -24,27 +24,53 @@
 #ifndef _COMPUTE_TEXTURE_BOUNDING_BOX_CALLBACK_H
 #define _COMPUTE_TEXTURE_BOUNDING_BOX_CALLBACK_H
 
-// std
-#include <vector>
-
 // osg
-#include <osg/Matrixd>
+#include <osg/ref_ptr>
+#include <osg/Array>
 #include <osg/Drawable>
 
+// osgExample
+#include "InstanceBounds.h"
+
 namespace osgExample
 {
 
+// Bounding box of the instances [start, end) of the shared instance data, which stays alive with the callback
 class ComputeTextureBoundingBoxCallback : public osg::Drawable::ComputeBoundingBoxCallback
 {
 public:
-	ComputeTextureBoundingBoxCallback(std::vector<osg::Matrixd> instanceMatrices)
-		: m_instanceMatrices(instanceMatrices)
+	ComputeTextureBoundingBoxCallback(osg::ref_ptr<const osg::FloatArray> instanceData, unsigned int start, unsigned int end)
+		: m_instanceData(instanceData),
+		  m_start(start),
+		  m_end(end),
+		  m_padding(0.0f)
+	{
+	}
+
+	// for drawables that have no mesh of their own, e.g. points expanded in a geometry shader
+	ComputeTextureBoundingBoxCallback(osg::ref_ptr<const osg::FloatArray> instanceData, unsigned int start, unsigned int end, const osg::BoundingBox& localBound)
+		: m_instanceData(instanceData),
+		  m_start(start),
+		  m_end(end),
+		  m_localBound(localBound),
+		  m_padding(0.0f)
 	{
 	}
 
 		virtual osg::BoundingBox computeBound(const osg::Drawable& drawable) const;
+
+	// the box grows by this distance on every side, e.g. for instances the shader decodes with an error
+	inline void setPadding(float padding) { m_padding = padding; }
+
+	// bytes of the cached block bounds, the instance data belongs to the builder
+	inline size_t getMemoryUsage() const { return m_bounds.getMemoryUsage(); }
 private:
-	std::vector<osg::Matrixd> m_instanceMatrices;
+	osg::ref_ptr<const osg::FloatArray> m_instanceData;
+	unsigned int m_start;
+	unsigned int m_end;
+	osg::BoundingBox m_localBound;
+	float m_padding;
+	mutable InstanceBounds m_bounds;
 };
 
 }
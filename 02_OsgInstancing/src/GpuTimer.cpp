@@ -0,0 +1,133 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+// glew
+#include <GL/glew.h>
+
+// std
+#include <algorithm>
+
+// osg
+#include <osg/State>
+#include <osg/FrameStamp>
+
+// osgExample
+#include "GpuTimer.h"
+
+namespace osgExample
+{
+
+GpuTimer::QueryPool::QueryPool()
+	:	frameNumber(~0u),
+		numUsed(0u),
+		overflow(false),
+		active(false)
+{
+}
+
+GpuTimer::GpuTimer(osg::ref_ptr<InstanceStatistics> statistics)
+	:	m_statistics(statistics)
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+	// the queries die with their context, the timer lives as long as the viewer anyway
+}
+
+void GpuTimer::begin(osg::RenderInfo& renderInfo)
+{
+	const osg::FrameStamp* frameStamp = renderInfo.getState()->getFrameStamp();
+	if (!GLEW_ARB_timer_query || !frameStamp)
+		return;
+
+	unsigned int frameNumber = frameStamp->getFrameNumber();
+	QueryPool& pool = m_contextData[renderInfo.getContextID()].pools[frameNumber % 2];
+	if (pool.frameNumber != frameNumber)
+	{
+		collect(pool);
+		pool.frameNumber = frameNumber;
+		pool.numUsed = 0u;
+		pool.overflow = false;
+	}
+
+	if (pool.numUsed == MAX_QUERIES_PER_FRAME)
+	{
+		pool.overflow = true;
+		return;
+	}
+
+	if (pool.numUsed == pool.queries.size())
+	{
+		GLuint query = 0u;
+		glGenQueries(1, &query);
+		pool.queries.push_back(query);
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, pool.queries[pool.numUsed]);
+	pool.active = true;
+}
+
+void GpuTimer::end(osg::RenderInfo& renderInfo)
+{
+	const osg::FrameStamp* frameStamp = renderInfo.getState()->getFrameStamp();
+	if (!GLEW_ARB_timer_query || !frameStamp)
+		return;
+
+	QueryPool& pool = m_contextData[renderInfo.getContextID()].pools[frameStamp->getFrameNumber() % 2];
+	if (!pool.active)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	pool.active = false;
+	++pool.numUsed;
+}
+
+void GpuTimer::collect(QueryPool& pool) const
+{
+	if (pool.numUsed == 0u || pool.overflow)
+		return;
+
+	// the queries finish in order, a gpu that is more than a frame behind costs this frame its result
+	GLint available = 0;
+	glGetQueryObjectiv(pool.queries[pool.numUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	double totalTime = 0.0;
+	double maxTime = 0.0;
+	for (unsigned int i = 0; i < pool.numUsed; ++i)
+	{
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(pool.queries[i], GL_QUERY_RESULT, &nanoseconds);
+		double time = nanoseconds / 1000000.0;
+		totalTime += time;
+		maxTime = std::max(maxTime, time);
+	}
+
+	m_statistics->add(pool.frameNumber, InstanceStatistics::TECHNIQUE_GPU_TIME, totalTime);
+	m_statistics->setMax(pool.frameNumber, InstanceStatistics::MAX_CHUNK_GPU_TIME, maxTime);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _GPU_TIMER_H
+#define _GPU_TIMER_H
+
+// std
+#include <vector>
+
+// osg
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/RenderInfo>
+#include <osg/buffered_value>
+
+// osgExample
+#include "InstanceStatistics.h"
+
+namespace osgExample
+{
+
+// Measures the gpu time of draws with GL_TIME_ELAPSED queries, every draw between begin and end gets its own
+// query from the pool of its frame. There are two pools per context, the one of the frame before last is read
+// when its turn comes again, so the results are two frames old and reading them never waits for the gpu.
+// The sum and the slowest draw of a frame go into the statistics of that frame. Draws must not overlap with
+// another GL_TIME_ELAPSED query, the viewer stats use timestamps for that reason.
+class GpuTimer : public osg::Referenced
+{
+public:
+	// frames with more draws are not measured at all instead of giving a partial sum, e.g. the software technique
+	static const unsigned int MAX_QUERIES_PER_FRAME = 4096u;
+
+	GpuTimer(osg::ref_ptr<InstanceStatistics> statistics);
+
+	// both need the context of the draw to be current, without GL_ARB_timer_query they do nothing
+	void begin(osg::RenderInfo& renderInfo);
+	void end(osg::RenderInfo& renderInfo);
+
+protected:
+	virtual ~GpuTimer();
+
+private:
+	struct QueryPool
+	{
+		QueryPool();
+
+		unsigned int		frameNumber;
+		std::vector<GLuint>	queries;
+		unsigned int		numUsed;
+		bool				overflow;
+		bool				active;
+	};
+
+	struct ContextData
+	{
+		QueryPool pools[2];
+	};
+
+	// adds the results of the pool to the statistics of its frame if they are all available
+	void collect(QueryPool& pool) const;
+
+	osg::buffered_object<ContextData>	m_contextData;
+	osg::ref_ptr<InstanceStatistics>	m_statistics;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _GPU_TIMER_DRAW_CALLBACK_H
+#define _GPU_TIMER_DRAW_CALLBACK_H
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Drawable>
+
+// osgExample
+#include "GpuTimer.h"
+
+namespace osgExample
+{
+
+// Measures every draw of a chunk with the timer of its technique.
+class GpuTimerDrawCallback : public osg::Drawable::DrawCallback
+{
+public:
+	GpuTimerDrawCallback(osg::ref_ptr<GpuTimer> timer)
+		:	m_timer(timer)
+	{
+	}
+
+	virtual void drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable* drawable) const
+	{
+		m_timer->begin(renderInfo);
+		drawable->drawImplementation(renderInfo);
+		m_timer->end(renderInfo);
+	}
+
+private:
+	osg::ref_ptr<GpuTimer> m_timer;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INSTANCE_ATTRIBUTES_H
+#define _INSTANCE_ATTRIBUTES_H
+
+// std
+#include <cstring>
+#include <algorithm>
+
+// osg
+#include <osg/Vec4>
+
+namespace osgExample
+{
+
+// per instance data besides the model matrix, every backend stores it right after the matrix. The fields are
+// fixed instead of generic typed channels, so every backend and shader can pack them into the same two vec4s.
+struct InstanceAttributes
+{
+	// number of vec4 slots one set of attributes occupies in the instance storage
+	static const unsigned int NUM_VECTORS = 2;
+
+	InstanceAttributes()
+		:	tint(1.0f, 1.0f, 1.0f, 1.0f),
+			textureLayer(0u),
+			windPhase(0.0f),
+			fade(1.0f)
+	{
+	}
+
+	// write the attributes as NUM_VECTORS vec4s: (tint) and (textureLayer, windPhase, fade, 0)
+	inline void pack(float* data) const
+	{
+		data[0] = tint.r();
+		data[1] = tint.g();
+		data[2] = tint.b();
+		data[3] = tint.a();
+		data[4] = (float)textureLayer;
+		data[5] = windPhase;
+		data[6] = fade;
+		data[7] = 0.0f;
+	}
+
+	// write the attributes as one uvec4: (tint as rgba8, textureLayer, windPhase bits, fade bits)
+	inline void packCompact(unsigned int* data) const
+	{
+		data[0] = 0u;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			unsigned int channel = (unsigned int)(std::min(std::max(tint[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			data[0] |= channel << (i * 8);
+		}
+		data[1] = textureLayer;
+		memcpy(&data[2], &windPhase, sizeof(float));
+		memcpy(&data[3], &fade, sizeof(float));
+	}
+
+	osg::Vec4		tint;
+	unsigned int	textureLayer;
+	float			windPhase;
+	float			fade;
+};
+
+}
+
+#endif
\ No newline at end of file
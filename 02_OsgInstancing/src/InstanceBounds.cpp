@@ -0,0 +1,179 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+// osgExample
+#include "InstanceBounds.h"
+
+namespace osgExample
+{
+
+const float InstanceBounds::WIND_SWAY = 0.05f;
+
+InstanceBounds::InstanceBounds()
+{
+}
+
+void InstanceBounds::setLocalBound(const osg::BoundingBox& localBound)
+{
+	osg::BoundingBox paddedBound = localBound;
+	if (localBound.valid())
+	{
+		float sway = WIND_SWAY * std::max(fabsf(localBound.zMin()), fabsf(localBound.zMax()));
+		paddedBound.xMin() -= sway;
+		paddedBound.xMax() += sway;
+	}
+
+	if (paddedBound._min != m_localBound._min || paddedBound._max != m_localBound._max)
+	{
+		m_localBound = paddedBound;
+		dirtyAll();
+	}
+}
+
+void InstanceBounds::dirty(unsigned int start, unsigned int end)
+{
+	for (unsigned int block = start / BLOCK_SIZE; block < m_blockDirty.size() && block * BLOCK_SIZE < end; ++block)
+	{
+		m_blockDirty[block] = 1;
+	}
+}
+
+void InstanceBounds::dirtyAll()
+{
+	std::fill(m_blockDirty.begin(), m_blockDirty.end(), 1);
+}
+
+osg::BoundingBox InstanceBounds::computeBound(const std::vector<osg::Matrixd>& matrices)
+{
+	// osg::Matrixd is nothing but its 16 doubles
+	return computeBlocks(matrices.empty() ? (const double*)NULL : matrices.front().ptr(), matrices.size(), 16u);
+}
+
+osg::BoundingBox InstanceBounds::computeBound(const float* matrices, unsigned int numInstances, unsigned int stride)
+{
+	return computeBlocks(matrices, numInstances, stride);
+}
+
+template<typename T>
+osg::BoundingBox InstanceBounds::computeBlocks(const T* matrices, unsigned int numInstances, unsigned int stride)
+{
+	osg::BoundingBox bounds;
+	if (!m_localBound.valid())
+		return bounds;
+
+	unsigned int numBlocks = (numInstances + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (numBlocks != m_blockBounds.size())
+	{
+		m_blockBounds.assign(numBlocks, osg::BoundingBox());
+		m_blockDirty.assign(numBlocks, 1);
+	}
+
+	std::vector<int> dirtyBlocks;
+	for (unsigned int i = 0; i < numBlocks; ++i)
+	{
+		if (m_blockDirty[i])
+			dirtyBlocks.push_back(i);
+	}
+
+	// blocks are independent, so recompute them in parallel if there are enough of them
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) if(dirtyBlocks.size() > 8)
+#endif
+	for (int i = 0; i < (int)dirtyBlocks.size(); ++i)
+	{
+		m_blockBounds[dirtyBlocks[i]] = computeBlock(matrices, numInstances, stride, dirtyBlocks[i]);
+		m_blockDirty[dirtyBlocks[i]] = 0;
+	}
+
+	for (auto it = m_blockBounds.begin(); it != m_blockBounds.end(); ++it)
+	{
+		bounds.expandBy(*it);
+	}
+
+	return bounds;
+}
+
+template<typename T>
+osg::BoundingBox InstanceBounds::computeBlock(const T* matrices, unsigned int numInstances, unsigned int stride, unsigned int block) const
+{
+	const osg::Vec3d center = m_localBound.center();
+	const osg::Vec3d extent = (m_localBound._max - m_localBound._min) * 0.5;
+
+	double minX = DBL_MAX, minY = DBL_MAX, minZ = DBL_MAX;
+	double maxX = -DBL_MAX, maxY = -DBL_MAX, maxZ = -DBL_MAX;
+
+	unsigned int start = block * BLOCK_SIZE;
+	int count = (int)(std::min(start + BLOCK_SIZE, numInstances) - start);
+	const T* blockMatrices = matrices + start * stride;
+
+	// branch free loop over the instances of the block, min/max are reductions so the compiler can vectorize it
+#if defined(_OPENMP) && _OPENMP >= 201307
+	#pragma omp simd reduction(min:minX,minY,minZ) reduction(max:maxX,maxY,maxZ)
+#endif
+	for (int i = 0; i < count; ++i)
+	{
+		// osg multiplies row vectors from the left, so the translation is the last row
+		const T* m = blockMatrices + i * stride;
+
+		double cx = center.x() * m[0] + center.y() * m[4] + center.z() * m[8]  + m[12];
+		double cy = center.x() * m[1] + center.y() * m[5] + center.z() * m[9]  + m[13];
+		double cz = center.x() * m[2] + center.y() * m[6] + center.z() * m[10] + m[14];
+
+		double ex = extent.x() * std::fabs(m[0]) + extent.y() * std::fabs(m[4]) + extent.z() * std::fabs(m[8]);
+		double ey = extent.x() * std::fabs(m[1]) + extent.y() * std::fabs(m[5]) + extent.z() * std::fabs(m[9]);
+		double ez = extent.x() * std::fabs(m[2]) + extent.y() * std::fabs(m[6]) + extent.z() * std::fabs(m[10]);
+
+		minX = std::min(minX, cx - ex);
+		minY = std::min(minY, cy - ey);
+		minZ = std::min(minZ, cz - ez);
+		maxX = std::max(maxX, cx + ex);
+		maxY = std::max(maxY, cy + ey);
+		maxZ = std::max(maxZ, cz + ez);
+	}
+
+	if (count <= 0)
+		return osg::BoundingBox();
+
+	return osg::BoundingBox(minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+osg::BoundingBox InstanceBounds::computeLocalBound(const osg::Vec3Array* vertices)
+{
+	osg::BoundingBox bounds;
+	if (!vertices)
+		return bounds;
+
+	for (auto it = vertices->begin(); it != vertices->end(); ++it)
+	{
+		bounds.expandBy(*it);
+	}
+
+	return bounds;
+}
+
+}
\ No newline at end of file
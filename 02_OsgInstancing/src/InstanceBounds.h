@@ -0,0 +1,78 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _INSTANCE_BOUNDS_H
+#define _INSTANCE_BOUNDS_H
+
+// std
+#include <vector>
+
+// osg
+#include <osg/BoundingBox>
+#include <osg/Matrixd>
+#include <osg/Array>
+
+namespace osgExample
+{
+
+// Bounding box of all instances of one mesh. Every instance only transforms the local bounding box of
+// the mesh, so the cost doesn't depend on the vertex count. The instances are grouped into blocks whose
+// bounds are cached, changing a few instances only recomputes their blocks.
+class InstanceBounds
+{
+public:
+	static const unsigned int BLOCK_SIZE = 256u;
+	// the shaders sway the top of every instance along its local x axis by up to this times its local height
+	static const float WIND_SWAY;
+
+	InstanceBounds();
+
+	// a different local bound invalidates all blocks, it is padded by the wind sway
+	void setLocalBound(const osg::BoundingBox& localBound);
+	void dirty(unsigned int start, unsigned int end);
+	void dirtyAll();
+
+	// every instance contributes the center of the local box transformed by its matrix plus the extent
+	// transformed by the absolute matrix
+	osg::BoundingBox computeBound(const std::vector<osg::Matrixd>& matrices);
+	// float matrices which start every stride floats, e.g. a range of the shared instance data
+	osg::BoundingBox computeBound(const float* matrices, unsigned int numInstances, unsigned int stride);
+
+	static osg::BoundingBox computeLocalBound(const osg::Vec3Array* vertices);
+
+	// bytes of the cached block bounds
+	inline size_t getMemoryUsage() const { return m_blockBounds.capacity() * sizeof(osg::BoundingBox) + m_blockDirty.capacity(); }
+private:
+	template<typename T>
+	osg::BoundingBox computeBlocks(const T* matrices, unsigned int numInstances, unsigned int stride);
+	template<typename T>
+	osg::BoundingBox computeBlock(const T* matrices, unsigned int numInstances, unsigned int stride, unsigned int block) const;
+
+	osg::BoundingBox			m_localBound;
+	std::vector<osg::BoundingBox>	m_blockBounds;
+	std::vector<unsigned char>	m_blockDirty;
+};
+
+}
+
+#endif
\ No newline at end of file
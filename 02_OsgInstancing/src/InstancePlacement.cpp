@@ -0,0 +1,286 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <GL/glew.h>
+
+#include "InstancePlacement.h"
+#include "InstancedDrawable.h"
+
+// std
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+namespace
+{
+
+// like InstancedGeometryBuilder::readShaderSource without the shared instancing part, the definitions go right after the version line
+std::string readShaderSource(const std::string& fileName, const std::string& preprocessorDefinitions)
+{
+	std::ifstream shaderFile(fileName.c_str(), std::ios_base::in);
+	if (!shaderFile.is_open())
+	{
+		std::cout << "Error: Could not open shader file " << fileName << std::endl;
+		return std::string();
+	}
+
+	std::stringstream shaderStr;
+	std::string line;
+	std::getline(shaderFile, line);
+	shaderStr << line << std::endl;
+	shaderStr << preprocessorDefinitions << std::endl;
+	while (!shaderFile.eof())
+	{
+		std::getline(shaderFile, line);
+		shaderStr << line << std::endl;
+	}
+
+	return shaderStr.str();
+}
+
+GLuint compileShader(GLenum type, const std::string& source)
+{
+	GLuint shader = glCreateShader(type);
+	const char* sourcePtr = source.c_str();
+	glShaderSource(shader, 1, &sourcePtr, NULL);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[4096];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "Error: Could not compile placement shader" << std::endl << log << std::endl;
+		glDeleteShader(shader);
+		return 0u;
+	}
+
+	return shader;
+}
+
+}
+
+namespace osgExample
+{
+
+InstancePlacement::GLObjects::GLObjects()
+	:	program(0u),
+		vao(0u),
+		query(0u),
+		heightTexture(0u),
+		densityTexture(0u)
+{
+}
+
+InstancePlacement::InstancePlacement(const ProceduralInstanceGenerator& generator)
+	:	m_generator(generator)
+{
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define NUM_YAW_STEPS " << ProceduralInstanceGenerator::NUM_YAW_STEPS;
+	m_vertexSource = readShaderSource("../shader/instance_placement.vert", preprocessorDefinition.str());
+	m_geometrySource = readShaderSource("../shader/instance_placement.geom", "");
+}
+
+InstancePlacement::~InstancePlacement()
+{
+}
+
+bool InstancePlacement::compile(GLObjects& objects) const
+{
+	if (objects.program)
+		return true;
+
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, m_vertexSource);
+	GLuint geometryShader = compileShader(GL_GEOMETRY_SHADER, m_geometrySource);
+	if (!vertexShader || !geometryShader)
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(geometryShader);
+		return false;
+	}
+
+	// the captured outputs are interleaved exactly like InstancedDrawable::FLOATS_PER_INSTANCE floats
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, geometryShader);
+	const char* varyings[] = { "instanceRow0", "instanceRow1", "instanceRow2", "instanceRow3", "instanceTint", "instanceParams" };
+	glTransformFeedbackVaryings(program, 6, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(geometryShader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "Error: Could not link placement program" << std::endl << log << std::endl;
+		glDeleteProgram(program);
+		return false;
+	}
+
+	objects.program = program;
+	glGenVertexArrays(1, &objects.vao);
+	glGenQueries(1, &objects.query);
+
+	if (m_generator.getHeightMap())
+	{
+		objects.heightTexture = createTexture(GL_R32F, GL_RED, GL_FLOAT, m_generator.getHeightMap());
+		if (m_generator.getDensityMap())
+			objects.densityTexture = createTexture(GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, m_generator.getDensityMap());
+	}
+
+	return true;
+}
+
+GLuint InstancePlacement::createTexture(GLenum internalFormat, GLenum format, GLenum type, const void* data) const
+{
+	// osg doesn't know about this texture, so the binding and unpack state it expects are restored
+	GLint lastTexture = 0;
+	GLint lastAlignment = 4;
+	glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE, &lastTexture);
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &lastAlignment);
+
+	GLuint texture = 0u;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_RECTANGLE, texture);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, internalFormat, m_generator.getHeightMapWidth(), m_generator.getHeightMapHeight(), 0, format, type, data);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, lastAlignment);
+	glBindTexture(GL_TEXTURE_RECTANGLE, lastTexture);
+
+	return texture;
+}
+
+unsigned int InstancePlacement::place(GLObjects& objects, GLuint buffer) const
+{
+	unsigned int numCandidates = getNumCandidates();
+	if (!numCandidates || !compile(objects))
+		return 0u;
+
+	// the placement runs in the middle of osg's draw, so all state osg tracks is restored afterwards
+	GLint lastProgram = 0;
+	GLint lastActiveTexture = GL_TEXTURE0;
+	GLint lastTextures[2] = {0, 0};
+	glGetIntegerv(GL_CURRENT_PROGRAM, &lastProgram);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &lastActiveTexture);
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE, &lastTextures[i]);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_RECTANGLE, objects.heightTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_RECTANGLE, objects.densityTexture);
+
+	glUseProgram(objects.program);
+	glUniform1ui(glGetUniformLocation(objects.program, "hashedSeed"), ProceduralInstanceGenerator::hash(m_generator.getSeed()));
+	glUniform1ui(glGetUniformLocation(objects.program, "gridHeight"), m_generator.getGridHeight());
+	glUniform1ui(glGetUniformLocation(objects.program, "gridStepX"), m_generator.getStepX());
+	glUniform1ui(glGetUniformLocation(objects.program, "gridStepY"), m_generator.getStepY());
+	glUniform1ui(glGetUniformLocation(objects.program, "numTextureLayers"), m_generator.getNumTextureLayers());
+	glUniform2fv(glGetUniformLocation(objects.program, "yawTable"), ProceduralInstanceGenerator::NUM_YAW_STEPS, m_generator.getYawTable()[0].ptr());
+	glUniform1i(glGetUniformLocation(objects.program, "heightMap"), 0);
+	glUniform1i(glGetUniformLocation(objects.program, "densityMap"), 1);
+	glUniform1i(glGetUniformLocation(objects.program, "useHeightMap"), objects.heightTexture ? 1 : 0);
+	glUniform1i(glGetUniformLocation(objects.program, "useDensityMap"), objects.densityTexture ? 1 : 0);
+
+	// room for every candidate, the query tells how many survived
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, numCandidates * InstancedDrawable::FLOATS_PER_INSTANCE * sizeof(float), NULL, GL_STATIC_DRAW);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(objects.vao);
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, objects.query);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, numCandidates);
+	glEndTransformFeedback();
+	glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_RECTANGLE, lastTextures[i]);
+	}
+	glActiveTexture(lastActiveTexture);
+	glUseProgram(lastProgram);
+
+	// waits for the placement, but only once per regeneration
+	GLuint numPlaced = 0u;
+	glGetQueryObjectuiv(objects.query, GL_QUERY_RESULT, &numPlaced);
+
+	return numPlaced;
+}
+
+unsigned int InstancePlacement::placeOnCpu(osg::FloatArray& instanceData) const
+{
+	// every candidate is written straight into the instance data, survivors are packed to the front
+	instanceData.resize(m_generator.getNumInstances() * InstancedDrawable::FLOATS_PER_INSTANCE);
+	unsigned int numPlaced = 0u;
+	for (unsigned int i = 0; i < m_generator.getNumInstances(); ++i)
+	{
+		if (!m_generator.isPlaced(i))
+			continue;
+
+		float* data = &instanceData[numPlaced * InstancedDrawable::FLOATS_PER_INSTANCE];
+		osg::Matrixf matrix = m_generator.computeMatrix(i);
+		memcpy(data, matrix.ptr(), 16 * sizeof(float));
+		m_generator.computeAttributes(i).pack(data + 16);
+		++numPlaced;
+	}
+
+	instanceData.resize(numPlaced * InstancedDrawable::FLOATS_PER_INSTANCE);
+	return numPlaced;
+}
+
+void InstancePlacement::release(GLObjects& objects) const
+{
+	if (objects.program)
+	{
+		glDeleteProgram(objects.program);
+		glDeleteVertexArrays(1, &objects.vao);
+		glDeleteQueries(1, &objects.query);
+	}
+
+	GLuint textures[] = { objects.heightTexture, objects.densityTexture };
+	glDeleteTextures(2, textures);
+
+	objects = GLObjects();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INSTANCE_PLACEMENT_H
+#define _INSTANCE_PLACEMENT_H
+
+// std
+#include <string>
+#include <vector>
+
+// osg
+#include <osg/GL>
+#include <osg/Referenced>
+#include <osg/Matrixd>
+#include <osg/Array>
+
+// osgExample
+#include "ProceduralInstanceGenerator.h"
+
+namespace osgExample
+{
+
+// Places the candidates of a ProceduralInstanceGenerator on the gpu. A vertex shader evaluates one candidate per
+// point, a geometry shader drops the ones rejected by the density map and transform feedback writes the survivors
+// in the layout of the instance buffer. The cpu fallback runs the generator itself and gives the same result.
+// All gl functions need a current context.
+class InstancePlacement : public osg::Referenced
+{
+public:
+	// gl objects of one context, owned by the drawable that draws the placed instances
+	struct GLObjects
+	{
+		GLObjects();
+
+		GLuint	program;
+		GLuint	vao;
+		GLuint	query;
+		GLuint	heightTexture;
+		GLuint	densityTexture;
+	};
+
+	// the shader sources are read right away, so the draw thread never touches the disk
+	InstancePlacement(const ProceduralInstanceGenerator& generator);
+
+	inline const ProceduralInstanceGenerator& getGenerator() const { return m_generator; }
+	inline unsigned int getNumCandidates() const { return m_generator.getNumInstances(); }
+
+	// writes the surviving candidates into buffer, which is resized to hold all candidates, and returns their number
+	unsigned int place(GLObjects& objects, GLuint buffer) const;
+	// the same on the cpu, instanceData gets the layout of the instance buffer
+	unsigned int placeOnCpu(osg::FloatArray& instanceData) const;
+
+	void release(GLObjects& objects) const;
+
+protected:
+	virtual ~InstancePlacement();
+
+private:
+	bool compile(GLObjects& objects) const;
+	GLuint createTexture(GLenum internalFormat, GLenum format, GLenum type, const void* data) const;
+
+	ProceduralInstanceGenerator	m_generator;
+	std::string					m_vertexSource;
+	std::string					m_geometrySource;
+};
+
+}
+
+#endif
\ No newline at end of file
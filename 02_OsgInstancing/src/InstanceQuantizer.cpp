@@ -0,0 +1,182 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#define _USE_MATH_DEFINES 1 // fix for visual studio
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "InstanceQuantizer.h"
+
+namespace
+{
+
+const unsigned int POSITION_STEPS = 65535u;
+const unsigned int YAW_STEPS = 1024u;
+const unsigned int SCALE_STEPS = 63u;
+
+unsigned int quantizeUnit(float value, unsigned int steps)
+{
+	return (unsigned int)(std::min(std::max(value, 0.0f), 1.0f) * steps + 0.5f);
+}
+
+}
+
+namespace osgExample
+{
+
+InstanceQuantizer::InstanceQuantizer()
+	:	m_origin(0.0f, 0.0f, 0.0f),
+		m_extent(0.0f, 0.0f, 0.0f),
+		m_scaleRange(1.0f, 1.0f)
+{
+}
+
+bool InstanceQuantizer::computeRange(const std::vector<osg::Matrixd>& matrices, unsigned int start, unsigned int end)
+{
+	osg::Vec3d minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+	osg::Vec3d maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	double minScale = FLT_MAX;
+	double maxScale = 0.0;
+
+	for (unsigned int i = start; i < end; ++i)
+	{
+		double scale, yaw;
+		osg::Vec3d position;
+
+		if (!decompose(matrices[i], scale, yaw, position))
+			return false;
+
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			minPosition[j] = std::min(minPosition[j], position[j]);
+			maxPosition[j] = std::max(maxPosition[j], position[j]);
+		}
+		minScale = std::min(minScale, scale);
+		maxScale = std::max(maxScale, scale);
+	}
+
+	if (start >= end)
+		return true;
+
+	m_origin = minPosition;
+	m_extent = maxPosition - minPosition;
+	m_scaleRange.set(minScale, maxScale);
+
+	return true;
+}
+
+void InstanceQuantizer::quantize(const osg::Matrixd& matrix, const InstanceAttributes& attributes, unsigned int* data) const
+{
+	double scale, yaw;
+	osg::Vec3d position;
+	decompose(matrix, scale, yaw, position);
+
+	// transform
+	unsigned int quantizedPosition[3];
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		float relative = m_extent[i] > 0.0f ? (float)((position[i] - m_origin[i]) / m_extent[i]) : 0.0f;
+		quantizedPosition[i] = quantizeUnit(relative, POSITION_STEPS);
+	}
+
+	double turns = yaw / (2.0 * M_PI);
+	turns -= floor(turns);
+	unsigned int quantizedYaw = (unsigned int)(turns * YAW_STEPS + 0.5) % YAW_STEPS;
+
+	float scaleRange = m_scaleRange.y() - m_scaleRange.x();
+	unsigned int quantizedScale = quantizeUnit(scaleRange > 0.0f ? (float)((scale - m_scaleRange.x()) / scaleRange) : 0.0f, SCALE_STEPS);
+
+	data[0] = quantizedPosition[0] | (quantizedPosition[1] << 16);
+	data[1] = quantizedPosition[2] | (quantizedYaw << 16) | (quantizedScale << 26);
+
+	// attributes
+	data[2] = 0u;
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		data[2] |= quantizeUnit(attributes.tint[i], 255u) << (i * 8);
+	}
+
+	float phase = attributes.windPhase / (2.0f * (float)M_PI);
+	phase -= floorf(phase);
+	data[3] = std::min(attributes.textureLayer, 255u) | (((unsigned int)(phase * 256.0f) & 255u) << 8) | (quantizeUnit(attributes.fade, 255u) << 16);
+}
+
+osg::Matrixd InstanceQuantizer::dequantizeMatrix(const unsigned int* data) const
+{
+	osg::Vec3d position(m_origin.x() + (data[0] & 0xffffu) / (double)POSITION_STEPS * m_extent.x(),
+						m_origin.y() + (data[0] >> 16) / (double)POSITION_STEPS * m_extent.y(),
+						m_origin.z() + (data[1] & 0xffffu) / (double)POSITION_STEPS * m_extent.z());
+	double yaw = ((data[1] >> 16) & 1023u) / (double)YAW_STEPS * 2.0 * M_PI;
+	double scale = m_scaleRange.x() + (data[1] >> 26) / (double)SCALE_STEPS * (m_scaleRange.y() - m_scaleRange.x());
+
+	return osg::Matrixd::scale(scale, scale, scale) * osg::Matrixd::rotate(yaw, osg::Vec3d(0.0, 0.0, 1.0)) * osg::Matrixd::translate(position);
+}
+
+float InstanceQuantizer::computeMaxError(const osg::BoundingBox& localBound, float sway) const
+{
+	if (!localBound.valid())
+		return 0.0f;
+
+	// rounding scale and yaw moves a vertex by at most its distance to the instance origin times the error
+	double radius = 0.0;
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		radius = std::max(radius, (double)localBound.corner(i).length());
+	}
+	radius *= 1.0 + sway;
+
+	// every value is rounded to the nearest step, so it is off by half a step at most
+	double positionError = 0.5 * m_extent.length() / POSITION_STEPS;
+	double scaleError = 0.5 * (m_scaleRange.y() - m_scaleRange.x()) / SCALE_STEPS;
+	double yawError = M_PI / YAW_STEPS;
+
+	return (float)(positionError + (scaleError + m_scaleRange.y() * yawError) * radius);
+}
+
+bool InstanceQuantizer::decompose(const osg::Matrixd& matrix, double& scale, double& yaw, osg::Vec3d& position)
+{
+	scale = matrix(2, 2);
+	yaw = atan2(matrix(0, 1), matrix(0, 0));
+	position = matrix.getTrans();
+
+	if (scale <= 0.0)
+		return false;
+
+	// compare against the matrix we would rebuild in the shader
+	osg::Matrixd rebuilt = osg::Matrixd::scale(scale, scale, scale) * osg::Matrixd::rotate(yaw, osg::Vec3d(0.0, 0.0, 1.0)) * osg::Matrixd::translate(position);
+	double tolerance = 1e-4 * std::max(scale, 1.0);
+	for (unsigned int row = 0; row < 4; ++row)
+	{
+		for (unsigned int column = 0; column < 4; ++column)
+		{
+			if (fabs(rebuilt(row, column) - matrix(row, column)) > tolerance)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+}
\ No newline at end of file
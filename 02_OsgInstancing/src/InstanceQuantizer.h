@@ -0,0 +1,77 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INSTANCE_QUANTIZER_H
+#define _INSTANCE_QUANTIZER_H
+
+// std
+#include <vector>
+
+// osg
+#include <osg/Matrixd>
+#include <osg/BoundingBox>
+#include <osg/Vec2>
+#include <osg/Vec3>
+
+// osgExample
+#include "InstanceAttributes.h"
+
+namespace osgExample
+{
+
+// Packs a uniform scale, a rotation around z and a translation together with the instance attributes into
+// one uvec4(16 bytes). The transform takes 8 bytes: 16 bit per position component relative to the chunk
+// origin, 10 bit yaw and 6 bit scale. The attributes take the other 8 bytes: rgba8 tint, 8 bit texture
+// layer, 8 bit wind phase and 8 bit fade.
+class InstanceQuantizer
+{
+public:
+	InstanceQuantizer();
+
+	// compute origin, extent and scale range of a chunk, fails if a matrix can't be represented
+	bool computeRange(const std::vector<osg::Matrixd>& matrices, unsigned int start, unsigned int end);
+
+	void quantize(const osg::Matrixd& matrix, const InstanceAttributes& attributes, unsigned int* data) const;
+	// reconstructs the matrix exactly like the vertex shader does
+	osg::Matrixd dequantizeMatrix(const unsigned int* data) const;
+	// largest distance between a vertex inside localBound transformed by an instance matrix of the chunk and
+	// by its dequantized matrix, sway is the wind sway the shader adds relative to the height
+	float computeMaxError(const osg::BoundingBox& localBound, float sway) const;
+
+	inline const osg::Vec3& getOrigin() const { return m_origin; }
+	inline const osg::Vec3& getExtent() const { return m_extent; }
+	inline const osg::Vec2& getScaleRange() const { return m_scaleRange; }
+
+private:
+	// split the matrix into scale, yaw and translation, returns false for any other transform
+	static bool decompose(const osg::Matrixd& matrix, double& scale, double& yaw, osg::Vec3d& position);
+
+	osg::Vec3	m_origin;
+	osg::Vec3	m_extent;
+	osg::Vec2	m_scaleRange;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,177 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "InstanceRingBuffer.h"
+
+// std
+#include <cstring>
+#include <algorithm>
+
+namespace osgExample
+{
+
+InstanceRingBuffer::InstanceRingBuffer()
+	:	m_buffer(0u),
+		m_segmentSize(0),
+		m_persistent(false),
+		m_mappedData(NULL),
+		m_segment(0u)
+{
+	for (unsigned int i = 0; i < NUM_SEGMENTS; ++i)
+	{
+		m_fences[i] = 0;
+	}
+}
+
+InstanceRingBuffer::~InstanceRingBuffer()
+{
+}
+
+void InstanceRingBuffer::allocate(GLsizeiptr segmentSize)
+{
+	release();
+
+	m_segmentSize = segmentSize;
+	m_segment = NUM_SEGMENTS - 1;
+	// base instance is needed to select the segment without touching the vao
+	m_persistent = GLEW_ARB_buffer_storage && GLEW_ARB_base_instance;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+	if (m_persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, m_segmentSize * NUM_SEGMENTS, NULL, flags);
+		m_mappedData = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_segmentSize * NUM_SEGMENTS, flags);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, m_segmentSize, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLintptr InstanceRingBuffer::upload(const void* data, GLsizeiptr size)
+{
+	size = std::min(size, m_segmentSize);
+
+	if (!m_persistent)
+	{
+		// orphan the old storage so the driver doesn't have to wait for pending draws
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+		glBufferData(GL_ARRAY_BUFFER, m_segmentSize, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return 0;
+	}
+
+	GLintptr offset = reserve();
+	memcpy(m_mappedData + offset, data, size);
+	return offset;
+}
+
+GLintptr InstanceRingBuffer::reserve()
+{
+	m_segment = (m_segment + 1) % NUM_SEGMENTS;
+	waitForSegment(m_segment);
+
+	return m_segment * m_segmentSize;
+}
+
+void InstanceRingBuffer::fence(GLintptr offset)
+{
+	if (!m_persistent)
+		return;
+
+	// the drawn segment isn't necessarily the last reserved one
+	unsigned int segment = offset / m_segmentSize;
+	if (m_fences[segment])
+		glDeleteSync(m_fences[segment]);
+
+	m_fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void InstanceRingBuffer::release()
+{
+	for (unsigned int i = 0; i < NUM_SEGMENTS; ++i)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+
+	if (m_buffer)
+	{
+		if (m_mappedData)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			m_mappedData = NULL;
+		}
+
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0u;
+	}
+}
+
+void InstanceRingBuffer::detach(std::vector<GLuint>& buffers, std::vector<GLsync>& fences)
+{
+	for (unsigned int i = 0; i < NUM_SEGMENTS; ++i)
+	{
+		if (m_fences[i])
+		{
+			fences.push_back(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+
+	// deleting a mapped buffer unmaps it
+	if (m_buffer)
+	{
+		buffers.push_back(m_buffer);
+		m_buffer = 0u;
+		m_mappedData = NULL;
+	}
+}
+
+void InstanceRingBuffer::waitForSegment(unsigned int segment)
+{
+	if (!m_fences[segment])
+		return;
+
+	// the gpu is usually done with a segment written two frames ago, so this rarely blocks
+	GLenum result = glClientWaitSync(m_fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(m_fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+
+	glDeleteSync(m_fences[segment]);
+	m_fences[segment] = 0;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INSTANCE_RING_BUFFER_H
+#define _INSTANCE_RING_BUFFER_H
+
+// glew
+#include <GL/glew.h>
+
+// std
+#include <vector>
+
+// osg
+#include <osg/Referenced>
+
+namespace osgExample
+{
+
+// Triple buffered ring for instance data that changes every frame. With GL_ARB_buffer_storage the
+// buffer is mapped persistently and every segment is guarded by a fence, otherwise the buffer gets
+// orphaned on every upload. All functions need a current context.
+class InstanceRingBuffer : public osg::Referenced
+{
+public:
+	static const unsigned int NUM_SEGMENTS = 3;
+
+	InstanceRingBuffer();
+
+	// (re)create the buffer with room for NUM_SEGMENTS segments of segmentSize bytes
+	void allocate(GLsizeiptr segmentSize);
+	// copy data into the next free segment and return its byte offset in the buffer
+	GLintptr upload(const void* data, GLsizeiptr size);
+	// persistent buffers only: advance to the next segment, wait until the gpu is done with it and return
+	// its byte offset, the segment may then be written through getMappedData from any thread
+	GLintptr reserve();
+	// call after every draw that read from the segment at offset
+	void fence(GLintptr offset);
+	void release();
+	// hands the gl objects over without any gl call, for deletion once their context is current again
+	void detach(std::vector<GLuint>& buffers, std::vector<GLsync>& fences);
+
+	inline GLuint getBuffer() const { return m_buffer; }
+	inline bool isPersistent() const { return m_persistent; }
+	inline void* getMappedData(GLintptr offset) const { return m_mappedData ? m_mappedData + offset : NULL; }
+	// bytes of the buffer, all segments if it is persistent, otherwise the one that gets orphaned
+	inline GLsizeiptr getSize() const { return m_persistent ? m_segmentSize * NUM_SEGMENTS : m_segmentSize; }
+
+protected:
+	virtual ~InstanceRingBuffer();
+
+private:
+	void waitForSegment(unsigned int segment);
+
+	GLuint			m_buffer;
+	GLsizeiptr		m_segmentSize;
+	bool			m_persistent;
+	char*			m_mappedData;
+	GLsync			m_fences[NUM_SEGMENTS];
+	unsigned int	m_segment;
+};
+
+}
+
+#endif
\ No newline at end of file
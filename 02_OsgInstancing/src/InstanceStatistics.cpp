@@ -0,0 +1,119 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "InstanceStatistics.h"
+
+// std
+#include <algorithm>
+
+// osg
+#include <OpenThreads/ScopedLock>
+#include <osgViewer/ViewerEventHandlers>
+
+namespace osgExample
+{
+
+const char* InstanceStatistics::SUBMITTED_INSTANCES = "Instances submitted";
+const char* InstanceStatistics::VISIBLE_INSTANCES = "Instances visible";
+const char* InstanceStatistics::CULLED_INSTANCES = "Instances culled";
+const char* InstanceStatistics::VISIBLE_CHUNKS = "Instance chunks visible";
+const char* InstanceStatistics::DRAW_CALLS = "Instance draw calls";
+const char* InstanceStatistics::UPLOADED_BYTES = "Instance bytes uploaded";
+const char* InstanceStatistics::REBUILD_TIME = "Scene rebuild time taken";
+const char* InstanceStatistics::TECHNIQUE_GPU_TIME = "Technique GPU time taken";
+const char* InstanceStatistics::MAX_CHUNK_GPU_TIME = "Slowest chunk GPU time taken";
+
+InstanceStatistics::InstanceStatistics(osg::ref_ptr<osg::Stats> stats)
+	:	m_stats(stats)
+{
+}
+
+void InstanceStatistics::beginFrame(unsigned int frameNumber)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+	// another camera may have started the frame already
+	double value = 0.0;
+	if (m_stats->getAttribute(frameNumber, SUBMITTED_INSTANCES, value))
+		return;
+
+	m_stats->setAttribute(frameNumber, SUBMITTED_INSTANCES, 0.0);
+	m_stats->setAttribute(frameNumber, VISIBLE_INSTANCES, 0.0);
+	m_stats->setAttribute(frameNumber, CULLED_INSTANCES, 0.0);
+	m_stats->setAttribute(frameNumber, VISIBLE_CHUNKS, 0.0);
+	m_stats->setAttribute(frameNumber, DRAW_CALLS, 0.0);
+	if (!m_stats->getAttribute(frameNumber, UPLOADED_BYTES, value))
+		m_stats->setAttribute(frameNumber, UPLOADED_BYTES, 0.0);
+}
+
+void InstanceStatistics::add(unsigned int frameNumber, const char* name, double value)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+	double previous = 0.0;
+	m_stats->getAttribute(frameNumber, name, previous);
+	m_stats->setAttribute(frameNumber, name, previous + value);
+
+	// the instances placed on the gpu become visible only when they are drawn, long after the cull
+	if (name == SUBMITTED_INSTANCES || name == VISIBLE_INSTANCES)
+	{
+		double submitted = 0.0;
+		double visible = 0.0;
+		m_stats->getAttribute(frameNumber, SUBMITTED_INSTANCES, submitted);
+		m_stats->getAttribute(frameNumber, VISIBLE_INSTANCES, visible);
+		m_stats->setAttribute(frameNumber, CULLED_INSTANCES, std::max(submitted - visible, 0.0));
+	}
+}
+
+void InstanceStatistics::set(unsigned int frameNumber, const char* name, double value)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+	m_stats->setAttribute(frameNumber, name, value);
+}
+
+void InstanceStatistics::setMax(unsigned int frameNumber, const char* name, double value)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+	double previous = 0.0;
+	if (!m_stats->getAttribute(frameNumber, name, previous) || value > previous)
+		m_stats->setAttribute(frameNumber, name, value);
+}
+
+void InstanceStatistics::addStatsLines(osgViewer::StatsHandler& statsHandler)
+{
+	// plain values without bars, the colors follow the camera lines of the stats handler
+	osg::Vec4 textColor(1.0f, 1.0f, 0.5f, 1.0f);
+	osg::Vec4 barColor(1.0f, 1.0f, 0.5f, 0.5f);
+	statsHandler.addUserStatsLine("Instances: ", textColor, barColor, SUBMITTED_INSTANCES, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Visible: ", textColor, barColor, VISIBLE_INSTANCES, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Culled: ", textColor, barColor, CULLED_INSTANCES, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Chunks: ", textColor, barColor, VISIBLE_CHUNKS, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Draw calls: ", textColor, barColor, DRAW_CALLS, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Uploaded KB: ", textColor, barColor, UPLOADED_BYTES, 1.0 / 1024.0, true, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Rebuild ms: ", textColor, barColor, REBUILD_TIME, 1.0, false, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Technique GPU ms: ", textColor, barColor, TECHNIQUE_GPU_TIME, 1.0, true, false, "", "", 0.0);
+	statsHandler.addUserStatsLine("Slowest chunk GPU ms: ", textColor, barColor, MAX_CHUNK_GPU_TIME, 1.0, true, false, "", "", 0.0);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _INSTANCE_STATISTICS_H
+#define _INSTANCE_STATISTICS_H
+
+// std
+#include <string>
+
+// osg
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Stats>
+#include <OpenThreads/Mutex>
+
+namespace osgViewer
+{
+class StatsHandler;
+}
+
+namespace osgExample
+{
+
+// Per frame counters of the instancing techniques, written into the attributes of an osg::Stats(usually the
+// viewer stats) so that the StatsHandler can show them next to the frame times. The counters are added by the
+// cull traversal and by the draw of the instanced drawables, which may run on different threads.
+class InstanceStatistics : public osg::Referenced
+{
+public:
+	// names of the attributes in the stats
+	static const char* SUBMITTED_INSTANCES;
+	static const char* VISIBLE_INSTANCES;
+	// submitted minus visible, for the placed technique this includes the instances removed by the density map
+	static const char* CULLED_INSTANCES;
+	static const char* VISIBLE_CHUNKS;
+	static const char* DRAW_CALLS;
+	static const char* UPLOADED_BYTES;
+	// milliseconds the last scene rebuild took on the rebuild thread
+	static const char* REBUILD_TIME;
+	// milliseconds the gpu spent on the chunks of the technique and on the slowest of them
+	static const char* TECHNIQUE_GPU_TIME;
+	static const char* MAX_CHUNK_GPU_TIME;
+
+	InstanceStatistics(osg::ref_ptr<osg::Stats> stats);
+
+	// every counter of the frame starts at zero, so frames where everything is culled still show up
+	void beginFrame(unsigned int frameNumber);
+	// name is one of the constants above, the culled instances follow the submitted and visible ones
+	void add(unsigned int frameNumber, const char* name, double value);
+	void set(unsigned int frameNumber, const char* name, double value);
+	// keeps the larger of value and the current one
+	void setMax(unsigned int frameNumber, const char* name, double value);
+
+	inline osg::ref_ptr<osg::Stats> getStats() const { return m_stats; }
+
+	// one line per counter in the overlay of the stats handler
+	static void addStatsLines(osgViewer::StatsHandler& statsHandler);
+
+private:
+	osg::ref_ptr<osg::Stats>	m_stats;
+	// guards the read and write of an attribute, the stats only lock each one separately
+	OpenThreads::Mutex			m_mutex;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _INSTANCE_STATISTICS_CALLBACK_H
+#define _INSTANCE_STATISTICS_CALLBACK_H
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Node>
+#include <osg/NodeCallback>
+#include <osg/NodeVisitor>
+#include <osg/FrameStamp>
+
+// osgExample
+#include "InstanceStatistics.h"
+
+namespace osgExample
+{
+
+// Cull callback on the root of the scene that starts the counters of every frame.
+class FrameStatisticsCallback : public osg::NodeCallback
+{
+public:
+	FrameStatisticsCallback(osg::ref_ptr<InstanceStatistics> statistics)
+		:	m_statistics(statistics)
+	{
+	}
+
+	virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+	{
+		if (nv->getFrameStamp())
+			m_statistics->beginFrame(nv->getFrameStamp()->getFrameNumber());
+
+		traverse(node, nv);
+	}
+
+private:
+	osg::ref_ptr<InstanceStatistics> m_statistics;
+};
+
+// Cull callback that adds its counters every time its node survives culling, on a chunk it counts the
+// visible instances and draw calls, on the root of a technique the submitted instances.
+class InstanceStatisticsCallback : public osg::NodeCallback
+{
+public:
+	InstanceStatisticsCallback(osg::ref_ptr<InstanceStatistics> statistics)
+		:	m_statistics(statistics),
+			m_numCounters(0)
+	{
+	}
+
+	inline void addCounter(const char* name, double value)
+	{
+		if (m_numCounters < MAX_COUNTERS)
+		{
+			m_names[m_numCounters] = name;
+			m_values[m_numCounters] = value;
+			++m_numCounters;
+		}
+	}
+
+	virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+	{
+		const osg::FrameStamp* frameStamp = nv->getFrameStamp();
+		if (frameStamp)
+		{
+			for (unsigned int i = 0; i < m_numCounters; ++i)
+				m_statistics->add(frameStamp->getFrameNumber(), m_names[i], m_values[i]);
+		}
+
+		traverse(node, nv);
+	}
+
+private:
+	static const unsigned int MAX_COUNTERS = 4;
+
+	osg::ref_ptr<InstanceStatistics> m_statistics;
+	const char*		m_names[MAX_COUNTERS];
+	double			m_values[MAX_COUNTERS];
+	unsigned int	m_numCounters;
+};
+
+}
+
+#endif
\ No newline at end of file
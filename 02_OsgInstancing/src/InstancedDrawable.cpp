@@ -21,30 +21,194 @@
 	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+
 #include <GL/glew.h>
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include <osg/Version>
+#include <osg/State>
+#include <osg/FrameStamp>
+#include <osg/ContextData>
+#include <osg/GLObjects>
+#include <OpenThreads/ScopedLock>
+
+// osg::ContextData and osg::GraphicsObjectManager came with osg 3.6
+#if !OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+#error "InstancedDrawable needs OpenSceneGraph 3.6 or newer"
+#endif
 
 #include "InstancedDrawable.h"
+#include "InstanceRingBuffer.h"
+#include "MeshOptimizer.h"
 
-// helper struct to pack all vertex data into the array of structs form
+// helper struct to pack all vertex data into the array of structs form, normals are stored as
+// GL_INT_2_10_10_10_REV and texture coordinates as half floats which makes 20 instead of 32 bytes
 struct VertexData
 {
 	GLfloat vertex[3];
-	GLfloat normal[3];
-	GLfloat texCoord[2];
+	GLuint normal;
+	GLushort texCoord[2];
 };
 
+namespace
+{
+
+// gl objects released while their context wasn't current
+struct DeletedObjects
+{
+	void append(const DeletedObjects& other)
+	{
+		buffers.insert(buffers.end(), other.buffers.begin(), other.buffers.end());
+		vertexArrays.insert(vertexArrays.end(), other.vertexArrays.begin(), other.vertexArrays.end());
+		fences.insert(fences.end(), other.fences.begin(), other.fences.end());
+		programs.insert(programs.end(), other.programs.begin(), other.programs.end());
+		queries.insert(queries.end(), other.queries.begin(), other.queries.end());
+		textures.insert(textures.end(), other.textures.begin(), other.textures.end());
+	}
+
+	void clear()
+	{
+		*this = DeletedObjects();
+	}
+
+	// needs the context of the objects current
+	void deleteAll()
+	{
+		if (!buffers.empty())
+			glDeleteBuffers(buffers.size(), &buffers.front());
+		if (!vertexArrays.empty())
+			glDeleteVertexArrays(vertexArrays.size(), &vertexArrays.front());
+		for (auto fence = fences.begin(); fence != fences.end(); ++fence)
+		{
+			glDeleteSync(*fence);
+		}
+		for (auto program = programs.begin(); program != programs.end(); ++program)
+		{
+			glDeleteProgram(*program);
+		}
+		if (!queries.empty())
+			glDeleteQueries(queries.size(), &queries.front());
+		if (!textures.empty())
+			glDeleteTextures(textures.size(), &textures.front());
+
+		clear();
+	}
+
+	std::vector<GLuint> buffers;
+	std::vector<GLuint> vertexArrays;
+	std::vector<GLsync> fences;
+	std::vector<GLuint> programs;
+	std::vector<GLuint> queries;
+	std::vector<GLuint> textures;
+};
+
+// Collects the released objects of one context like the managers of osg's own gl objects. osg flushes it
+// with the context current every frame and deletes or discards everything when the context is closed,
+// the generation tells objects of a closed context apart from those of a new one with the same id.
+class DeletedObjectsManager : public osg::GraphicsObjectManager
+{
+public:
+	DeletedObjectsManager(unsigned int contextID)
+		:	osg::GraphicsObjectManager("DeletedObjectsManager", contextID),
+			m_generation(0u)
+	{
+	}
+
+	unsigned int getGeneration()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		return m_generation;
+	}
+
+	void scheduleForDeletion(const DeletedObjects& objects, unsigned int generation)
+	{
+		// objects of an older generation were gone with their context
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		if (generation == m_generation)
+			m_objects.append(objects);
+	}
+
+	virtual void flushDeletedGLObjects(double /*currentTime*/, double& /*availableTime*/)
+	{
+		flushAllDeletedGLObjects();
+	}
+
+	virtual void flushAllDeletedGLObjects()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		m_objects.deleteAll();
+	}
+
+	virtual void deleteAllGLObjects()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		m_objects.deleteAll();
+		++m_generation;
+	}
+
+	virtual void discardAllGLObjects()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		m_objects.clear();
+		++m_generation;
+	}
+
+	virtual void discardAllDeletedGLObjects()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		m_objects.clear();
+	}
+
+protected:
+	virtual ~DeletedObjectsManager()
+	{
+	}
+
+private:
+	OpenThreads::Mutex	m_mutex;
+	DeletedObjects		m_objects;
+	unsigned int		m_generation;
+};
+
+}
+
 namespace osgExample
 {
 
+InstancedDrawable::ContextData::ContextData()
+	:	dirtyFlags(DIRTY_ALL),
+		instanceBufferSize(0u),
+		uploadedBytes(0u),
+		lastUploadedBytes(0u),
+		uploadFrameNumber(0u),
+		vao(0u),
+		vbo(0u),
+		instancebo(0u),
+		ebo(0u),
+		baseInstance(0u),
+		stagingGeneration(0u),
+		numPlacedInstances(0u),
+		generation(0u)
+{
+}
+
 InstancedDrawable::InstancedDrawable()
-	:	m_dirty(true),
-		m_vao(0u),
-		m_vbo(0u),
-		m_instancebo(0u),
-		m_ebo(0u),
+	:	m_dynamic(false),
+		m_writeStaging(0u),
+		m_readyStaging(1u),
+		m_drawStaging(2u),
+		m_stagingReady(false),
+		m_stagingGeneration(0u),
+		m_slotState(SLOT_NONE),
+		m_slot(NULL),
+		m_slotOffset(0),
+		m_writingSlot(false),
+		m_numRingBuffers(0u),
 		m_vertexArray(NULL),
+		m_numInstances(0u),
 		m_normalArray(NULL),
 		m_texCoordArray(NULL),
 		m_drawElements(NULL)
@@ -55,14 +219,25 @@ InstancedDrawable::InstancedDrawable()
 
 InstancedDrawable::InstancedDrawable(const InstancedDrawable& other, const osg::CopyOp& copyOp)
 	:	osg::Drawable(other, copyOp),
-		m_vao(0u),
-		m_vbo(0u),
-		m_instancebo(0u),
-		m_ebo(0u),
+		m_dynamic(other.m_dynamic),
+		m_writeStaging(0u),
+		m_readyStaging(1u),
+		m_drawStaging(2u),
+		m_stagingReady(false),
+		m_stagingGeneration(0u),
+		m_slotState(SLOT_NONE),
+		m_slot(NULL),
+		m_slotOffset(0),
+		m_writingSlot(false),
+		m_numRingBuffers(0u),
 		m_vertexArray(dynamic_cast<osg::Vec3Array*>(copyOp(other.m_vertexArray))),
+		m_numInstances(other.m_numInstances),
+		m_instanceData(dynamic_cast<osg::FloatArray*>(copyOp(other.m_instanceData.get()))),
 		m_normalArray(dynamic_cast<osg::Vec3Array*>(copyOp(other.m_normalArray))),
 		m_texCoordArray(dynamic_cast<osg::Vec2Array*>(copyOp(other.m_texCoordArray))),
-		m_drawElements(dynamic_cast<osg::DrawElements*>(copyOp(other.m_drawElements)))
+		m_drawElements(dynamic_cast<osg::DrawElements*>(copyOp(other.m_drawElements))),
+		m_placement(other.m_placement),
+		m_statistics(other.m_statistics)
 {
 }
 
@@ -73,117 +248,592 @@ InstancedDrawable::~InstancedDrawable()
 
 osg::BoundingBox InstancedDrawable::computeBound() const
 {
-	osg::BoundingBox bb;
+	// placed instances are only known on the gpu, the generator knows where they can end up
+	if (m_placement.valid())
+		return m_placement->getGenerator().computeBound(InstanceBounds::computeLocalBound(m_vertexArray.get()));
 
-	for (auto it = m_matrixArray.begin(); it != m_matrixArray.end(); ++it)
+	// only the blocks of instances changed by setMatrix are recomputed
+	m_bounds.setLocalBound(InstanceBounds::computeLocalBound(m_vertexArray.get()));
+
+	return m_bounds.computeBound(getInstanceData(0), m_numInstances, FLOATS_PER_INSTANCE);
+}
+
+float* InstancedDrawable::beginInstanceUpdate()
+{
 	{
-		for (unsigned int i = 0; i < m_vertexArray->getNumElements(); ++i)
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+		m_writingSlot = m_slotState == SLOT_OFFERED;
+		if (m_writingSlot)
 		{
-			bb.expandBy(m_vertexArray->at(i) * (*it));
+			// write straight into the ring, the draw thread only has to pick the segment
+			m_slotState = SLOT_WRITING;
+			return m_slot;
 		}
 	}
 
-	return bb;
+	std::vector<float>& data = m_stagingData[m_writeStaging];
+	data.resize(m_numInstances * FLOATS_PER_INSTANCE);
+
+	return data.empty() ? NULL : &data.front();
+}
+
+void InstancedDrawable::endInstanceUpdate()
+{
+	// publish the written data and continue with the buffer the draw thread didn't pick up yet
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+	if (m_writingSlot)
+	{
+		// the segment is gone if the ring was released meanwhile
+		if (m_slotState == SLOT_WRITING)
+			m_slotState = SLOT_READY;
+		m_writingSlot = false;
+		return;
+	}
+
+	std::swap(m_writeStaging, m_readyStaging);
+	m_stagingReady = true;
+}
+
+void InstancedDrawable::setMatrixArray(const std::vector<osg::Matrixd>& matrixArray)
+{
+	m_numInstances = matrixArray.size();
+	resizeInstanceData(m_numInstances);
+
+	for (unsigned int i = 0; i < m_numInstances; ++i)
+	{
+		osg::Matrixf matrix = matrixArray[i];
+		memcpy(&(*m_instanceData)[i * FLOATS_PER_INSTANCE], matrix.ptr(), 16 * sizeof(float));
+	}
+
+	dirty(DIRTY_INSTANCES);
+	m_bounds.dirtyAll();
+	dirtyBound();
+}
+
+void InstancedDrawable::setAttributeArray(const std::vector<InstanceAttributes>& attributeArray)
+{
+	resizeInstanceData(m_numInstances);
+
+	for (unsigned int i = 0; i < attributeArray.size() && i < m_numInstances; ++i)
+	{
+		attributeArray[i].pack(&(*m_instanceData)[i * FLOATS_PER_INSTANCE + 16]);
+	}
+
+	dirty(DIRTY_INSTANCES);
+}
+
+void InstancedDrawable::setInstances(unsigned int numInstances, osg::ref_ptr<osg::FloatArray> instanceData)
+{
+	m_numInstances = numInstances;
+	m_instanceData = instanceData;
+	resizeInstanceData(m_numInstances);
+
+	dirty(DIRTY_INSTANCES);
+	m_bounds.dirtyAll();
+	dirtyBound();
+}
+
+void InstancedDrawable::setPlacement(osg::ref_ptr<InstancePlacement> placement)
+{
+	m_placement = placement;
+	m_dynamic = false;
+	m_numInstances = 0u;
+
+	dirty(DIRTY_INSTANCES | DIRTY_LAYOUT);
+	m_bounds.dirtyAll();
+	dirtyBound();
+}
+
+void InstancedDrawable::setMatrix(unsigned int index, const osg::Matrixd& matrix)
+{
+	osg::Matrixf floatMatrix = matrix;
+	memcpy(&(*m_instanceData)[index * FLOATS_PER_INSTANCE], floatMatrix.ptr(), 16 * sizeof(float));
+	dirtyInstances(index, index + 1);
+
+	m_bounds.dirty(index, index + 1);
+	dirtyBound();
+}
+
+void InstancedDrawable::setAttributes(unsigned int index, const InstanceAttributes& attributes)
+{
+	resizeInstanceData(m_numInstances);
+
+	attributes.pack(&(*m_instanceData)[index * FLOATS_PER_INSTANCE + 16]);
+	dirtyInstances(index, index + 1);
+}
+
+void InstancedDrawable::resizeInstanceData(unsigned int numInstances)
+{
+	if (m_instanceData.valid() && m_instanceData->size() >= numInstances * FLOATS_PER_INSTANCE)
+		return;
+
+	// never resize the current array in place, it may be shared
+	osg::ref_ptr<osg::FloatArray> instanceData = new osg::FloatArray(numInstances * FLOATS_PER_INSTANCE);
+	unsigned int numOldInstances = m_instanceData.valid() ? m_instanceData->size() / FLOATS_PER_INSTANCE : 0u;
+	if (numOldInstances > 0)
+		std::copy(m_instanceData->begin(), m_instanceData->begin() + numOldInstances * FLOATS_PER_INSTANCE, instanceData->begin());
+
+	for (unsigned int i = numOldInstances; i < numInstances; ++i)
+	{
+		InstanceAttributes().pack(&(*instanceData)[i * FLOATS_PER_INSTANCE + 16]);
+	}
+
+	m_instanceData = instanceData;
+}
+
+const float* InstancedDrawable::getInstanceData(unsigned int index) const
+{
+	if (!m_instanceData.valid() || m_instanceData->empty())
+		return NULL;
+
+	return &(*m_instanceData)[index * FLOATS_PER_INSTANCE];
+}
+
+void InstancedDrawable::dirtyInstances(unsigned int start, unsigned int end)
+{
+	end = std::min(end, m_numInstances);
+	if (start >= end)
+		return;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_dirtyRangesMutex);
+	for (unsigned int i = 0; i < m_contextData.size(); ++i)
+	{
+		m_contextData[i].dirtyInstanceRanges.push_back(InstanceRange(start, end));
+	}
+}
+
+void InstancedDrawable::dirty(unsigned int flags)
+{
+	for (unsigned int i = 0; i < m_contextData.size(); ++i)
+	{
+		m_contextData[i].dirtyFlags |= flags;
+	}
+}
+
+unsigned int InstancedDrawable::getUploadedBytes() const
+{
+	unsigned int bytes = 0u;
+	for (unsigned int i = 0; i < m_contextData.size(); ++i)
+	{
+		bytes += m_contextData[i].lastUploadedBytes;
+	}
+
+	return bytes;
+}
+
+void InstancedDrawable::computeMemoryUsage(MemoryUsage& usage) const
+{
+	// the instance data is usually shared with the builder
+	size_t instanceBytes = 0;
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		instanceBytes += m_stagingData[i].capacity() * sizeof(float);
+	}
+	usage.add(MemoryUsage::INSTANCE_STORE, instanceBytes, 0);
+	if (m_instanceData.valid())
+		usage.addOnce(m_instanceData.get(), MemoryUsage::INSTANCE_STORE, m_instanceData->getTotalDataSize(), 0);
+
+	if (m_vertexArray.valid())
+		usage.addOnce(m_vertexArray.get(), MemoryUsage::OSG_ARRAYS, m_vertexArray->getTotalDataSize(), 0);
+	if (m_normalArray.valid())
+		usage.addOnce(m_normalArray.get(), MemoryUsage::OSG_ARRAYS, m_normalArray->getTotalDataSize(), 0);
+	if (m_texCoordArray.valid())
+		usage.addOnce(m_texCoordArray.get(), MemoryUsage::OSG_ARRAYS, m_texCoordArray->getTotalDataSize(), 0);
+	if (m_drawElements.valid())
+		usage.addOnce(m_drawElements.get(), MemoryUsage::OSG_ARRAYS, m_drawElements->getTotalDataSize(), 0);
+
+	usage.add(MemoryUsage::BOUNDS_MATRICES, m_bounds.getMemoryUsage(), 0);
+
+	for (unsigned int i = 0; i < m_contextData.size(); ++i)
+	{
+		const ContextData& context = m_contextData[i];
+		size_t bufferBytes = 0;
+		if (context.vbo && m_vertexArray.valid())
+			bufferBytes += sizeof(VertexData) * m_vertexArray->size();
+		if (context.ebo && m_drawElements.valid())
+			bufferBytes += m_drawElements->getTotalDataSize();
+		// dynamic instances live in the ring buffer instead of the instance buffer
+		if (context.ringBuffer.valid())
+			bufferBytes += context.ringBuffer->getSize();
+		else if (context.instancebo)
+			bufferBytes += context.instanceBufferSize;
+		usage.add(MemoryUsage::GL_BUFFERS, 0, bufferBytes);
+
+		// the placement samples its own copies of the height and density map
+		if (m_placement.valid())
+		{
+			const ProceduralInstanceGenerator& generator = m_placement->getGenerator();
+			size_t numSamples = generator.getHeightMapWidth() * generator.getHeightMapHeight();
+			size_t mapBytes = 0;
+			if (context.placementObjects.heightTexture)
+				mapBytes += numSamples * sizeof(float);
+			if (context.placementObjects.densityTexture)
+				mapBytes += numSamples;
+			usage.add(MemoryUsage::HEIGHT_MAP, 0, mapBytes);
+		}
+	}
 }
 
 void InstancedDrawable::compileGLObjects(osg::RenderInfo& renderInfo) const
 {
-	if(!m_vbo || !m_instancebo || !m_ebo || !m_vao)
+	ContextData& context = m_contextData[renderInfo.getContextID()];
+
+	if(!context.vbo || !context.instancebo || !context.ebo || !context.vao)
 	{
 		GLuint buffers[] = {0u, 0u, 0u};
 		glGenBuffers(3, buffers);
-		m_vbo = buffers[0];
-		m_instancebo = buffers[1];
-		m_ebo = buffers[2];
-		glGenVertexArrays(1, &m_vao);
-	}
-
-	if (m_dirty) 
-	{
-		m_dirty = false;
-		// create one array to fit all vertex data
-		VertexData* vertexData = new VertexData[m_vertexArray->size()];
-		for (unsigned int i = 0; i < m_vertexArray->size(); ++i)
-		{
-			vertexData[i].vertex[0] = m_vertexArray->at(i).x();
-			vertexData[i].vertex[1] = m_vertexArray->at(i).y();
-			vertexData[i].vertex[2] = m_vertexArray->at(i).z();
-			vertexData[i].normal[0] = m_normalArray->at(i).x();
-			vertexData[i].normal[1] = m_normalArray->at(i).y();
-			vertexData[i].normal[2] = m_normalArray->at(i).z();
-			vertexData[i].texCoord[0] = m_texCoordArray->at(i).x();
-			vertexData[i].texCoord[1] = m_texCoordArray->at(i).y();
-		}
-		
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * m_vertexArray->size(), vertexData, GL_STATIC_DRAW);
-		delete[] vertexData;
-
-		// pack matrices into float array
-		osg::ref_ptr<osg::FloatArray> matrixArray = new osg::FloatArray(m_matrixArray.size()*16);
-	
-		for (unsigned int i = 0; i < m_matrixArray.size(); ++i)
-		{
-			for (unsigned int j = 0; j < 16; ++j)
+		context.vbo = buffers[0];
+		context.instancebo = buffers[1];
+		context.ebo = buffers[2];
+		glGenVertexArrays(1, &context.vao);
+		context.generation = osg::get<DeletedObjectsManager>(renderInfo.getContextID())->getGeneration();
+
+		// fresh objects need everything
+		context.dirtyFlags = DIRTY_ALL;
+	}
+
+	// both buffers are uploaded together, they are only dirty after the mesh changed
+	if (context.dirtyFlags & (DIRTY_VERTEX_DATA | DIRTY_INDEX_DATA))
+	{
+		context.dirtyFlags &= ~(DIRTY_VERTEX_DATA | DIRTY_INDEX_DATA);
+		uploadMeshData(context);
+		countUpload(renderInfo, context, sizeof(VertexData) * m_vertexArray->size() + m_drawElements->getTotalDataSize());
+	}
+
+	// a changed instance count or a switch between static and dynamic mode needs a new buffer
+	unsigned int instanceBufferSize = m_numInstances * FLOATS_PER_INSTANCE * sizeof(float);
+	if (!m_placement.valid() && (instanceBufferSize != context.instanceBufferSize || m_dynamic != context.ringBuffer.valid()))
+		context.dirtyFlags |= DIRTY_INSTANCES;
+
+	// take the ranges over, the update thread keeps adding to the emptied list meanwhile
+	std::vector<InstanceRange> ranges;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_dirtyRangesMutex);
+		ranges.swap(context.dirtyInstanceRanges);
+	}
+
+	if ((context.dirtyFlags & DIRTY_INSTANCES) && m_placement.valid())
+	{
+		// the placement writes the instances straight into the instance buffer, nothing is uploaded
+		context.dirtyFlags &= ~DIRTY_INSTANCES;
+		if (context.ringBuffer.valid())
+		{
+			context.ringBuffer->release();
+			context.ringBuffer = NULL;
+		}
+		context.baseInstance = 0u;
+		context.numPlacedInstances = m_placement->place(context.placementObjects, context.instancebo);
+		context.instanceBufferSize = m_placement->getNumCandidates() * FLOATS_PER_INSTANCE * sizeof(float);
+	}
+	else if (context.dirtyFlags & DIRTY_INSTANCES)
+	{
+		context.dirtyFlags &= ~DIRTY_INSTANCES;
+		uploadInstanceData(context);
+		countUpload(renderInfo, context, instanceBufferSize);
+	}
+	else if (!ranges.empty())
+	{
+		// merge overlapping and adjacent ranges so every gap costs one glBufferSubData
+		std::sort(ranges.begin(), ranges.end());
+
+		std::vector<InstanceRange> merged;
+		merged.push_back(ranges.front());
+		for (unsigned int i = 1; i < ranges.size(); ++i)
+		{
+			if (ranges[i].first <= merged.back().second)
+				merged.back().second = std::max(merged.back().second, ranges[i].second);
+			else
+				merged.push_back(ranges[i]);
+		}
+
+		if (m_dynamic)
+		{
+			// the ring always streams whole frames
+			uploadInstanceData(context);
+			countUpload(renderInfo, context, instanceBufferSize);
+		} else {
+			glBindBuffer(GL_ARRAY_BUFFER, context.instancebo);
+			for (auto it = merged.begin(); it != merged.end(); ++it)
+			{
+				// the instance data already has the layout of the buffer
+				unsigned int numFloats = (it->second - it->first) * FLOATS_PER_INSTANCE;
+				glBufferSubData(GL_ARRAY_BUFFER, it->first * FLOATS_PER_INSTANCE * sizeof(float), numFloats * sizeof(float), getInstanceData(it->first));
+				countUpload(renderInfo, context, numFloats * sizeof(float));
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	}
+
+	if (context.dirtyFlags & DIRTY_LAYOUT)
+	{
+		context.dirtyFlags &= ~DIRTY_LAYOUT;
+		setupVertexArray(context);
+	}
+}
+
+void InstancedDrawable::uploadMeshData(ContextData& context) const
+{
+	unsigned int numVertices = m_vertexArray->size();
+
+	// the builder optimized the mesh for the vertex cache and fetch order already(setGeometry), so the
+	// arrays are only packed into one interleaved vertex
+	VertexData* vertexData = new VertexData[numVertices];
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		VertexData& vertex = vertexData[i];
+		vertex.vertex[0] = m_vertexArray->at(i).x();
+		vertex.vertex[1] = m_vertexArray->at(i).y();
+		vertex.vertex[2] = m_vertexArray->at(i).z();
+		vertex.normal = MeshOptimizer::packNormal(m_normalArray->at(i));
+		vertex.texCoord[0] = MeshOptimizer::floatToHalf(m_texCoordArray->at(i).x());
+		vertex.texCoord[1] = MeshOptimizer::floatToHalf(m_texCoordArray->at(i).y());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, context.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * numVertices, vertexData, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	delete[] vertexData;
+
+	// the index buffer keeps the index type of the draw elements and is uploaded straight from them
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_drawElements->getTotalDataSize(), m_drawElements->getDataPointer(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void InstancedDrawable::uploadInstanceData(ContextData& context) const
+{
+	// the instance data is uploaded straight from its array
+	unsigned int instanceBufferSize = m_numInstances * FLOATS_PER_INSTANCE * sizeof(float);
+	bool resized = instanceBufferSize != context.instanceBufferSize;
+	context.instanceBufferSize = instanceBufferSize;
+
+	if (m_dynamic)
+	{
+		// the current matrices become the next frame of the ring, later frames come from beginInstanceUpdate
+		if (!context.ringBuffer.valid() || resized)
+		{
+			// the buffer name changes with every allocation, so the vao has to follow
 			{
-				(*matrixArray)[i*16+j] =  m_matrixArray[i].ptr()[j];
+				OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+				if (!context.ringBuffer.valid())
+				{
+					context.ringBuffer = new InstanceRingBuffer;
+					++m_numRingBuffers;
+				}
+				m_slotState = SLOT_NONE;
 			}
+			context.ringBuffer->allocate(context.instanceBufferSize);
+			context.dirtyFlags |= DIRTY_LAYOUT;
 		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, m_instancebo);
-		glBufferData(GL_ARRAY_BUFFER, matrixArray->getTotalDataSize(), matrixArray->getDataPointer(), GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_drawElements->getTotalDataSize(), m_drawElements->getDataPointer(), GL_STATIC_DRAW);
-
-		glBindVertexArray(m_vao);
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-		glEnableVertexAttribArray(3);
-		glEnableVertexAttribArray(4);
-		glEnableVertexAttribArray(5);
-		glEnableVertexAttribArray(6);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), 0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)(sizeof(GLfloat) * 3));
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)(sizeof(GLfloat) * 6));
-		glBindBuffer(GL_ARRAY_BUFFER, m_instancebo);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), 0);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(4  * sizeof(float)));
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(8  * sizeof(float)));
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(12 * sizeof(float)));
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-		glBindVertexArray(0);
-
-		// unbind all buffers to prevent undefined behavior of osg
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+			discardSlot();
+		}
+		// the vao keeps pointing at the start of the buffer, the draw selects the segment with the base instance
+		context.baseInstance = context.ringBuffer->upload(getInstanceData(0), context.instanceBufferSize) / (FLOATS_PER_INSTANCE * sizeof(float));
+	} else {
+		if (context.ringBuffer.valid())
+		{
+			context.ringBuffer->release();
+			context.ringBuffer = NULL;
+			context.dirtyFlags |= DIRTY_LAYOUT;
+
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+			--m_numRingBuffers;
+		}
+
+		context.baseInstance = 0u;
+		glBindBuffer(GL_ARRAY_BUFFER, context.instancebo);
+		glBufferData(GL_ARRAY_BUFFER, context.instanceBufferSize, getInstanceData(0), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 }
 
+void InstancedDrawable::setupVertexArray(ContextData& context) const
+{
+	GLuint instanceBuffer = context.ringBuffer.valid() ? context.ringBuffer->getBuffer() : context.instancebo;
+
+	glBindVertexArray(context.vao);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glEnableVertexAttribArray(3);
+	glEnableVertexAttribArray(4);
+	glEnableVertexAttribArray(5);
+	glEnableVertexAttribArray(6);
+	glEnableVertexAttribArray(7);
+	glEnableVertexAttribArray(8);
+	glBindBuffer(GL_ARRAY_BUFFER, context.vbo);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), 0);
+	glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VertexData), (GLvoid*)(sizeof(GLfloat) * 3));
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(VertexData), (GLvoid*)(sizeof(GLfloat) * 3 + sizeof(GLuint)));
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), 0);
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), (GLvoid*)(4  * sizeof(float)));
+	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), (GLvoid*)(8  * sizeof(float)));
+	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), (GLvoid*)(12 * sizeof(float)));
+	glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), (GLvoid*)(16 * sizeof(float)));
+	glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_INSTANCE * sizeof(float), (GLvoid*)(20 * sizeof(float)));
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
+	glVertexAttribDivisor(5, 1);
+	glVertexAttribDivisor(6, 1);
+	glVertexAttribDivisor(7, 1);
+	glVertexAttribDivisor(8, 1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.ebo);
+	glBindVertexArray(0);
+
+	// unbind all buffers to prevent undefined behavior of osg
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void InstancedDrawable::countUpload(osg::RenderInfo& renderInfo, ContextData& context, unsigned int bytes) const
+{
+	const osg::FrameStamp* frameStamp = renderInfo.getState() ? renderInfo.getState()->getFrameStamp() : NULL;
+
+	if (frameStamp && frameStamp->getFrameNumber() != context.uploadFrameNumber)
+	{
+		context.lastUploadedBytes = context.uploadedBytes;
+		context.uploadedBytes = 0u;
+		context.uploadFrameNumber = frameStamp->getFrameNumber();
+	}
+
+	context.uploadedBytes += bytes;
+	if (m_statistics.valid() && frameStamp && bytes)
+		m_statistics->add(frameStamp->getFrameNumber(), InstanceStatistics::UPLOADED_BYTES, bytes);
+}
+
+void InstancedDrawable::resizeGLObjectBuffers(unsigned int maxSize)
+{
+	osg::Drawable::resizeGLObjectBuffers(maxSize);
+	m_contextData.resize(maxSize);
+}
+
 void InstancedDrawable::releaseGLObjects(osg::State* state) const
 {
-    if(m_vbo && m_instancebo && m_ebo && m_vao)
+	if (state)
 	{
-		glDeleteBuffers(1, &m_vbo);
-		glDeleteBuffers(1, &m_instancebo);
-		glDeleteBuffers(1, &m_ebo);
-		glDeleteVertexArrays(1, &m_vao);
-		m_vbo = 0;
-		m_instancebo = 0;
-		m_ebo = 0;
-		m_vao = 0;
-	}	
+		// osg calls this with the context of the state current
+		unsigned int contextID = state->getContextID();
+		if (contextID < m_contextData.size())
+			releaseContextData(m_contextData[contextID], contextID, true);
+	} else {
+		for (unsigned int i = 0; i < m_contextData.size(); ++i)
+		{
+			releaseContextData(m_contextData[i], i, false);
+		}
+	}
+}
+
+void InstancedDrawable::releaseContextData(ContextData& context, unsigned int contextID, bool contextCurrent) const
+{
+	if (contextCurrent)
+	{
+		if (context.vbo && context.instancebo && context.ebo && context.vao)
+		{
+			GLuint buffers[] = {context.vbo, context.instancebo, context.ebo};
+			glDeleteBuffers(3, buffers);
+			glDeleteVertexArrays(1, &context.vao);
+		}
+
+		if (context.ringBuffer.valid())
+			context.ringBuffer->release();
+
+		if (m_placement.valid())
+			m_placement->release(context.placementObjects);
+	} else {
+		DeletedObjects objects;
+		if (context.vbo && context.instancebo && context.ebo && context.vao)
+		{
+			objects.buffers.push_back(context.vbo);
+			objects.buffers.push_back(context.instancebo);
+			objects.buffers.push_back(context.ebo);
+			objects.vertexArrays.push_back(context.vao);
+		}
+
+		if (context.ringBuffer.valid())
+			context.ringBuffer->detach(objects.buffers, objects.fences);
+
+		const InstancePlacement::GLObjects& placementObjects = context.placementObjects;
+		if (placementObjects.program)
+		{
+			objects.programs.push_back(placementObjects.program);
+			objects.vertexArrays.push_back(placementObjects.vao);
+			objects.queries.push_back(placementObjects.query);
+		}
+		if (placementObjects.heightTexture)
+			objects.textures.push_back(placementObjects.heightTexture);
+		if (placementObjects.densityTexture)
+			objects.textures.push_back(placementObjects.densityTexture);
+
+		// without any context data the context is gone and took the objects along
+		osg::ContextData* contextData = osg::getContextData(contextID);
+		if (contextData)
+			contextData->get<DeletedObjectsManager>()->scheduleForDeletion(objects, context.generation);
+	}
+
+	if (context.ringBuffer.valid())
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+		m_slotState = SLOT_NONE;
+		--m_numRingBuffers;
+	}
+
+	// the next draw in this context starts from scratch
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_dirtyRangesMutex);
+	context = ContextData();
 }
 
 void InstancedDrawable::drawImplementation(osg::RenderInfo& renderInfo) const
 {
-	glBindVertexArray(m_vao);
+	unsigned int contextID = renderInfo.getContextID();
+	ContextData& context = m_contextData[contextID];
+
+	// start a new upload statistic for every frame, even if nothing gets uploaded
+	countUpload(renderInfo, context, 0u);
+
+	bool dirtyRanges;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_dirtyRangesMutex);
+		dirtyRanges = !context.dirtyInstanceRanges.empty();
+	}
+
+	if (!context.vao || context.dirtyFlags || dirtyRanges)
+		compileGLObjects(renderInfo);
+
+	if (m_dynamic && context.ringBuffer.valid())
+	{
+		// pick up the newest instance data the update thread has published, the copy into the ring happens
+		// under the lock because other contexts may swap the draw buffer meanwhile
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+		if (m_slotState == SLOT_READY)
+		{
+			// the update thread wrote the reserved segment, nothing to copy
+			m_slotState = SLOT_NONE;
+			context.baseInstance = m_slotOffset / (FLOATS_PER_INSTANCE * sizeof(float));
+			countUpload(renderInfo, context, context.instanceBufferSize);
+		}
+
+		if (m_stagingReady)
+		{
+			std::swap(m_drawStaging, m_readyStaging);
+			m_stagingReady = false;
+			++m_stagingGeneration;
+		}
+
+		const std::vector<float>& data = m_stagingData[m_drawStaging];
+		if (context.stagingGeneration != m_stagingGeneration && !data.empty())
+		{
+			discardSlot();
+			context.baseInstance = context.ringBuffer->upload(&data.front(), data.size() * sizeof(float)) / (FLOATS_PER_INSTANCE * sizeof(float));
+			countUpload(renderInfo, context, data.size() * sizeof(float));
+		}
+		context.stagingGeneration = m_stagingGeneration;
+	}
+
+	glBindVertexArray(context.vao);
 	GLenum dataType;
 	switch(m_drawElements->getType())
 	{
@@ -199,8 +849,39 @@ void InstancedDrawable::drawImplementation(osg::RenderInfo& renderInfo) const
 		break;
 	}
 
-	glDrawElementsInstanced(m_drawElements->getMode(), m_drawElements->getNumIndices(), dataType, NULL, m_drawElements->getNumInstances());
+	unsigned int numInstances = m_placement.valid() ? context.numPlacedInstances : m_drawElements->getNumInstances();
+	if (m_placement.valid() && m_statistics.valid() && renderInfo.getState()->getFrameStamp())
+		m_statistics->add(renderInfo.getState()->getFrameStamp()->getFrameNumber(), InstanceStatistics::VISIBLE_INSTANCES, numInstances);
+	if (context.baseInstance)
+	{
+		// the instance attributes of the current ring segment start at the base instance
+		glDrawElementsInstancedBaseInstance(m_drawElements->getMode(), m_drawElements->getNumIndices(), dataType, NULL, numInstances, context.baseInstance);
+	} else if (numInstances) {
+		glDrawElementsInstanced(m_drawElements->getMode(), m_drawElements->getNumIndices(), dataType, NULL, numInstances);
+	}
 	glBindVertexArray(0);
+
+	if (m_dynamic && context.ringBuffer.valid())
+	{
+		context.ringBuffer->fence(context.baseInstance * FLOATS_PER_INSTANCE * sizeof(float));
+
+		// reserve the segment after the drawn one for the next update, it is free once the gpu finished the
+		// frame before the last one. With several contexts every one of them copies from the staging data.
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_stagingMutex);
+		if (m_slotState == SLOT_NONE && context.ringBuffer->isPersistent() && m_numRingBuffers == 1)
+		{
+			m_slotOffset = context.ringBuffer->reserve();
+			m_slot = (float*)context.ringBuffer->getMappedData(m_slotOffset);
+			m_slotState = SLOT_OFFERED;
+		}
+	}
+}
+
+void InstancedDrawable::discardSlot() const
+{
+	// an upload may land on the offered segment, a segment being written stays reserved for one frame
+	if (m_slotState == SLOT_OFFERED)
+		m_slotState = SLOT_NONE;
 }
 
 void InstancedDrawable::accept(osg::PrimitiveFunctor& functor) const
@@ -24,12 +24,28 @@
 #ifndef _INSTANCED_GEOMETRY_H
 #define _INSTANCED_GEOMETRY_H
 
+// std
+#include <vector>
+#include <utility>
+
 // osg
 #include <osg/Drawable>
+#include <osg/buffered_value>
+#include <osg/Array>
+#include <OpenThreads/Mutex>
+
+// osgExample
+#include "InstanceAttributes.h"
+#include "InstanceBounds.h"
+#include "InstancePlacement.h"
+#include "InstanceStatistics.h"
+#include "MemoryUsage.h"
 
 namespace osgExample
 {
 
+class InstanceRingBuffer;
+
 class InstancedDrawable : public osg::Drawable
 {
 public:
@@ -38,33 +54,155 @@ public:
 
 	META_Object(osgExample, InstancedDrawable)
 
+	// number of floats every instance occupies in the instance buffer
+	static const unsigned int FLOATS_PER_INSTANCE = 16 + InstanceAttributes::NUM_VECTORS * 4;
+
 	virtual osg::BoundingBox computeBound() const;
+	// also called ahead of the first draw by the IncrementalCompileOperation
 	virtual void compileGLObjects(osg::RenderInfo& renderInfo) const;
 	virtual void drawImplementation(osg::RenderInfo& renderInfo) const;
 	virtual void accept(osg::PrimitiveFunctor& functor) const;
+	virtual void resizeGLObjectBuffers(unsigned int maxSize);
 	virtual void releaseGLObjects(osg::State* state) const;
 
-	inline void setVertexArray(osg::ref_ptr<osg::Vec3Array> vertexArray) { m_vertexArray = vertexArray;  m_dirty = true; }
-	inline void setMatrixArray(const std::vector<osg::Matrixd>& matrixArray) { m_matrixArray = matrixArray;  m_dirty = true; }
-	inline void setNormalArray(osg::ref_ptr<osg::Vec3Array> normalArray) { m_normalArray = normalArray; m_dirty = true; }
-	inline void setTexCoordArray(osg::ref_ptr<osg::Vec2Array> texCoordArray) { m_texCoordArray = texCoordArray; m_dirty = true; }
-	inline void setDrawElements(osg::ref_ptr<osg::DrawElements> drawElements) { m_drawElements = drawElements; m_dirty = true; }
+	inline void setVertexArray(osg::ref_ptr<osg::Vec3Array> vertexArray) { m_vertexArray = vertexArray; dirty(DIRTY_VERTEX_DATA); }
+	void setMatrixArray(const std::vector<osg::Matrixd>& matrixArray);
+	void setAttributeArray(const std::vector<InstanceAttributes>& attributeArray);
+	// instanceData already holds FLOATS_PER_INSTANCE floats for every instance in the layout of the instance
+	// buffer, it is uploaded without any conversion, may be shared with the builder and also gives the bounds
+	void setInstances(unsigned int numInstances, osg::ref_ptr<osg::FloatArray> instanceData);
+	inline void setNormalArray(osg::ref_ptr<osg::Vec3Array> normalArray) { m_normalArray = normalArray; dirty(DIRTY_VERTEX_DATA); }
+	inline void setTexCoordArray(osg::ref_ptr<osg::Vec2Array> texCoordArray) { m_texCoordArray = texCoordArray; dirty(DIRTY_VERTEX_DATA); }
+	inline void setDrawElements(osg::ref_ptr<osg::DrawElements> drawElements) { m_drawElements = drawElements; dirty(DIRTY_INDEX_DATA); }
+
+	// change single instances, only the modified ranges get uploaded on the next draw
+	void setMatrix(unsigned int index, const osg::Matrixd& matrix);
+	void setAttributes(unsigned int index, const InstanceAttributes& attributes);
+	void dirtyInstances(unsigned int start, unsigned int end);
+
+	inline void dirtyArrays() { dirty(DIRTY_VERTEX_DATA | DIRTY_INDEX_DATA | DIRTY_INSTANCES); }
+
+	// number of bytes uploaded to the gpu during the last frame, summed over all contexts
+	unsigned int getUploadedBytes() const;
+
+	// adds the instance store, the mesh arrays, the block bounds and the gl buffers of every context,
+	// the latter may lag one frame behind while the draw thread uploads
+	void computeMemoryUsage(MemoryUsage& usage) const;
+
+	// in dynamic mode the instance data is streamed through a ring buffer every time it changes
+	inline void setDynamic(bool dynamic) { m_dynamic = dynamic; dirty(DIRTY_INSTANCES | DIRTY_LAYOUT); }
+	inline bool getDynamic() const { return m_dynamic; }
+
+	// the instances are written by the placement on the gpu instead of being uploaded, the drawable
+	// draws as many as survive and has no matrices of its own
+	void setPlacement(osg::ref_ptr<InstancePlacement> placement);
+	inline osg::ref_ptr<InstancePlacement> getPlacement() const { return m_placement; }
+
+	// every draw adds the uploaded bytes and, for placed instances, the drawn instances to the statistics
+	inline void setStatistics(osg::ref_ptr<InstanceStatistics> statistics) { m_statistics = statistics; }
+	inline osg::ref_ptr<InstanceStatistics> getStatistics() const { return m_statistics; }
 
-	inline void dirtyArrays() { m_dirty = true; }
+	// Returns FLOATS_PER_INSTANCE floats for every instance which the update thread may fill for the
+	// next frame while the current one is still drawn. endInstanceUpdate hands the data to the draw thread.
+	// With a persistent ring buffer and a single context this is the ring segment the draw thread has
+	// reserved, so the data must be written sequentially and never read back.
+	float* beginInstanceUpdate();
+	void endInstanceUpdate();
 protected:
 	virtual ~InstancedDrawable();
 private:
-	mutable bool						m_dirty;
-	mutable GLuint						m_vao;
-	mutable GLuint						m_vbo;
-	mutable GLuint						m_instancebo;
-	mutable GLuint						m_ebo;
+	typedef std::pair<unsigned int, unsigned int> InstanceRange;
+
+	// ring segment handed to the update thread, it is reserved after a draw and drawn once it is written
+	enum SlotState
+	{
+		SLOT_NONE,
+		SLOT_OFFERED,
+		SLOT_WRITING,
+		SLOT_READY
+	};
+
+	enum DirtyFlags
+	{
+		DIRTY_VERTEX_DATA	= 1u,
+		DIRTY_INDEX_DATA	= 2u,
+		DIRTY_INSTANCES		= 4u,
+		DIRTY_LAYOUT		= 8u,
+		DIRTY_ALL			= 15u
+	};
+
+	// gl objects and upload state of one graphics context, every context compiles its own copy
+	struct ContextData
+	{
+		ContextData();
+
+		unsigned int						dirtyFlags;
+		// written by the update thread, guarded by m_dirtyRangesMutex
+		std::vector<InstanceRange>			dirtyInstanceRanges;
+		unsigned int						instanceBufferSize;
+		unsigned int						uploadedBytes;
+		unsigned int						lastUploadedBytes;
+		unsigned int						uploadFrameNumber;
+		GLuint								vao;
+		GLuint								vbo;
+		GLuint								instancebo;
+		GLuint								ebo;
+		osg::ref_ptr<InstanceRingBuffer>	ringBuffer;
+		GLuint								baseInstance;
+		unsigned int						stagingGeneration;
+		InstancePlacement::GLObjects		placementObjects;
+		unsigned int						numPlacedInstances;
+		// of the context when the objects were created, released objects of a closed context are dropped
+		unsigned int						generation;
+	};
+
+	// marks the data dirty for every context
+	void dirty(unsigned int flags);
+
+	void uploadMeshData(ContextData& context) const;
+	void uploadInstanceData(ContextData& context) const;
+	void setupVertexArray(ContextData& context) const;
+	// makes sure the instance data has room for numInstances, new instances get the default attributes
+	void resizeInstanceData(unsigned int numInstances);
+	const float* getInstanceData(unsigned int index) const;
+	void countUpload(osg::RenderInfo& renderInfo, ContextData& context, unsigned int bytes) const;
+	// deletes the objects directly if their context is current, otherwise with osg's next flush of deleted gl objects
+	void releaseContextData(ContextData& context, unsigned int contextID, bool contextCurrent) const;
+	// takes the reserved segment back from the update thread unless it is being written, needs m_stagingMutex
+	void discardSlot() const;
+
+	mutable osg::buffered_object<ContextData> m_contextData;
+
+	bool								m_dynamic;
+
+	// triple buffered instance data between update and draw thread, every published buffer increments
+	// the generation so each context knows whether it streamed the newest data already
+	mutable std::vector<float>			m_stagingData[3];
+	unsigned int						m_writeStaging;
+	mutable unsigned int				m_readyStaging;
+	mutable unsigned int				m_drawStaging;
+	mutable bool						m_stagingReady;
+	mutable unsigned int				m_stagingGeneration;
+	mutable SlotState					m_slotState;
+	mutable float*						m_slot;
+	mutable GLintptr					m_slotOffset;
+	bool								m_writingSlot;
+	// contexts with a ring buffer, m_contextData has room for every possible context
+	mutable unsigned int				m_numRingBuffers;
+	mutable OpenThreads::Mutex			m_stagingMutex;
+
+	mutable OpenThreads::Mutex			m_dirtyRangesMutex;
+
+	mutable InstanceBounds				m_bounds;
 
 	osg::ref_ptr<osg::Vec3Array>		m_vertexArray;
-	std::vector<osg::Matrixd>			m_matrixArray;
+	unsigned int						m_numInstances;
+	osg::ref_ptr<osg::FloatArray>		m_instanceData;
 	osg::ref_ptr<osg::Vec3Array>		m_normalArray;
 	osg::ref_ptr<osg::Vec2Array>		m_texCoordArray;
 	osg::ref_ptr<osg::DrawElements>		m_drawElements;
+	osg::ref_ptr<InstancePlacement>		m_placement;
+	osg::ref_ptr<InstanceStatistics>	m_statistics;
 };
 
 } // namespace osgExample
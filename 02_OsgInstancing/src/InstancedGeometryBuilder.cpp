@@ -26,6 +26,8 @@
 
 // std
 #include <cstring>
+#include <cfloat>
+#include <algorithm>
 
 // osg
 #include <osg/Uniform>
@@ -35,44 +37,128 @@
 #include <osgDB/ReadFile>
 #include <osg/Image>
 #include <osg/TextureRectangle>
+#include <osg/TextureBuffer>
 #include <osg/BufferObject>
 #include <osg/BufferIndexBinding>
+#include <osg/Program>
+#include <osg/Notify>
 
 // osgExample
 #include "ComputeInstanceBoundingBoxCallback.h"
 #include "ComputeTextureBoundingBoxCallback.h"
 #include "MatrixUniformUpdateCallback.h"
+#include "AnimateInstancesUpdateCallback.h"
+#include "InstanceQuantizer.h"
+#include "InstanceBounds.h"
+#include "InstanceStatisticsCallback.h"
+#include "GpuTimerDrawCallback.h"
 
 namespace osgExample
 {
 
+void InstancedGeometryBuilder::setGeometry(osg::ref_ptr<osg::Geometry> geometry)
+{
+	m_geometry = geometry;
+	MeshOptimizer::optimizeGeometry(*m_geometry);
+
+	// the current scene still draws the old mesh while the next one is built
+	MeshPool::MeshRange oldRange = m_meshRange;
+	m_meshRange = m_meshPool->addMesh(*m_geometry);
+	m_meshPool->removeMesh(oldRange);
+}
+
+void InstancedGeometryBuilder::addMatrix(const osg::Matrixd& matrix, const InstanceAttributes& attributes)
+{
+	m_matrices.push_back(matrix);
+	m_attributes.push_back(attributes);
+
+	// the instance data always covers full rows of the instance texture, so the texture can use it directly
+	unsigned int numRows = (m_matrices.size() + INSTANCES_PER_ROW - 1) / INSTANCES_PER_ROW;
+	if (m_instanceData->size() < numRows * INSTANCES_PER_ROW * InstancedDrawable::FLOATS_PER_INSTANCE)
+		m_instanceData->resize(numRows * INSTANCES_PER_ROW * InstancedDrawable::FLOATS_PER_INSTANCE, 0.0f);
+
+	// convert the matrix to float once, every technique but the uniform arrays reads this data
+	float* data = &(*m_instanceData)[(m_matrices.size() - 1) * InstancedDrawable::FLOATS_PER_INSTANCE];
+	osg::Matrixf floatMatrix = matrix;
+	memcpy(data, floatMatrix.ptr(), 16 * sizeof(float));
+	attributes.pack(data + 16);
+}
+
+void InstancedGeometryBuilder::computeMemoryUsage(MemoryUsage& usage) const
+{
+	usage.add(MemoryUsage::INSTANCE_STORE, m_matrices.capacity() * sizeof(osg::Matrixd) + m_attributes.capacity() * sizeof(InstanceAttributes), 0);
+	if (m_instanceData.valid())
+		usage.addOnce(m_instanceData.get(), MemoryUsage::INSTANCE_STORE, m_instanceData->getTotalDataSize(), 0);
+	m_meshPool->computeMemoryUsage(usage);
+}
+
+void InstancedGeometryBuilder::clearMatrices()
+{
+	m_matrices.clear();
+	m_attributes.clear();
+	m_instanceData = new osg::FloatArray(INSTANCES_PER_ROW * InstancedDrawable::FLOATS_PER_INSTANCE);
+}
+
+void InstancedGeometryBuilder::reserveMatrices(unsigned int count)
+{
+	unsigned int numRows = (count + INSTANCES_PER_ROW - 1) / INSTANCES_PER_ROW;
+	m_matrices.reserve(count);
+	m_attributes.reserve(count);
+	m_instanceData->reserve(numRows * INSTANCES_PER_ROW * InstancedDrawable::FLOATS_PER_INSTANCE);
+}
+
+osg::ref_ptr<osg::BufferObject> InstancedGeometryBuilder::getInstanceBufferObject() const
+{
+	// the gl buffer is uploaded once and bound as uniform and as shader storage buffer
+	if (!m_instanceData->getBufferObject())
+	{
+		osg::ref_ptr<osg::UniformBufferObject> ubo = new osg::UniformBufferObject;
+		ubo->setUsage(GL_STATIC_DRAW_ARB);
+		ubo->setDataVariance(osg::Object::STATIC);
+		m_instanceData->setBufferObject(ubo);
+	}
+
+	return m_instanceData->getBufferObject();
+}
+
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getSoftwareInstancedNode() const
 {
 	// create Group to contain all instances
 	osg::ref_ptr<osg::Group>	group = new osg::Group;
 
-	// create Geode to wrap Geometry
+	// create Geode to wrap Geometry, it is culled once for every instance
 	osg::ref_ptr<osg::Geode>	geode = new osg::Geode;
 	geode->addDrawable(m_geometry);
+	addChunkStatistics(geode, 1);
 
 	// now create a MatrixTransform for each matrix in the list
-	for (auto it = m_matrices.begin(); it != m_matrices.end(); ++it)
+	for (unsigned int i = 0; i < m_matrices.size(); ++i)
 	{
-		osg::ref_ptr<osg::MatrixTransform> matrixTransform = new osg::MatrixTransform(*it);
+		osg::ref_ptr<osg::MatrixTransform> matrixTransform = new osg::MatrixTransform(m_matrices[i]);
+
+		// the instance attributes are just plain uniforms without instancing
+		float attributes[InstanceAttributes::NUM_VECTORS * 4];
+		m_attributes[i].pack(attributes);
+		osg::ref_ptr<osg::Uniform> attributeUniform = new osg::Uniform(osg::Uniform::FLOAT_VEC4, "instanceAttributes", InstanceAttributes::NUM_VECTORS);
+		for (unsigned int j = 0; j < InstanceAttributes::NUM_VECTORS; ++j)
+		{
+			attributeUniform->setElement(j, osg::Vec4(attributes[j*4], attributes[j*4+1], attributes[j*4+2], attributes[j*4+3]));
+		}
+		matrixTransform->getOrCreateStateSet()->addUniform(attributeUniform);
 
 		matrixTransform->addChild(geode);
 		group->addChild(matrixTransform);
 	}
 
 	osg::ref_ptr<osg::Program> program = new osg::Program;
-	osg::ref_ptr<osg::Shader> vsShader = osgDB::readShaderFile("../shader/no_instancing.vert");
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/no_instancing.vert", "");
 	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/no_instancing.frag");
 	program->addShader(vsShader);
 	program->addShader(fsShader);
 
 	group->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
 	
-	return group;
+	return addTechniqueStatistics(group, m_matrices.size());
 }
 
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getHardwareInstancedNode() const
@@ -83,17 +169,17 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getHardwareInstancedNode() con
 	if (m_matrices.size() <= m_maxMatrixUniforms)
 	{
 		// we don't have more matrices than uniform space so we only need one geode
-		instancedNode = createHardwareInstancedGeode(0, m_matrices.size());
+		instancedNode = addChunkStatistics(createHardwareInstancedGeode(0, m_matrices.size()), m_matrices.size());
 	} else {
 		// we need to split up instances into several geodes
 		osg::ref_ptr<osg::Group> group = new osg::Group;
 
-		unsigned int numGeodes = m_matrices.size() / m_maxMatrixUniforms;
+		unsigned int numGeodes = (m_matrices.size() + m_maxMatrixUniforms - 1) / m_maxMatrixUniforms;
 		for (unsigned int i = 0; i < numGeodes; ++i)
 		{
 			unsigned int start = i*m_maxMatrixUniforms;
 			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + m_maxMatrixUniforms));
-			group->addChild(createHardwareInstancedGeode(start, end));
+			group->addChild(addChunkStatistics(createHardwareInstancedGeode(start, end), end - start));
 		}
 		instancedNode = group;
 	}
@@ -102,14 +188,14 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getHardwareInstancedNode() con
 		
 	std::stringstream preprocessorDefinition;
 	preprocessorDefinition << "#define MAX_INSTANCES " << m_maxMatrixUniforms;
-	osg::ref_ptr<osg::Shader> vsShader = readShaderFile("../shader/instancing.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/instancing.vert", preprocessorDefinition.str());
 	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/instancing.frag");
 	program->addShader(vsShader);
 	program->addShader(fsShader);
 
 	instancedNode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
 
-	return instancedNode;
+	return addCameraUniforms(instancedNode, m_matrices.size());
 }
 
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getTextureHardwareInstancedNode() const
@@ -120,17 +206,17 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getTextureHardwareInstancedNod
 	if (m_matrices.size() <= m_maxTextureResolution)
 	{
 		// we don't have more matrices than uniform space so we only need one geode
-		instancedNode = createTextureHardwareInstancedGeode(0, m_matrices.size());
+		instancedNode = addChunkStatistics(createTextureHardwareInstancedGeode(0, m_matrices.size()), m_matrices.size());
 	} else {
 		// we need to split up instances into several geodes
 		osg::ref_ptr<osg::Group> group = new osg::Group;
 
-		unsigned int numGeodes = m_matrices.size() / m_maxTextureResolution;
+		unsigned int numGeodes = (m_matrices.size() + m_maxTextureResolution - 1) / m_maxTextureResolution;
 		for (unsigned int i = 0; i < numGeodes; ++i)
 		{
 			unsigned int start = i*m_maxTextureResolution;
 			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + m_maxTextureResolution));
-			group->addChild(createTextureHardwareInstancedGeode(start, end));
+			group->addChild(addChunkStatistics(createTextureHardwareInstancedGeode(start, end), end - start));
 		}
 		instancedNode = group;
 	}
@@ -138,78 +224,192 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getTextureHardwareInstancedNod
 	
 	// add shaders
 	osg::ref_ptr<osg::Program> program = new osg::Program;
-	osg::ref_ptr<osg::Shader> vsShader = osgDB::readShaderFile("../shader/texture_instancing.vert");
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define INSTANCES_PER_ROW " << INSTANCES_PER_ROW << std::endl;
+	preprocessorDefinition << "#define TEXELS_PER_INSTANCE " << (4u + InstanceAttributes::NUM_VECTORS);
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/texture_instancing.vert", preprocessorDefinition.str());
 	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/texture_instancing.frag");
 	program->addShader(vsShader);
 	program->addShader(fsShader);
 
 	instancedNode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
 
-	return instancedNode;
+	return addCameraUniforms(instancedNode, m_matrices.size());
 }
 
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getUBOHardwareInstancedNode() const
 {
 	osg::ref_ptr<osg::Node> instancedNode;
 
-	m_floatArrays.clear();
-
-	unsigned int maxUBOMatrices = (m_maxUniformBlockSize / 64);
+	// every instance occupies one matrix and its attributes in the std140 block, the chunks are ranges of
+	// one buffer and their offsets have to respect GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT(at most 256 bytes)
+	unsigned int maxUBOMatrices = (m_maxUniformBlockSize / ((4 + InstanceAttributes::NUM_VECTORS) * 16));
+	if (maxUBOMatrices > INSTANCE_ALIGNMENT)
+		maxUBOMatrices -= maxUBOMatrices % INSTANCE_ALIGNMENT;
 
 	// first check if we need to split up the geometry in groups
 	if (m_matrices.size() <= maxUBOMatrices)
 	{
-		// we don't have more matrices than uniform space so we only need one geode
-		instancedNode = createUBOHardwareInstancedGeode(0, m_matrices.size(), maxUBOMatrices);
+		// we don't have more matrices than uniform space so we only need one geode with a block of matching size
+		maxUBOMatrices = std::max((unsigned int)m_matrices.size(), 1u);
+		instancedNode = addChunkStatistics(createUBOHardwareInstancedGeode(0, m_matrices.size(), maxUBOMatrices), m_matrices.size());
 	} else {
 		// we need to split up instances into several geodes
 		osg::ref_ptr<osg::Group> group = new osg::Group;
 
-		unsigned int numGeodes = m_matrices.size() / maxUBOMatrices;
+		unsigned int numGeodes = (m_matrices.size() + maxUBOMatrices - 1) / maxUBOMatrices;
 		for (unsigned int i = 0; i < numGeodes; ++i)
 		{
 			unsigned int start = i*maxUBOMatrices;
 			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + maxUBOMatrices));
-			group->addChild(createUBOHardwareInstancedGeode(start, end, maxUBOMatrices));
+			group->addChild(addChunkStatistics(createUBOHardwareInstancedGeode(start, end, maxUBOMatrices), end - start));
+		}
+		instancedNode = group;
+	}
+
+	// add shaders
+	instancedNode->getOrCreateStateSet()->setAttributeAndModes(createUBOProgram(maxUBOMatrices), osg::StateAttribute::ON);
+
+	return addCameraUniforms(instancedNode, m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getShaderStorageBufferHardwareInstancedNode() const
+{
+	// without shader storage buffers we fall back to chunked uniform buffers
+	unsigned int maxSSBOInstances = m_maxShaderStorageBlockSize / ((4 + InstanceAttributes::NUM_VECTORS) * 16);
+	if (maxSSBOInstances == 0)
+		return getUBOHardwareInstancedNode();
+	if (maxSSBOInstances > INSTANCE_ALIGNMENT)
+		maxSSBOInstances -= maxSSBOInstances % INSTANCE_ALIGNMENT;
+
+	osg::ref_ptr<osg::Node> instancedNode;
+
+	// usually all instances fit into one buffer and need a single draw call
+	if (m_matrices.size() <= maxSSBOInstances)
+	{
+		instancedNode = addChunkStatistics(createShaderStorageBufferHardwareInstancedGeode(0, m_matrices.size()), m_matrices.size());
+	} else {
+		osg::ref_ptr<osg::Group> group = new osg::Group;
+
+		unsigned int numGeodes = (m_matrices.size() + maxSSBOInstances - 1) / maxSSBOInstances;
+		for (unsigned int i = 0; i < numGeodes; ++i)
+		{
+			unsigned int start = i*maxSSBOInstances;
+			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + maxSSBOInstances));
+			group->addChild(addChunkStatistics(createShaderStorageBufferHardwareInstancedGeode(start, end), end - start));
 		}
 		instancedNode = group;
 	}
 
-	
 	// add shaders
 	osg::ref_ptr<osg::Program> program = new osg::Program;
-	std::stringstream preprocessorDefinition;
-	preprocessorDefinition << "#define MAX_INSTANCES " << maxUBOMatrices;
-	osg::ref_ptr<osg::Shader> vsShader = readShaderFile("../shader/ubo_instancing.vert", preprocessorDefinition.str());
-	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/ubo_instancing.frag");
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/ssbo_instancing.vert", "");
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/ssbo_instancing.frag");
 	program->addShader(vsShader);
 	program->addShader(fsShader);
-	program->addBindUniformBlock("instanceData", 0);
 
 	instancedNode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
 
-	return instancedNode;
+	return addCameraUniforms(instancedNode, m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getTextureBufferHardwareInstancedNode(TextureBufferFormat format) const
+{
+	osg::ref_ptr<osg::Node> instancedNode;
+
+	// a texture buffer holds exactly the instances we have, only the texel limit forces a split,
+	// quantized chunks may fall back to the packed format so they have to respect its limit
+	unsigned int texelsPerInstance = (format == TEXTURE_BUFFER_FLOAT) ? 4u + InstanceAttributes::NUM_VECTORS : 4u;
+	unsigned int maxInstances = m_maxTextureBufferSize / texelsPerInstance;
+
+	if (m_matrices.size() <= maxInstances)
+	{
+		instancedNode = addChunkStatistics(createTextureBufferHardwareInstancedGeode(0, m_matrices.size(), format), m_matrices.size());
+	} else {
+		osg::ref_ptr<osg::Group> group = new osg::Group;
+
+		unsigned int numGeodes = (m_matrices.size() + maxInstances - 1) / maxInstances;
+		for (unsigned int i = 0; i < numGeodes; ++i)
+		{
+			unsigned int start = i*maxInstances;
+			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + maxInstances));
+			group->addChild(addChunkStatistics(createTextureBufferHardwareInstancedGeode(start, end, format), end - start));
+		}
+		instancedNode = group;
+	}
+
+	// add shaders
+	instancedNode->getOrCreateStateSet()->setAttributeAndModes(createTextureBufferProgram(format), osg::StateAttribute::ON);
+
+	return addCameraUniforms(instancedNode, m_matrices.size());
 }
 
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getVertexAttribHardwareInstancedNode() const
+{
+	osg::ref_ptr<InstancedDrawable> drawable = createInstancedDrawable(m_matrices.size());
+	drawable->setInstances(m_matrices.size(), m_instanceData);
+
+	if (m_dynamicInstances)
+	{
+		drawable->setDynamic(true);
+		drawable->setUpdateCallback(new AnimateInstancesUpdateCallback(m_matrices, m_attributes));
+	}
+	else if (m_windGust)
+	{
+		// the gust changes the instance data in place, the other techniques keep sharing the original
+		drawable->setInstances(m_matrices.size(), new osg::FloatArray(*m_instanceData));
+		drawable->setUpdateCallback(new AnimateInstancesUpdateCallback(m_matrices, m_attributes));
+	}
+
+	return createInstancedDrawableNode(drawable, m_matrices.size(), m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getPlacedInstancedNode(osg::ref_ptr<InstancePlacement> placement, bool gpuPlacement) const
+{
+	osg::ref_ptr<InstancedDrawable> drawable;
+	unsigned int numPlacedInstances = 0u;
+	if (gpuPlacement)
+	{
+		// the instance count is only known once the placement ran
+		drawable = createInstancedDrawable(0u);
+		drawable->setPlacement(placement);
+	} else {
+		// the cpu fallback produces the same instances and draws them like the vertex attribute technique
+		osg::ref_ptr<osg::FloatArray> instanceData = new osg::FloatArray;
+		numPlacedInstances = placement->placeOnCpu(*instanceData);
+
+		drawable = createInstancedDrawable(numPlacedInstances);
+		drawable->setInstances(numPlacedInstances, instanceData);
+	}
+
+	// all candidates count as submitted, the ones the density map removes as culled
+	return createInstancedDrawableNode(drawable, placement->getNumCandidates(), numPlacedInstances);
+}
+
+osg::ref_ptr<InstancedDrawable> InstancedGeometryBuilder::createInstancedDrawable(unsigned int numInstances) const
 {
 	// create custom instanced drawable
 	osg::ref_ptr<InstancedDrawable> drawable = new InstancedDrawable;
 	drawable->setVertexArray(dynamic_cast<osg::Vec3Array*>(m_geometry->getVertexArray()));
 	drawable->setNormalArray(dynamic_cast<osg::Vec3Array*>(m_geometry->getNormalArray()));
 	drawable->setTexCoordArray(dynamic_cast<osg::Vec2Array*>(m_geometry->getTexCoordArray(0)));
+	drawable->setStatistics(m_statistics);
 	
 	osg::ref_ptr<osg::DrawElementsUByte> instancedPrimitive = dynamic_cast<osg::DrawElementsUByte*>(m_geometry->getPrimitiveSet(0)->clone(osg::CopyOp::DEEP_COPY_ALL));
-	instancedPrimitive->setNumInstances(m_matrices.size());
+	instancedPrimitive->setNumInstances(numInstances);
 	drawable->setDrawElements(instancedPrimitive);
-	drawable->setMatrixArray(m_matrices);
 
+	return drawable;
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createInstancedDrawableNode(osg::ref_ptr<InstancedDrawable> drawable, unsigned int numInstances, unsigned int numVisibleInstances) const
+{
 	// create geode and program to wrap the drawable
 	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
 	geode->addDrawable(drawable);
 
 	osg::ref_ptr<osg::Program> program = new osg::Program;
-	osg::ref_ptr<osg::Shader> vsShader = osgDB::readShaderFile("../shader/attribute_instancing.vert");
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/attribute_instancing.vert", "");
 	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/attribute_instancing.frag");
 	program->addShader(vsShader);
 	program->addShader(fsShader);
@@ -217,15 +417,267 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getVertexAttribHardwareInstanc
 	program->addBindAttribLocation("vNormal", 1);
 	program->addBindAttribLocation("vTexCoord", 2);
 	program->addBindAttribLocation("vInstanceModelMatrix", 3);
+	program->addBindAttribLocation("vInstanceTint", 7);
+	program->addBindAttribLocation("vInstanceParams", 8);
 	geode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
 
-	// add matrix uniforms and update callback
-	osg::ref_ptr<osgExample::MatrixUniformUpdateCallback> updateCallback = new osgExample::MatrixUniformUpdateCallback;
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getModelViewProjectionMatrixUniform());
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getNormalMatrixUniform());
-	geode->setCullCallback(updateCallback);
+	// instances placed on the gpu are only known there, the drawable counts them when it draws
+	addChunkStatistics(geode, numVisibleInstances);
 
-	return geode;
+	return addCameraUniforms(geode, numInstances);
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getVertexPullingNode() const
+{
+	osg::ref_ptr<osg::Node> instancedNode;
+
+	// the instances are fetched from the float instance data like in the float texture buffer technique
+	unsigned int texelsPerInstance = 4u + InstanceAttributes::NUM_VECTORS;
+	unsigned int maxInstances = m_maxTextureBufferSize / texelsPerInstance;
+
+	if (m_matrices.size() <= maxInstances)
+	{
+		instancedNode = addChunkStatistics(createVertexPullingGeode(0, m_matrices.size()), m_matrices.size());
+	} else {
+		osg::ref_ptr<osg::Group> group = new osg::Group;
+
+		unsigned int numGeodes = (m_matrices.size() + maxInstances - 1) / maxInstances;
+		for (unsigned int i = 0; i < numGeodes; ++i)
+		{
+			unsigned int start = i*maxInstances;
+			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + maxInstances));
+			group->addChild(addChunkStatistics(createVertexPullingGeode(start, end), end - start));
+		}
+		instancedNode = group;
+	}
+
+	// every chunk pulls the same mesh out of the pool
+	osg::ref_ptr<osg::StateSet> stateSet = instancedNode->getOrCreateStateSet();
+	stateSet->setTextureAttribute(2, m_meshPool->getVertexTexture(), osg::StateAttribute::ON);
+	stateSet->setTextureAttribute(3, m_meshPool->getIndexTexture(), osg::StateAttribute::ON);
+	stateSet->addUniform(new osg::Uniform("vertexBuffer", 2));
+	stateSet->addUniform(new osg::Uniform("indexBuffer", 3));
+	stateSet->addUniform(new osg::Uniform("firstVertex", (int)m_meshRange.firstVertex));
+	stateSet->addUniform(new osg::Uniform("firstIndex", (int)m_meshRange.firstIndex));
+
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define TEXELS_PER_INSTANCE " << texelsPerInstance << std::endl;
+	preprocessorDefinition << "#define TEXELS_PER_VERTEX " << MeshPool::TEXELS_PER_VERTEX;
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/vertex_pulling.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/vertex_pulling.frag");
+	program->addShader(vsShader);
+	program->addShader(fsShader);
+	stateSet->setAttributeAndModes(program, osg::StateAttribute::ON);
+
+	return addCameraUniforms(instancedNode, m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getPointExpansionNode() const
+{
+	osg::ref_ptr<osg::Node> instancedNode;
+
+	// the points read the float instance data through a texture buffer, so it is split like the float texture buffer technique
+	unsigned int texelsPerInstance = 4u + InstanceAttributes::NUM_VECTORS;
+	unsigned int maxInstances = m_maxTextureBufferSize / texelsPerInstance;
+
+	if (m_matrices.size() <= maxInstances)
+	{
+		instancedNode = addChunkStatistics(createPointExpansionGeode(0, m_matrices.size()), m_matrices.size());
+	} else {
+		osg::ref_ptr<osg::Group> group = new osg::Group;
+
+		unsigned int numGeodes = (m_matrices.size() + maxInstances - 1) / maxInstances;
+		for (unsigned int i = 0; i < numGeodes; ++i)
+		{
+			unsigned int start = i*maxInstances;
+			unsigned int end    = std::min((unsigned int)m_matrices.size(), (start + maxInstances));
+			group->addChild(addChunkStatistics(createPointExpansionGeode(start, end), end - start));
+		}
+		instancedNode = group;
+	}
+
+	// the geometry shader emits two crossed quads as large as the mesh they replace
+	osg::BoundingBox localBound = InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(m_geometry->getVertexArray()));
+	float halfWidth = std::max(std::max(-localBound.xMin(), localBound.xMax()), std::max(-localBound.yMin(), localBound.yMax()));
+	instancedNode->getOrCreateStateSet()->addUniform(new osg::Uniform("quadSize", osg::Vec2(halfWidth, localBound.zMax())));
+
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define TEXELS_PER_INSTANCE " << texelsPerInstance;
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/point_expansion.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> gsShader = readShaderFile(osg::Shader::GEOMETRY, "../shader/point_expansion.geom", "");
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/point_expansion.frag");
+	program->addShader(vsShader);
+	program->addShader(gsShader);
+	program->addShader(fsShader);
+
+	instancedNode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
+
+	return addCameraUniforms(instancedNode, m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getProceduralInstancedNode(const ProceduralInstanceGenerator& generator) const
+{
+	// the instances don't come from the builder at all, the shader generates them from the instance id
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry(*m_geometry, osg::CopyOp::DEEP_COPY_ALL);
+	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+	{
+		geometry->getPrimitiveSet(i)->setNumInstances(generator.getNumInstances());
+	}
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+	geometry->setInitialBound(generator.computeBound(InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(m_geometry->getVertexArray()))));
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(geometry);
+	generator.applyToStateSet(geode->getOrCreateStateSet(), 1);
+
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define NUM_YAW_STEPS " << ProceduralInstanceGenerator::NUM_YAW_STEPS;
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/procedural_instancing.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/procedural_instancing.frag");
+	program->addShader(vsShader);
+	program->addShader(fsShader);
+	geode->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
+
+	return addCameraUniforms(addChunkStatistics(geode, generator.getNumInstances()), generator.getNumInstances());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::getStaticBatchedNode() const
+{
+	const osg::DrawElements* primitive = m_geometry->getPrimitiveSet(0)->getDrawElements();
+	unsigned int numVertices = m_geometry->getVertexArray()->getNumElements();
+
+	// every instance is a full copy of the mesh, so check the memory before building anything
+	size_t bytesPerInstance = numVertices * (sizeof(osg::Vec3) * 4 + sizeof(osg::Vec2) + sizeof(osg::Vec4ub)) + primitive->getNumIndices() * sizeof(GLuint);
+	if (primitive->getMode() != GL_TRIANGLES)
+	{
+		osg::notify(osg::WARN) << "Static batching needs a triangle list, falling back to software instancing" << std::endl;
+		return getSoftwareInstancedNode();
+	}
+	if (bytesPerInstance * m_matrices.size() > m_maxStaticBatchMemory)
+	{
+		osg::notify(osg::WARN) << "Static batching of " << m_matrices.size() << " instances exceeds the memory limit of "
+							   << m_maxStaticBatchMemory / (1024 * 1024) << " MB, falling back to software instancing" << std::endl;
+		return getSoftwareInstancedNode();
+	}
+
+	// sort the instances into a grid of cells over their positions
+	osg::Vec2 minPosition(FLT_MAX, FLT_MAX);
+	osg::Vec2 maxPosition(-FLT_MAX, -FLT_MAX);
+	for (unsigned int i = 0; i < m_matrices.size(); ++i)
+	{
+		osg::Vec3 position = m_matrices[i].getTrans();
+		minPosition.x() = std::min(minPosition.x(), position.x());
+		minPosition.y() = std::min(minPosition.y(), position.y());
+		maxPosition.x() = std::max(maxPosition.x(), position.x());
+		maxPosition.y() = std::max(maxPosition.y(), position.y());
+	}
+	osg::Vec2 cellSize = (maxPosition - minPosition) / (float)m_staticBatchCells;
+	unsigned int numCells = m_staticBatchCells * m_staticBatchCells;
+
+	std::vector<unsigned int> instanceCells(m_matrices.size());
+	std::vector<unsigned int> cellStart(numCells + 1, 0u);
+	for (unsigned int i = 0; i < m_matrices.size(); ++i)
+	{
+		osg::Vec3 position = m_matrices[i].getTrans();
+		unsigned int cellX = cellSize.x() > 0.0f ? std::min((unsigned int)((position.x() - minPosition.x()) / cellSize.x()), m_staticBatchCells - 1) : 0u;
+		unsigned int cellY = cellSize.y() > 0.0f ? std::min((unsigned int)((position.y() - minPosition.y()) / cellSize.y()), m_staticBatchCells - 1) : 0u;
+		instanceCells[i] = cellY * m_staticBatchCells + cellX;
+		++cellStart[instanceCells[i] + 1];
+	}
+	for (unsigned int i = 0; i < numCells; ++i)
+	{
+		cellStart[i + 1] += cellStart[i];
+	}
+
+	std::vector<unsigned int> sortedInstances(m_matrices.size());
+	std::vector<unsigned int> cellEnd(cellStart.begin(), cellStart.end() - 1);
+	for (unsigned int i = 0; i < m_matrices.size(); ++i)
+	{
+		sortedInstances[cellEnd[instanceCells[i]]++] = i;
+	}
+
+	// the cells are independent, so merge them in parallel
+	std::vector<osg::ref_ptr<osg::Geometry> > cellGeometries(numCells);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)numCells; ++i)
+	{
+		unsigned int numInstances = cellStart[i + 1] - cellStart[i];
+		if (numInstances > 0)
+			cellGeometries[i] = createStaticBatchGeometry(&sortedInstances[cellStart[i]], numInstances);
+	}
+
+	// every non empty cell is one draw call, a geode of its own so that its instances are culled together
+	osg::ref_ptr<osg::Group> group = new osg::Group;
+	for (unsigned int i = 0; i < numCells; ++i)
+	{
+		if (cellGeometries[i].valid())
+		{
+			osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+			geode->addDrawable(cellGeometries[i]);
+			group->addChild(addChunkStatistics(geode, cellStart[i + 1] - cellStart[i]));
+		}
+	}
+
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/static_batching.vert", "");
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/static_batching.frag");
+	program->addShader(vsShader);
+	program->addShader(fsShader);
+	// these locations don't alias the fixed function arrays on any driver
+	program->addBindAttribLocation("vSway", 1);
+	program->addBindAttribLocation("vInstanceTint", 6);
+	program->addBindAttribLocation("vInstanceParams", 7);
+	group->getOrCreateStateSet()->setAttributeAndModes(program, osg::StateAttribute::ON);
+
+	return addCameraUniforms(group, m_matrices.size());
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::addCameraUniforms(osg::ref_ptr<osg::Node> instancedNode, unsigned int numInstances) const
+{
+	// the matrices only depend on the camera, so all chunks share one callback above them
+	osg::ref_ptr<osg::Group> group = new osg::Group;
+	group->addChild(instancedNode);
+	group->setCullCallback(new MatrixUniformUpdateCallback);
+
+	return addTechniqueStatistics(group, numInstances);
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::addTechniqueStatistics(osg::ref_ptr<osg::Node> node, unsigned int numInstances) const
+{
+	if (m_statistics.valid())
+	{
+		osg::ref_ptr<InstanceStatisticsCallback> callback = new InstanceStatisticsCallback(m_statistics);
+		callback->addCounter(InstanceStatistics::SUBMITTED_INSTANCES, numInstances);
+		node->addCullCallback(callback);
+	}
+
+	return node;
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::addChunkStatistics(osg::ref_ptr<osg::Node> chunk, unsigned int numInstances, unsigned int numDrawCalls) const
+{
+	// a chunk that is culled never calls its callback
+	if (m_statistics.valid())
+	{
+		osg::ref_ptr<InstanceStatisticsCallback> callback = new InstanceStatisticsCallback(m_statistics);
+		callback->addCounter(InstanceStatistics::VISIBLE_INSTANCES, numInstances);
+		callback->addCounter(InstanceStatistics::VISIBLE_CHUNKS, 1.0);
+		callback->addCounter(InstanceStatistics::DRAW_CALLS, numDrawCalls);
+		chunk->addCullCallback(callback);
+	}
+
+	osg::Geode* geode = chunk->asGeode();
+	if (m_gpuTimer.valid() && geode)
+	{
+		for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
+			geode->getDrawable(i)->setDrawCallback(new GpuTimerDrawCallback(m_gpuTimer));
+	}
+
+	return chunk;
 }
 
 osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createHardwareInstancedGeode(unsigned int start, unsigned int end) const
@@ -253,15 +705,23 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createHardwareInstancedGeode(u
 			instanceMatrixUniform->setElement(j, m_matrices[i]);
 		}
 		geode->getOrCreateStateSet()->addUniform(instanceMatrixUniform);
+
+		// create uniform array for the instance attributes
+		osg::ref_ptr<osg::Uniform> instanceAttributeUniform = new osg::Uniform(osg::Uniform::FLOAT_VEC4, "instanceAttributes", (end-start) * InstanceAttributes::NUM_VECTORS);
+		for (unsigned int i = start, j = 0; i < end; ++i, ++j)
+		{
+			float attributes[InstanceAttributes::NUM_VECTORS * 4];
+			m_attributes[i].pack(attributes);
+			for (unsigned int k = 0; k < InstanceAttributes::NUM_VECTORS; ++k)
+			{
+				instanceAttributeUniform->setElement(j * InstanceAttributes::NUM_VECTORS + k, osg::Vec4(attributes[k*4], attributes[k*4+1], attributes[k*4+2], attributes[k*4+3]));
+			}
+		}
+		geode->getOrCreateStateSet()->addUniform(instanceAttributeUniform);
 			
 		// add bounding box callback so osg computes the right bounding box for our geode
 		geometry->setComputeBoundingBoxCallback(new ComputeInstancedBoundingBoxCallback(instanceMatrixUniform));
 
-		// add matrix uniforms and update callback
-		osg::ref_ptr<osgExample::MatrixUniformUpdateCallback> updateCallback = new osgExample::MatrixUniformUpdateCallback;
-		geode->getOrCreateStateSet()->addUniform(updateCallback->getModelViewProjectionMatrixUniform());
-		geode->getOrCreateStateSet()->addUniform(updateCallback->getNormalMatrixUniform());
-		geode->setCullCallback(updateCallback);
 
 		return geode;
 }
@@ -275,25 +735,21 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createTextureHardwareInstanced
 	// first turn on hardware instancing for every primitive set
 	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
 	{
-		geometry->getPrimitiveSet(i)->setNumInstances(m_matrices.size());
+		geometry->getPrimitiveSet(i)->setNumInstances(end-start);
 	}
 
 	// we need to turn off display lists for instancing to work
 	geometry->setUseDisplayList(false);
 	geometry->setUseVertexBufferObjects(true);
 	
-	// create texture to encode all matrices
-	unsigned int height = ((end-start) / 4096u) + 1u;
+	// the texture encodes all matrices, every matrix is followed by its instance attributes. This is exactly
+	// the layout of the instance data, which is padded to full rows, so the image just points into it.
+	const unsigned int texelsPerInstance = 4u + InstanceAttributes::NUM_VECTORS;
+	unsigned int height = std::max((end - start + INSTANCES_PER_ROW - 1) / INSTANCES_PER_ROW, 1u);
 	osg::ref_ptr<osg::Image> image = new osg::Image;
-	image->allocateImage(16384, height, 1, GL_RGBA, GL_FLOAT);
-	image->setInternalTextureFormat(GL_RGBA32F_ARB);
-
-	for (unsigned int i = start, j = 0; i < end; ++i, ++j)
-	{
-		osg::Matrixf matrix = m_matrices[i];
-		float * data = (float*)image->data((j % 4096u) *4u, j / 4096u);
-		memcpy(data, matrix.ptr(), 16 * sizeof(float));
-	}
+	image->setImage(INSTANCES_PER_ROW * texelsPerInstance, height, 1, GL_RGBA32F_ARB, GL_RGBA, GL_FLOAT,
+					(unsigned char*)&(*m_instanceData)[start * InstancedDrawable::FLOATS_PER_INSTANCE], osg::Image::NO_DELETE);
+	image->setUserData(m_instanceData.get());
 
 	osg::ref_ptr<osg::TextureRectangle> texture = new osg::TextureRectangle(image);
 	texture->setInternalFormat(GL_RGBA32F_ARB);
@@ -308,16 +764,9 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createTextureHardwareInstanced
 	geode->getOrCreateStateSet()->setTextureAttributeAndModes(1, texture, osg::StateAttribute::ON);
 	geode->getOrCreateStateSet()->addUniform(new osg::Uniform("instanceMatrixTexture", 1));
 
-	// copy part of matrix list and create bounding box callback
-	std::vector<osg::Matrixd> matrices;
-	matrices.insert(matrices.begin(), m_matrices.begin()+start, m_matrices.begin()+end);
-	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(matrices));
+	// the bounding box callback reads the chunk's range of the instance data
+	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(m_instanceData, start, end));
 	
-	// add matrix uniforms and update callback
-	osg::ref_ptr<osgExample::MatrixUniformUpdateCallback> updateCallback = new osgExample::MatrixUniformUpdateCallback;
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getModelViewProjectionMatrixUniform());
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getNormalMatrixUniform());
-	geode->setCullCallback(updateCallback);
 
 	return geode;
 }
@@ -331,69 +780,364 @@ osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createUBOHardwareInstancedGeod
 	// first turn on hardware instancing for every primitive set
 	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
 	{
-		geometry->getPrimitiveSet(i)->setNumInstances(m_matrices.size());
+		geometry->getPrimitiveSet(i)->setNumInstances(end-start);
 	}
 
 	// we need to turn off display lists for instancing to work
 	geometry->setUseDisplayList(false);
 	geometry->setUseVertexBufferObjects(true);
 	
-	// create uniform buffer object for all matrices
-	osg::FloatArray* matrixArray = new osg::FloatArray(maxUBOMatrices*16);
-	m_floatArrays.push_back(matrixArray);
-	for (unsigned int i = start, j = 0; i < end; ++i, ++j)
+	// the last chunk is usually smaller, so it gets its own program with a matching block size
+	unsigned int numUBOMatrices = end-start;
+	if (numUBOMatrices > 0 && numUBOMatrices < maxUBOMatrices)
+		geode->getOrCreateStateSet()->setAttributeAndModes(createUBOProgram(numUBOMatrices), osg::StateAttribute::ON);
+
+	// the std140 block has the layout of the instance data, so the chunk binds its range of the shared buffer
+	const unsigned int bytesPerInstance = InstancedDrawable::FLOATS_PER_INSTANCE * sizeof(GLfloat);
+	getInstanceBufferObject();
+	osg::ref_ptr<osg::UniformBufferBinding> ubb = new osg::UniformBufferBinding(0, m_instanceData.get(), start*bytesPerInstance, numUBOMatrices*bytesPerInstance);
+	geode->getOrCreateStateSet()->setAttributeAndModes(ubb, osg::StateAttribute::ON);
+
+	// the bounding box callback reads the chunk's range of the instance data
+	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(m_instanceData, start, end));
+
+
+	return geode;
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createTextureBufferHardwareInstancedGeode(unsigned int start, unsigned int end, TextureBufferFormat format) const
+{
+	osg::ref_ptr<osg::Geode>	geode = new osg::Geode;
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry(*m_geometry, osg::CopyOp::DEEP_COPY_ALL);
+	geode->addDrawable(geometry);
+
+	// first turn on hardware instancing for every primitive set
+	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+	{
+		geometry->getPrimitiveSet(i)->setNumInstances(end-start);
+	}
+
+	// we need to turn off display lists for instancing to work
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+
+	// quantization needs scale, yaw and translation only, everything else gets the affine format
+	InstanceQuantizer quantizer;
+	if (format == TEXTURE_BUFFER_QUANTIZED && !quantizer.computeRange(m_matrices, start, end))
+	{
+		format = TEXTURE_BUFFER_PACKED;
+		geode->getOrCreateStateSet()->setAttributeAndModes(createTextureBufferProgram(format), osg::StateAttribute::ON);
+	}
+
+	// create a one dimensional image which is exactly as large as the instance data
+	osg::ref_ptr<osg::Image> image = new osg::Image;
+	if (format == TEXTURE_BUFFER_QUANTIZED)
+	{
+		image->allocateImage(end-start, 1, 1, GL_RGBA_INTEGER_EXT, GL_UNSIGNED_INT);
+		image->setInternalTextureFormat(GL_RGBA32UI_EXT);
+
+		for (unsigned int i = start, j = 0; i < end; ++i, ++j)
+		{
+			unsigned int* data = (unsigned int*)image->data(j);
+			quantizer.quantize(m_matrices[i], m_attributes[i], data);
+		}
+
+		// the shader needs the chunk range to decode the instances
+		geode->getOrCreateStateSet()->addUniform(new osg::Uniform("chunkOrigin", quantizer.getOrigin()));
+		geode->getOrCreateStateSet()->addUniform(new osg::Uniform("chunkExtent", quantizer.getExtent()));
+		geode->getOrCreateStateSet()->addUniform(new osg::Uniform("scaleRange", quantizer.getScaleRange()));
+	}
+	else if (format == TEXTURE_BUFFER_PACKED)
 	{
-		for (unsigned int k = 0; k < 16; ++k)
+		image->allocateImage((end-start) * 4u, 1, 1, GL_RGBA_INTEGER_EXT, GL_UNSIGNED_INT);
+		image->setInternalTextureFormat(GL_RGBA32UI_EXT);
+
+		for (unsigned int i = start, j = 0; i < end; ++i, ++j)
 		{
-			(*matrixArray)[j*16+k] =  m_matrices[i].ptr()[k];
+			unsigned int* data = (unsigned int*)image->data(j * 4u);
+
+			// store the first three rows of the transposed matrix, the last one is always (0, 0, 0, 1)
+			osg::Matrixf matrix = m_matrices[i];
+			for (unsigned int row = 0; row < 3; ++row)
+			{
+				float affineRow[4] = { matrix(0, row), matrix(1, row), matrix(2, row), matrix(3, row) };
+				memcpy(data + row * 4, affineRow, 4 * sizeof(float));
+			}
+			m_attributes[i].packCompact(data + 12);
 		}
+	} else {
+		image = createInstanceDataImage(start, end);
 	}
-	osg::ref_ptr<osg::UniformBufferObject> ubo = new osg::UniformBufferObject;
-	ubo->setUsage(GL_STATIC_DRAW_ARB);
-	ubo->setDataVariance(osg::Object::STATIC);
-	matrixArray->setBufferObject(ubo);
 
-	// create uniform buffer binding and add it to the stateset
-	osg::ref_ptr<osg::UniformBufferBinding> ubb = new osg::UniformBufferBinding(0, ubo, 0, maxUBOMatrices*16*sizeof(GLfloat));
-	geode->getOrCreateStateSet()->setAttributeAndModes(ubb, osg::StateAttribute::ON);
+	osg::ref_ptr<osg::TextureBuffer> texture = new osg::TextureBuffer(image);
+	texture->setInternalFormat(image->getInternalTextureFormat());
+
+	geode->getOrCreateStateSet()->setTextureAttribute(1, texture, osg::StateAttribute::ON);
+	geode->getOrCreateStateSet()->addUniform(new osg::Uniform("instanceBuffer", 1));
 
-	// copy part of matrix list and create bounding box callback
-	std::vector<osg::Matrixd> matrices;
-	matrices.insert(matrices.begin(), m_matrices.begin()+start, m_matrices.begin()+end);
-	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(matrices));
+	// the bounding box callback reads the chunk's range of the instance data, the decoded instances of
+	// quantized chunks are off by at most the quantization error
+	osg::ref_ptr<ComputeTextureBoundingBoxCallback> callback = new ComputeTextureBoundingBoxCallback(m_instanceData, start, end);
+	if (format == TEXTURE_BUFFER_QUANTIZED)
+	{
+		osg::BoundingBox localBound = InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(m_geometry->getVertexArray()));
+		callback->setPadding(quantizer.computeMaxError(localBound, InstanceBounds::WIND_SWAY));
+	}
+	geometry->setComputeBoundingBoxCallback(callback);
 
-	// add matrix uniforms and update callback
-	osg::ref_ptr<osgExample::MatrixUniformUpdateCallback> updateCallback = new osgExample::MatrixUniformUpdateCallback;
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getModelViewProjectionMatrixUniform());
-	geode->getOrCreateStateSet()->addUniform(updateCallback->getNormalMatrixUniform());
-	geode->setCullCallback(updateCallback);
 
 	return geode;
 }
 
-osg::ref_ptr<osg::Shader> InstancedGeometryBuilder::readShaderFile(const std::string& fileName, const std::string& preprocessorDefinitions) const
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createVertexPullingGeode(unsigned int start, unsigned int end) const
 {
-	// open vertex shader file
-	std::ifstream vsShaderFile;
-    vsShaderFile.open(fileName.c_str(), std::ios_base::in);
+	// no arrays at all, the vertex id walks over the indices of the mesh
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+	osg::ref_ptr<osg::DrawArrays> primitive = new osg::DrawArrays(m_meshRange.mode, 0, m_meshRange.numIndices);
+	primitive->setNumInstances(end-start);
+	geometry->addPrimitiveSet(primitive);
 
-	if(!vsShaderFile.is_open()) {
-		std::cout << "Error: Could not open shader file " << fileName << std::endl;
-		return NULL;
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(geometry);
+
+	osg::ref_ptr<osg::TextureBuffer> texture = new osg::TextureBuffer(createInstanceDataImage(start, end));
+	texture->setInternalFormat(GL_RGBA32F_ARB);
+	geode->getOrCreateStateSet()->setTextureAttribute(1, texture, osg::StateAttribute::ON);
+	geode->getOrCreateStateSet()->addUniform(new osg::Uniform("instanceBuffer", 1));
+
+	// the geometry has no vertices, so the bounding box uses the ones of the mesh
+	osg::BoundingBox localBound = InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(m_geometry->getVertexArray()));
+	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(m_instanceData, start, end, localBound));
+
+	return geode;
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createPointExpansionGeode(unsigned int start, unsigned int end) const
+{
+	// one point per instance without any vertex data, the shader fetches the instance by its vertex id
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+	geometry->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, end-start));
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(geometry);
+
+	osg::ref_ptr<osg::TextureBuffer> texture = new osg::TextureBuffer(createInstanceDataImage(start, end));
+	texture->setInternalFormat(GL_RGBA32F_ARB);
+	geode->getOrCreateStateSet()->setTextureAttribute(1, texture, osg::StateAttribute::ON);
+	geode->getOrCreateStateSet()->addUniform(new osg::Uniform("instanceBuffer", 1));
+
+	// the points have no extent, so the bounding box uses the one of the mesh they replace
+	osg::BoundingBox localBound = InstanceBounds::computeLocalBound(dynamic_cast<const osg::Vec3Array*>(m_geometry->getVertexArray()));
+	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(m_instanceData, start, end, localBound));
+
+	return geode;
+}
+
+osg::ref_ptr<osg::Image> InstancedGeometryBuilder::createInstanceDataImage(unsigned int start, unsigned int end) const
+{
+	// the float format is the layout of the instance data, so the image just points into it
+	const unsigned int texelsPerInstance = 4u + InstanceAttributes::NUM_VECTORS;
+	osg::ref_ptr<osg::Image> image = new osg::Image;
+	image->setImage((end-start) * texelsPerInstance, 1, 1, GL_RGBA32F_ARB, GL_RGBA, GL_FLOAT,
+					(unsigned char*)&(*m_instanceData)[start * InstancedDrawable::FLOATS_PER_INSTANCE], osg::Image::NO_DELETE);
+	image->setUserData(m_instanceData.get());
+
+	return image;
+}
+
+osg::ref_ptr<osg::Node> InstancedGeometryBuilder::createShaderStorageBufferHardwareInstancedGeode(unsigned int start, unsigned int end) const
+{
+	osg::ref_ptr<osg::Geode>	geode = new osg::Geode;
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry(*m_geometry, osg::CopyOp::DEEP_COPY_ALL);
+	geode->addDrawable(geometry);
+
+	// first turn on hardware instancing for every primitive set
+	for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); ++i)
+	{
+		geometry->getPrimitiveSet(i)->setNumInstances(end-start);
+	}
+
+	// we need to turn off display lists for instancing to work
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+
+	// the storage block has the same layout as the uniform block, so it binds a range of the same buffer
+	const unsigned int bytesPerInstance = InstancedDrawable::FLOATS_PER_INSTANCE * sizeof(GLfloat);
+	getInstanceBufferObject();
+	osg::ref_ptr<osg::ShaderStorageBufferBinding> ssbb = new osg::ShaderStorageBufferBinding(0, m_instanceData.get(), start*bytesPerInstance, (end-start)*bytesPerInstance);
+	geode->getOrCreateStateSet()->setAttributeAndModes(ssbb, osg::StateAttribute::ON);
+
+	// the bounding box callback reads the chunk's range of the instance data
+	geometry->setComputeBoundingBoxCallback(new ComputeTextureBoundingBoxCallback(m_instanceData, start, end));
+
+
+	return geode;
+}
+
+osg::ref_ptr<osg::Geometry> InstancedGeometryBuilder::createStaticBatchGeometry(const unsigned int* instances, unsigned int numInstances) const
+{
+	const osg::Vec3Array* sourceVertices = static_cast<const osg::Vec3Array*>(m_geometry->getVertexArray());
+	const osg::Vec3Array* sourceNormals = static_cast<const osg::Vec3Array*>(m_geometry->getNormalArray());
+	const osg::Vec2Array* sourceTexCoords = static_cast<const osg::Vec2Array*>(m_geometry->getTexCoordArray(0));
+	const osg::DrawElements* sourcePrimitive = m_geometry->getPrimitiveSet(0)->getDrawElements();
+	unsigned int numVertices = sourceVertices->size();
+	unsigned int numIndices = sourcePrimitive->getNumIndices();
+
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array(numVertices * numInstances);
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(numVertices * numInstances);
+	osg::ref_ptr<osg::Vec2Array> texCoords = new osg::Vec2Array(numVertices * numInstances);
+	osg::ref_ptr<osg::Vec3Array> sway = new osg::Vec3Array(numVertices * numInstances);
+	osg::ref_ptr<osg::Vec4ubArray> tints = new osg::Vec4ubArray(numVertices * numInstances);
+	osg::ref_ptr<osg::Vec3Array> params = new osg::Vec3Array(numVertices * numInstances);
+	osg::ref_ptr<osg::DrawElementsUInt> primitive = new osg::DrawElementsUInt(GL_TRIANGLES, numIndices * numInstances);
+	// the vertices move by up to their sway offset in both directions
+	osg::BoundingBox swayBound;
+
+	for (unsigned int i = 0; i < numInstances; ++i)
+	{
+		const osg::Matrixd& matrix = m_matrices[instances[i]];
+		const InstanceAttributes& attributes = m_attributes[instances[i]];
+
+		// the shaders of the other techniques sway the local x axis by the local height
+		osg::Vec3 swayAxis = osg::Matrixd::transform3x3(osg::Vec3d(InstanceBounds::WIND_SWAY, 0.0, 0.0), matrix);
+		osg::Vec4ub tint;
+		for (unsigned int j = 0; j < 4; ++j)
+		{
+			tint[j] = (unsigned char)(std::min(std::max(attributes.tint[j], 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+		osg::Vec3 param((float)attributes.textureLayer, attributes.windPhase, attributes.fade);
+
+		unsigned int baseVertex = i * numVertices;
+		for (unsigned int j = 0; j < numVertices; ++j)
+		{
+			const osg::Vec3& vertex = (*sourceVertices)[j];
+			(*vertices)[baseVertex + j] = vertex * matrix;
+			(*normals)[baseVertex + j] = osg::Matrixd::transform3x3((*sourceNormals)[j], matrix);
+			(*texCoords)[baseVertex + j] = (*sourceTexCoords)[j];
+			(*sway)[baseVertex + j] = swayAxis * vertex.z();
+			swayBound.expandBy((*vertices)[baseVertex + j] + (*sway)[baseVertex + j]);
+			swayBound.expandBy((*vertices)[baseVertex + j] - (*sway)[baseVertex + j]);
+			(*tints)[baseVertex + j] = tint;
+			(*params)[baseVertex + j] = param;
+		}
+
+		unsigned int baseIndex = i * numIndices;
+		for (unsigned int j = 0; j < numIndices; ++j)
+		{
+			(*primitive)[baseIndex + j] = baseVertex + sourcePrimitive->index(j);
+		}
+	}
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+	geometry->setVertexArray(vertices);
+	geometry->setNormalArray(normals);
+	geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+	geometry->setTexCoordArray(0, texCoords);
+	geometry->setVertexAttribArray(1, sway);
+	geometry->setVertexAttribBinding(1, osg::Geometry::BIND_PER_VERTEX);
+	geometry->setVertexAttribArray(6, tints);
+	geometry->setVertexAttribBinding(6, osg::Geometry::BIND_PER_VERTEX);
+	geometry->setVertexAttribNormalize(6, GL_TRUE);
+	geometry->setVertexAttribArray(7, params);
+	geometry->setVertexAttribBinding(7, osg::Geometry::BIND_PER_VERTEX);
+	geometry->addPrimitiveSet(primitive);
+	geometry->setInitialBound(swayBound);
+
+	return geometry;
+}
+
+osg::ref_ptr<osg::Program> InstancedGeometryBuilder::createUBOProgram(unsigned int maxUBOMatrices) const
+{
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define MAX_INSTANCES " << maxUBOMatrices;
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/ubo_instancing.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/ubo_instancing.frag");
+	program->addShader(vsShader);
+	program->addShader(fsShader);
+	program->addBindUniformBlock("instanceData", 0);
+
+	return program;
+}
+
+osg::ref_ptr<osg::Program> InstancedGeometryBuilder::createTextureBufferProgram(TextureBufferFormat format) const
+{
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	std::stringstream preprocessorDefinition;
+	switch (format)
+	{
+	case TEXTURE_BUFFER_QUANTIZED:
+		preprocessorDefinition << "#define TEXELS_PER_INSTANCE 1" << std::endl << "#define QUANTIZED_INSTANCES";
+		break;
+	case TEXTURE_BUFFER_PACKED:
+		preprocessorDefinition << "#define TEXELS_PER_INSTANCE 4" << std::endl << "#define PACKED_INSTANCES";
+		break;
+	case TEXTURE_BUFFER_FLOAT:
+	default:
+		preprocessorDefinition << "#define TEXELS_PER_INSTANCE " << (4u + InstanceAttributes::NUM_VECTORS);
+		break;
+	}
+	osg::ref_ptr<osg::Shader> vsShader = readShaderFile(osg::Shader::VERTEX, "../shader/texture_buffer_instancing.vert", preprocessorDefinition.str());
+	osg::ref_ptr<osg::Shader> fsShader = osgDB::readShaderFile("../shader/texture_buffer_instancing.frag");
+	program->addShader(vsShader);
+	program->addShader(fsShader);
+
+	return program;
+}
+
+std::string InstancedGeometryBuilder::readShaderSource(const std::string& fileName, const std::string& preprocessorDefinitions)
+{
+	std::ifstream shaderFile(fileName.c_str(), std::ios_base::in);
+	std::ifstream commonFile("../shader/instancing_common.glsl", std::ios_base::in);
+	if (!shaderFile.is_open() || !commonFile.is_open())
+	{
+		std::cout << "Error: Could not open shader file " << (shaderFile.is_open() ? "../shader/instancing_common.glsl" : fileName) << std::endl;
+		return std::string();
 	}
 
-	std::stringstream vsShaderStr;
+	// extensions have to come before any declaration, the definitions may go anywhere after the version line
+	std::stringstream shaderStr;
 	std::string line;
-	std::getline(vsShaderFile, line);
-	vsShaderStr << line << std::endl;
-	vsShaderStr << preprocessorDefinitions << std::endl;
-	while (!vsShaderFile.eof()) {
-		std::getline(vsShaderFile, line);
-		vsShaderStr << line << std::endl;
+	std::getline(shaderFile, line);
+	shaderStr << line << std::endl;
+	bool remainingLine = false;
+	while (std::getline(shaderFile, line))
+	{
+		if (line.compare(0, 10, "#extension") != 0)
+		{
+			remainingLine = true;
+			break;
+		}
+		shaderStr << line << std::endl;
+	}
+	shaderStr << preprocessorDefinitions << std::endl;
+	// nine digits give back the same float
+	shaderStr.precision(9);
+	shaderStr << "#define WIND_SWAY " << InstanceBounds::WIND_SWAY << std::endl;
+	shaderStr << commonFile.rdbuf() << std::endl;
+
+	if (remainingLine)
+		shaderStr << line << std::endl;
+	while (std::getline(shaderFile, line))
+	{
+		shaderStr << line << std::endl;
 	}
-	vsShaderFile.close();
 
-	return new osg::Shader(osg::Shader::VERTEX, vsShaderStr.str());
+	return shaderStr.str();
+}
+
+osg::ref_ptr<osg::Shader> InstancedGeometryBuilder::readShaderFile(osg::Shader::Type type, const std::string& fileName, const std::string& preprocessorDefinitions) const
+{
+	std::string source = readShaderSource(fileName, preprocessorDefinitions);
+	if (source.empty())
+		return NULL;
+
+	return new osg::Shader(type, source);
 }
 
 }
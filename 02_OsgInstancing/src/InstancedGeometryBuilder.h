@@ -26,6 +26,8 @@
 
 // std
 #include <vector>
+#include <string>
+#include <algorithm>
 
 // osg
 #include <osg/Referenced>
@@ -33,52 +35,193 @@
 #include <osg/Matrix>
 #include <osg/Geometry>
 #include <osg/Node>
+#include <osg/Array>
+#include <osg/BufferObject>
+#include <osg/Image>
+#include <osg/Shader>
+
+// osgExample
+#include "InstanceAttributes.h"
+#include "MeshOptimizer.h"
+#include "ProceduralInstanceGenerator.h"
+#include "MeshPool.h"
+#include "InstanceStatistics.h"
+#include "MemoryUsage.h"
+#include "GpuTimer.h"
 
 namespace osgExample
 {
 
+class InstancedDrawable;
+class InstancePlacement;
+
 class InstancedGeometryBuilder : public osg::Referenced
 {
 public:
+	// layout of the instance data in a texture buffer
+	enum TextureBufferFormat
+	{
+		TEXTURE_BUFFER_FLOAT,	// full matrix and attributes as RGBA32F, 6 texels per instance
+		TEXTURE_BUFFER_PACKED,	// affine 3x4 matrix and compacted attributes as RGBA32UI, 4 texels per instance
+		TEXTURE_BUFFER_QUANTIZED	// quantized position, yaw, scale and attributes as RGBA32UI, 1 texel per instance,
+									// chunks with other transforms fall back to TEXTURE_BUFFER_PACKED
+	};
+
 	InstancedGeometryBuilder()
 		:	m_maxMatrixUniforms(16),
-			m_maxTextureResolution(16384u * 4096u),
-			m_maxUniformBlockSize(16384)
+			m_maxTextureResolution(INSTANCES_PER_ROW * 4096u),
+			m_maxUniformBlockSize(16384),
+			m_maxTextureBufferSize(65536),
+			m_maxShaderStorageBlockSize(0),
+			m_dynamicInstances(false),
+			m_windGust(false),
+			m_staticBatchCells(16u),
+			m_maxStaticBatchMemory(1024u * 1024u * 1024u),
+			m_meshPool(new MeshPool)
 	{
+		clearMatrices();
 	}
 	
 	InstancedGeometryBuilder(GLint maxMatrixUniforms, GLint maxUniformBlockSize)
 		:	m_maxMatrixUniforms(maxMatrixUniforms),
-			m_maxTextureResolution(16384u * 4096u),
-			m_maxUniformBlockSize(maxUniformBlockSize)
+			m_maxTextureResolution(INSTANCES_PER_ROW * 4096u),
+			m_maxUniformBlockSize(maxUniformBlockSize),
+			m_maxTextureBufferSize(65536),
+			m_maxShaderStorageBlockSize(0),
+			m_dynamicInstances(false),
+			m_windGust(false),
+			m_staticBatchCells(16u),
+			m_maxStaticBatchMemory(1024u * 1024u * 1024u),
+			m_meshPool(new MeshPool)
 	{
+		clearMatrices();
 	}
 	
-	inline void setGeometry(osg::ref_ptr<osg::Geometry> geometry) { m_geometry = geometry; }
+	// the geometry is optimized for the vertex cache in place, every vertex is processed once per instance,
+	// it also replaces the previous geometry in the mesh pool, which copies the arrays the last scene still draws,
+	// so the rebuild thread may call it while that scene is on screen
+	void setGeometry(osg::ref_ptr<osg::Geometry> geometry);
 	inline osg::ref_ptr<osg::Geometry> getGeometry() const { return m_geometry; }
 
-	inline void addMatrix(const osg::Matrixd& matrix) { m_matrices.push_back(matrix); }
+	void addMatrix(const osg::Matrixd& matrix, const InstanceAttributes& attributes = InstanceAttributes());
 	inline osg::Matrixd getMatrix(size_t index) const { return m_matrices[index]; }
-	inline void clearMatrices() { m_matrices.clear(); }
+	inline const InstanceAttributes& getAttributes(size_t index) const { return m_attributes[index]; }
+	// the nodes of the last scene may still use the old instance data, so it is replaced instead of cleared
+	void clearMatrices();
+	// avoids any reallocation while adding count instances
+	void reserveMatrices(unsigned int count);
+
+	// every instance as a float matrix followed by its packed attributes, the layout of the vertex attribute,
+	// uniform buffer, shader storage buffer and float texture techniques which all use it without a copy
+	inline osg::ref_ptr<osg::FloatArray> getInstanceData() const { return m_instanceData; }
+
+	// animate the instances of the vertex attribute technique through a streaming instance buffer
+	inline void setDynamicInstances(bool dynamicInstances) { m_dynamicInstances = dynamicInstances; }
+	inline bool getDynamicInstances() const { return m_dynamicInstances; }
+	// animate a band of instances in the static instance buffer of the vertex attribute technique instead,
+	// only its range is uploaded every frame
+	inline void setWindGust(bool windGust) { m_windGust = windGust; }
+	inline bool getWindGust() const { return m_windGust; }
+
+	// maximum number of texels in one texture buffer(GL_MAX_TEXTURE_BUFFER_SIZE)
+	inline void setMaxTextureBufferSize(GLint maxTextureBufferSize) { m_maxTextureBufferSize = maxTextureBufferSize; }
+	inline GLint getMaxTextureBufferSize() const { return m_maxTextureBufferSize; }
+
+	// maximum size of a shader storage block(GL_MAX_SHADER_STORAGE_BLOCK_SIZE), 0 if shader storage buffers are not supported
+	inline void setMaxShaderStorageBlockSize(GLint maxShaderStorageBlockSize) { m_maxShaderStorageBlockSize = maxShaderStorageBlockSize; }
+	inline GLint getMaxShaderStorageBlockSize() const { return m_maxShaderStorageBlockSize; }
+
+	// the static batching technique merges the instances of each cell of a cells x cells grid into one geometry,
+	// so it never needs more than cells * cells draw calls
+	inline void setStaticBatchCells(unsigned int cells) { m_staticBatchCells = std::max(cells, 1u); }
+	inline unsigned int getStaticBatchCells() const { return m_staticBatchCells; }
+
+	// maximum number of bytes the merged geometry may occupy, larger scenes fall back to software instancing
+	inline void setMaxStaticBatchMemory(size_t maxStaticBatchMemory) { m_maxStaticBatchMemory = maxStaticBatchMemory; }
+	inline size_t getMaxStaticBatchMemory() const { return m_maxStaticBatchMemory; }
+
+	// nodes built afterwards count their submitted, visible and drawn instances into the statistics
+	inline void setStatistics(osg::ref_ptr<InstanceStatistics> statistics) { m_statistics = statistics; }
+	inline osg::ref_ptr<InstanceStatistics> getStatistics() const { return m_statistics; }
+
+	// nodes built afterwards measure the gpu time of every chunk draw with the timer
+	inline void setGpuTimer(osg::ref_ptr<GpuTimer> gpuTimer) { m_gpuTimer = gpuTimer; }
+	inline osg::ref_ptr<GpuTimer> getGpuTimer() const { return m_gpuTimer; }
+
+	// the instances and the mesh pool, the nodes add their own copies
+	void computeMemoryUsage(MemoryUsage& usage) const;
 
 	osg::ref_ptr<osg::Node> getSoftwareInstancedNode() const;
 	osg::ref_ptr<osg::Node> getHardwareInstancedNode() const;
 	osg::ref_ptr<osg::Node> getTextureHardwareInstancedNode() const;
 	osg::ref_ptr<osg::Node> getUBOHardwareInstancedNode() const;
+	osg::ref_ptr<osg::Node> getTextureBufferHardwareInstancedNode(TextureBufferFormat format) const;
+	osg::ref_ptr<osg::Node> getShaderStorageBufferHardwareInstancedNode() const;
 	osg::ref_ptr<osg::Node> getVertexAttribHardwareInstancedNode() const;
+	osg::ref_ptr<osg::Node> getStaticBatchedNode() const;
+	// no vertex attributes at all, mesh and instances are fetched from buffer textures
+	osg::ref_ptr<osg::Node> getVertexPullingNode() const;
+	// crossed quad vegetation only, every instance is a single point that a geometry shader expands into two quads
+	osg::ref_ptr<osg::Node> getPointExpansionNode() const;
+	// instances of the placement drawn like the vertex attribute technique, gpuPlacement writes them with
+	// transform feedback, otherwise they are generated on the cpu
+	osg::ref_ptr<osg::Node> getPlacedInstancedNode(osg::ref_ptr<InstancePlacement> placement, bool gpuPlacement) const;
+	// stateless instances generated by the vertex shader, only the mesh of the builder is used
+	osg::ref_ptr<osg::Node> getProceduralInstancedNode(const ProceduralInstanceGenerator& generator) const;
+
+	// the source of an instancing shader, the definitions, WIND_SWAY and shader/instancing_common.glsl with the
+	// outputs and the wind sway shared by all techniques go right after the version and extension lines
+	static std::string readShaderSource(const std::string& fileName, const std::string& preprocessorDefinitions);
 
 private:
 	osg::ref_ptr<osg::Node>   createHardwareInstancedGeode(unsigned int start, unsigned int end) const;
 	osg::ref_ptr<osg::Node>   createTextureHardwareInstancedGeode(unsigned int start, unsigned int end) const;
 	osg::ref_ptr<osg::Node>	  createUBOHardwareInstancedGeode(unsigned int start, unsigned int end, unsigned int maxUBOMatrices) const;
-	osg::ref_ptr<osg::Shader> readShaderFile(const std::string& fileName, const std::string& preprocessorDefinitions) const;
+	osg::ref_ptr<osg::Node>   createTextureBufferHardwareInstancedGeode(unsigned int start, unsigned int end, TextureBufferFormat format) const;
+	osg::ref_ptr<osg::Node>   createShaderStorageBufferHardwareInstancedGeode(unsigned int start, unsigned int end) const;
+	osg::ref_ptr<InstancedDrawable> createInstancedDrawable(unsigned int numInstances) const;
+	osg::ref_ptr<osg::Node>   createInstancedDrawableNode(osg::ref_ptr<InstancedDrawable> drawable, unsigned int numInstances, unsigned int numVisibleInstances) const;
+	osg::ref_ptr<osg::Node>   createVertexPullingGeode(unsigned int start, unsigned int end) const;
+	osg::ref_ptr<osg::Node>   createPointExpansionGeode(unsigned int start, unsigned int end) const;
+	// a float image that points into the instance data of the given instances
+	osg::ref_ptr<osg::Image>  createInstanceDataImage(unsigned int start, unsigned int end) const;
+	// pre-transforms the given instances into one merged geometry
+	osg::ref_ptr<osg::Geometry> createStaticBatchGeometry(const unsigned int* instances, unsigned int numInstances) const;
+	osg::ref_ptr<osg::Program> createUBOProgram(unsigned int maxUBOMatrices) const;
+	osg::ref_ptr<osg::Program> createTextureBufferProgram(TextureBufferFormat format) const;
+	osg::ref_ptr<osg::Shader> readShaderFile(osg::Shader::Type type, const std::string& fileName, const std::string& preprocessorDefinitions) const;
+	// wraps the node in a group that provides the per camera matrix uniforms
+	osg::ref_ptr<osg::Node>   addCameraUniforms(osg::ref_ptr<osg::Node> instancedNode, unsigned int numInstances) const;
+	// the root of a technique counts all its instances as submitted
+	osg::ref_ptr<osg::Node>   addTechniqueStatistics(osg::ref_ptr<osg::Node> node, unsigned int numInstances) const;
+	// a chunk counts its instances and draw calls whenever it survives culling, its drawables get the gpu timer
+	osg::ref_ptr<osg::Node>   addChunkStatistics(osg::ref_ptr<osg::Node> chunk, unsigned int numInstances, unsigned int numDrawCalls = 1) const;
+	// one buffer object for the whole instance data, chunks bind ranges of it
+	osg::ref_ptr<osg::BufferObject> getInstanceBufferObject() const;
+
+	// number of instances stored in one row of the instance texture
+	static const unsigned int	INSTANCES_PER_ROW = 2048u;
+	// chunk sizes of the buffer techniques are multiples of this, 8 instances are 768 bytes
+	static const unsigned int	INSTANCE_ALIGNMENT = 8u;
 
 	GLint						m_maxMatrixUniforms;
 	unsigned int				m_maxTextureResolution;
 	GLint						m_maxUniformBlockSize;
+	GLint						m_maxTextureBufferSize;
+	GLint						m_maxShaderStorageBlockSize;
+	bool						m_dynamicInstances;
+	bool						m_windGust;
+	unsigned int				m_staticBatchCells;
+	size_t						m_maxStaticBatchMemory;
 	osg::ref_ptr<osg::Geometry> m_geometry;
 	std::vector<osg::Matrixd>   m_matrices;
-	mutable std::vector<osg::ref_ptr<osg::FloatArray> > m_floatArrays;
+	std::vector<InstanceAttributes> m_attributes;
+	osg::ref_ptr<osg::FloatArray> m_instanceData;
+	// all meshes for vertex pulling, only the current geometry is in it
+	osg::ref_ptr<MeshPool>		m_meshPool;
+	MeshPool::MeshRange			m_meshRange;
+	osg::ref_ptr<InstanceStatistics> m_statistics;
+	osg::ref_ptr<GpuTimer>		m_gpuTimer;
 };
 
 }
@@ -0,0 +1,515 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// c-std
+#include <cstdlib>
+#define _USE_MATH_DEFINES 1 // fix for visual studio
+#include <cmath>
+#include <algorithm>
+
+// glew
+#include <GL/glew.h>
+
+// osg
+#include <osg/Geode>
+#include <osg/AlphaFunc>
+#include <osg/Texture2DArray>
+#include <osg/Light>
+#include <osg/LightSource>
+#include <osgDB/ReadFile>
+
+// osgExample
+#include "InstancingScene.h"
+#include "LightUniformUpdateCallback.h"
+#include "InstancePlacement.h"
+#include "InstanceStatisticsCallback.h"
+#include "ComputeMemoryUsageVisitor.h"
+
+namespace
+{
+
+// every entry becomes one layer of the color texture array, instances pick a layer at random,
+// the tint multiplies the colors of the image so one asset gives several kinds of grass, all images need the same size
+struct TextureLayer
+{
+	const char* fileName;
+	float		tint[3];
+};
+
+const TextureLayer TEXTURE_LAYERS[] =
+{
+	{ "../data/grass.png", { 1.0f, 1.0f, 1.0f } },
+	{ "../data/grass.png", { 1.3f, 1.1f, 0.5f } },	// dry grass
+	{ "../data/grass.png", { 0.6f, 0.8f, 0.7f } },	// shaded grass
+	{ "../data/grass_flowers.png", { 1.0f, 1.0f, 1.0f } }
+};
+const unsigned int NUM_TEXTURE_LAYERS = sizeof(TEXTURE_LAYERS) / sizeof(TEXTURE_LAYERS[0]);
+
+struct Technique
+{
+	const char* name;
+	const char* description;
+};
+
+// in the order of the switch children
+const Technique TECHNIQUES[] =
+{
+	{ "software",			"software instancing" },
+	{ "uniforms",			"hardware instancing with uniforms" },
+	{ "texture",			"hardware instancing with textures" },
+	{ "ubo",				"hardware instancing with uniform buffer objects" },
+	{ "attribute",			"hardware instancing with vertex attribute divisor" },
+	{ "tbo_float",			"hardware instancing with float texture buffer" },
+	{ "tbo_packed",			"hardware instancing with packed texture buffer" },
+	{ "ssbo",				"hardware instancing with shader storage buffer objects" },
+	{ "tbo_quantized",		"hardware instancing with quantized texture buffer" },
+	{ "static_batching",	"static batching into merged cells" },
+	{ "point_expansion",	"hardware instancing with geometry shader point expansion" },
+	{ "vertex_pulling",		"hardware instancing with vertex pulling" },
+	{ "procedural",			"procedural instancing from the instance id" },
+	{ "placement",			"hardware instancing with transform feedback placement" }
+};
+const unsigned int NUM_TECHNIQUES = sizeof(TECHNIQUES) / sizeof(TECHNIQUES[0]);
+// the vertex attribute technique is switched on in a new scene
+const unsigned int DEFAULT_TECHNIQUE = 4;
+
+// figures of the builder taken when the scene was created, the user data of its switch
+struct BuilderMemoryUsage : public osg::Referenced
+{
+	osgExample::MemoryUsage usage;
+};
+
+// a copy of the image with the rgb channels multiplied by tint, only for 8 bit rgba images
+osg::ref_ptr<osg::Image> createTintedImage(osg::ref_ptr<osg::Image> image, const float* tint)
+{
+	if (!image.valid() || (tint[0] == 1.0f && tint[1] == 1.0f && tint[2] == 1.0f))
+		return image;
+
+	if (image->getPixelFormat() != GL_RGBA || image->getDataType() != GL_UNSIGNED_BYTE)
+		return image;
+
+	osg::ref_ptr<osg::Image> tintedImage = new osg::Image(*image, osg::CopyOp::DEEP_COPY_ALL);
+	for (int t = 0; t < tintedImage->t(); ++t)
+	{
+		// rows may be padded, so every row starts at its own address
+		unsigned char* row = tintedImage->data(0, t);
+		for (int s = 0; s < tintedImage->s(); ++s)
+		{
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				row[s * 4 + j] = (unsigned char)std::min(row[s * 4 + j] * tint[j] + 0.5f, 255.0f);
+			}
+		}
+	}
+
+	return tintedImage;
+}
+
+void initOpenGL(osg::GraphicsContext* context, GLint& maxNumUniforms, GLint& maxUniformBlockSize, GLint& maxTextureBufferSize, GLint& maxShaderStorageBlockSize, bool& transformFeedback)
+{
+
+	context->realize();
+	context->makeCurrent();
+	maxNumUniforms = 0;
+	glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS, &maxNumUniforms);
+	maxUniformBlockSize = 0;
+	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxUniformBlockSize);
+	maxTextureBufferSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+
+	// init glew
+	glewInit();
+
+	// shader storage buffers need OpenGL 4.3
+	maxShaderStorageBlockSize = 0;
+	if (GLEW_ARB_shader_storage_buffer_object)
+		glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxShaderStorageBlockSize);
+
+	// transform feedback and geometry shaders are core since OpenGL 3.2
+	transformFeedback = GLEW_VERSION_3_2 != 0;
+	context->releaseContext();
+
+	// ATI driver 11.6 didn't return right number of uniforms which lead to a crash, when the vertex shader was compiled(WTF?!)
+#ifdef ATI_FIX
+	maxNumUniforms      = 576;
+	maxUniformBlockSize = 16384;
+#endif
+}
+
+}
+
+namespace osgExample
+{
+
+InstancingScene::InstancingScene()
+	:	m_gpuPlacement(false)
+{
+}
+
+void InstancingScene::initialize(osg::GraphicsContext* context, osg::ArgumentParser& arguments)
+{
+	// get context to determine max number of uniforms in vertex shader
+	GLint maxNumUniforms = 0;
+	GLint maxUniformBlockSize = 0;
+	GLint maxTextureBufferSize = 0;
+	GLint maxShaderStorageBlockSize = 0;
+	bool transformFeedback = false;
+	initOpenGL(context, maxNumUniforms, maxUniformBlockSize, maxTextureBufferSize, maxShaderStorageBlockSize, transformFeedback);
+	m_gpuPlacement = transformFeedback && !arguments.read("--cpu-placement");
+
+	// we need to reserve some space for modelViewMatrix, projectionMatrix, modelViewProjectionMatrix and normalMatrix, we also need 16 float uniforms per matrix plus the instance attributes
+	unsigned int maxInstanceMatrices = (maxNumUniforms-64) / (16 + InstanceAttributes::NUM_VECTORS * 4);
+
+	m_builder = new InstancedGeometryBuilder(maxInstanceMatrices, maxUniformBlockSize);
+	if (maxTextureBufferSize > 0)
+		m_builder->setMaxTextureBufferSize(maxTextureBufferSize);
+	m_builder->setMaxShaderStorageBlockSize(maxShaderStorageBlockSize);
+	setup(arguments);
+}
+
+void InstancingScene::initialize(osg::ArgumentParser& arguments)
+{
+	m_gpuPlacement = false;
+	m_builder = new InstancedGeometryBuilder;
+	setup(arguments);
+}
+
+void InstancingScene::setup(osg::ArgumentParser& arguments)
+{
+	// load elevation model from asc
+	m_fileLoader.loadFromFile("../data/crater.asc");
+	createDensityMap();
+
+	m_builder->setDynamicInstances(arguments.read("--dynamic"));
+	m_builder->setWindGust(arguments.read("--wind-gust"));
+	unsigned int staticBatchCells = m_builder->getStaticBatchCells();
+	if (arguments.read("--static-batch-cells", staticBatchCells))
+		m_builder->setStaticBatchCells(staticBatchCells);
+	unsigned int staticBatchMemory = m_builder->getMaxStaticBatchMemory() / (1024 * 1024);
+	if (arguments.read("--static-batch-memory", staticBatchMemory))
+		m_builder->setMaxStaticBatchMemory((size_t)staticBatchMemory * 1024 * 1024);
+}
+
+void InstancingScene::createDensityMap()
+{
+	// nothing grows on the steep crater walls, the density falls off with the slope of the terrain
+	const float* heights = m_fileLoader.getHeightMap();
+	unsigned int width = m_fileLoader.getWidth();
+	unsigned int height = m_fileLoader.getHeight();
+	if (!heights)
+		return;
+
+	std::vector<float> slopes(width * height, 0.0f);
+	float maxSlope = 0.0f;
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			float h = heights[x + y * width];
+			float slopeX = fabs(heights[std::min(x + 1, width - 1) + y * width] - h);
+			float slopeY = fabs(heights[x + std::min(y + 1, height - 1) * width] - h);
+			slopes[x + y * width] = std::max(slopeX, slopeY);
+			maxSlope = std::max(maxSlope, slopes[x + y * width]);
+		}
+	}
+
+	m_densityMap.resize(width * height);
+	for (unsigned int i = 0; i < width * height; ++i)
+	{
+		float density = maxSlope > 0.0f ? 1.0f - std::min(slopes[i] / maxSlope * 4.0f, 1.0f) : 1.0f;
+		m_densityMap[i] = (unsigned char)(density * 255.0f + 0.5f);
+	}
+}
+
+osg::ref_ptr<osg::Geometry> InstancingScene::createQuads()
+{
+	// create two quads as geometry
+	osg::ref_ptr<osg::Vec3Array>	vertexArray = new osg::Vec3Array;
+	vertexArray->push_back(osg::Vec3(-1.0f, 0.0f, 0.0f));
+	vertexArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
+	vertexArray->push_back(osg::Vec3(-1.0f, 0.0f, 2.0f));
+	vertexArray->push_back(osg::Vec3(1.0f, 0.0f, 2.0f));
+
+	vertexArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
+	vertexArray->push_back(osg::Vec3(0.0f, 1.0f, 0.0f));
+	vertexArray->push_back(osg::Vec3(0.0f, -1.0f, 2.0f));
+	vertexArray->push_back(osg::Vec3(0.0f, 1.0f, 2.0f));
+
+	osg::ref_ptr<osg::DrawElementsUByte> primitive = new osg::DrawElementsUByte(GL_TRIANGLES);
+	primitive->push_back(0); primitive->push_back(1); primitive->push_back(2);
+	primitive->push_back(3); primitive->push_back(2); primitive->push_back(1);
+	primitive->push_back(4); primitive->push_back(5); primitive->push_back(6);
+	primitive->push_back(7); primitive->push_back(6); primitive->push_back(5);
+
+	osg::ref_ptr<osg::Vec3Array>        normalArray = new osg::Vec3Array;
+	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
+
+	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
+	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
+
+	osg::ref_ptr<osg::Vec2Array>		texCoords = new osg::Vec2Array;
+	texCoords->push_back(osg::Vec2(0.0f, 0.0f));
+	texCoords->push_back(osg::Vec2(1.0f, 0.0f));
+	texCoords->push_back(osg::Vec2(0.0f, 1.0f));
+	texCoords->push_back(osg::Vec2(1.0f, 1.0f));
+
+	texCoords->push_back(osg::Vec2(0.0f, 0.0f));
+	texCoords->push_back(osg::Vec2(1.0f, 0.0f));
+	texCoords->push_back(osg::Vec2(0.0f, 1.0f));
+	texCoords->push_back(osg::Vec2(1.0f, 1.0f));
+
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setVertexArray(vertexArray);
+	geometry->setNormalArray(normalArray);
+	geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+	geometry->setTexCoordArray(0, texCoords);
+	geometry->addPrimitiveSet(primitive);
+		
+	return geometry;
+}
+
+osg::ref_ptr<osg::Switch> InstancingScene::createScene(unsigned int x, unsigned int y, unsigned int seed, const OpenThreads::Atomic* cancelled) const
+{
+	osg::ref_ptr<osg::Switch>	switchNode = new osg::Switch;
+
+	// setup the instanced geometry builder
+	m_builder->setGeometry(createQuads());
+	if (!generateInstances(x, y, seed, cancelled))
+		return NULL;
+
+	// the procedural and placed techniques generate the same grid on the fly
+	unsigned int generatorSeed = rand();
+	for (unsigned int i = 0; i < NUM_TECHNIQUES; ++i)
+	{
+		if (cancelled && *cancelled)
+			return NULL;
+
+		switchNode->addChild(createTechniqueNode(i, x, y, generatorSeed), i == DEFAULT_TECHNIQUE);
+	}
+
+	// load textures into the layers of one texture array and add it to the quad
+	osg::ref_ptr<osg::Texture2DArray> texture = new osg::Texture2DArray;
+	for (unsigned int i = 0; i < NUM_TEXTURE_LAYERS; ++i)
+	{
+		osg::ref_ptr<osg::Image> image = createTintedImage(osgDB::readImageFile(TEXTURE_LAYERS[i].fileName), TEXTURE_LAYERS[i].tint);
+		if (i == 0)
+		{
+			texture->setTextureSize(image->s(), image->t(), NUM_TEXTURE_LAYERS);
+		}
+		texture->setImage(i, image);
+	}
+	texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+	texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+	texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+	texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+	texture->setUseHardwareMipMapGeneration(true);
+
+	osg::ref_ptr<osg::StateSet> stateSet = switchNode->getOrCreateStateSet();
+	stateSet->setTextureAttributeAndModes(0, texture, osg::StateAttribute::ON);
+	stateSet->addUniform(new osg::Uniform("colorTexture", 0));
+	stateSet->setAttributeAndModes(new osg::AlphaFunc(osg::AlphaFunc::GEQUAL, 0.8f), osg::StateAttribute::ON);
+
+	// add light source
+	osg::ref_ptr<osg::Light> light = new osg::Light(0);
+	light->setAmbient(osg::Vec4(0.4f, 0.4f, 0.4f, 1.0f));
+	light->setDiffuse(osg::Vec4(0.8f, 0.8f, 0.2f, 1.0f));
+	light->setPosition(osg::Vec4(-1.0f, -1.0f, -1.0f, 0.0f));
+	
+	osg::ref_ptr<osg::LightSource> lightSource = new osg::LightSource;
+	lightSource->setLight(light);
+	switchNode->addChild(lightSource);
+
+	// create uniforms for attribute instancing shader
+	stateSet->addUniform(new osg::Uniform("diffuseLightColor", light->getDiffuse()));
+	stateSet->addUniform(new osg::Uniform("ambientLightColor", light->getAmbient()));
+	// every camera gets its own view space light direction for all techniques below the switch
+	switchNode->addCullCallback(new LightUniformUpdateCallback(osg::Vec3(-1.0f, -1.0f, -1.0f)));
+	if (m_builder->getStatistics().valid())
+		switchNode->addCullCallback(new FrameStatisticsCallback(m_builder->getStatistics()));
+
+	// the next rebuild changes the builder while this scene is still shown
+	osg::ref_ptr<BuilderMemoryUsage> builderUsage = new BuilderMemoryUsage;
+	m_builder->computeMemoryUsage(builderUsage->usage);
+	switchNode->setUserData(builderUsage);
+
+	return switchNode;
+}
+
+osg::ref_ptr<osg::Node> InstancingScene::createTechniqueNode(unsigned int technique, unsigned int x, unsigned int y, unsigned int generatorSeed) const
+{
+	switch (technique)
+	{
+	case 0:
+		return m_builder->getSoftwareInstancedNode();
+	case 1:
+		return m_builder->getHardwareInstancedNode();
+	case 2:
+		return m_builder->getTextureHardwareInstancedNode();
+	case 3:
+		return m_builder->getUBOHardwareInstancedNode();
+	case 4:
+		return m_builder->getVertexAttribHardwareInstancedNode();
+	case 5:
+		return m_builder->getTextureBufferHardwareInstancedNode(InstancedGeometryBuilder::TEXTURE_BUFFER_FLOAT);
+	case 6:
+		return m_builder->getTextureBufferHardwareInstancedNode(InstancedGeometryBuilder::TEXTURE_BUFFER_PACKED);
+	case 7:
+		return m_builder->getShaderStorageBufferHardwareInstancedNode();
+	case 8:
+		return m_builder->getTextureBufferHardwareInstancedNode(InstancedGeometryBuilder::TEXTURE_BUFFER_QUANTIZED);
+	case 9:
+		return m_builder->getStaticBatchedNode();
+	case 10:
+		return m_builder->getPointExpansionNode();
+	case 11:
+		return m_builder->getVertexPullingNode();
+	case 12:
+		// the same grid again, but generated on the fly from the instance id
+		return m_builder->getProceduralInstancedNode(createGenerator(x, y, generatorSeed, false));
+	case 13:
+		// and once more, thinned out by the density map
+		return m_builder->getPlacedInstancedNode(new InstancePlacement(createGenerator(x, y, generatorSeed, true)), m_gpuPlacement);
+	default:
+		return NULL;
+	}
+}
+
+bool InstancingScene::generateInstances(unsigned int x, unsigned int y, unsigned int seed, const OpenThreads::Atomic* cancelled) const
+{
+	osg::Vec2 blockSize((float)m_fileLoader.getWidth() / (float)x, (float)m_fileLoader.getHeight() / (float)y);
+
+	// create some matrices
+	m_builder->clearMatrices();
+	m_builder->reserveMatrices(x * y);
+	srand(seed);
+	for (unsigned int i = 0; i < x; ++i)
+	{
+		// a newer rebuild request makes this one obsolete
+		if (cancelled && *cancelled)
+			return false;
+
+		for (unsigned int j = 0; j < y; ++j)
+		{
+			// get random angle and random scale
+			double angle = (rand() % 360) / 180.0 * M_PI;
+			double scale = (rand() % 10)  + 1.0;
+
+			// calculate position
+			osg::Vec3 position(i * blockSize.x(), j * blockSize.y(), 0.0f);
+			osg::Vec3 jittering((rand() % 100) * 0.02f, (rand() % 100) * 0.02f, 0.0f);
+			position += jittering;
+			position.z() = m_fileLoader.getNearestHeight(position.x(), position.y());
+			position.x() *= 2.0f;
+			position.y() *= 2.0f;
+
+			osg::Matrixd modelMatrix =  osg::Matrixd::scale(scale, scale, scale) * osg::Matrixd::rotate(angle, osg::Vec3d(0.0, 0.0, 1.0)) * osg::Matrixd::translate(position);
+
+			// get random tint, texture layer and wind phase
+			InstanceAttributes attributes;
+			float brightness = 0.8f + (rand() % 100) * 0.004f;
+			attributes.tint = osg::Vec4(brightness, brightness, 0.8f + (rand() % 100) * 0.002f, 1.0f);
+			attributes.textureLayer = rand() % NUM_TEXTURE_LAYERS;
+			attributes.windPhase = (rand() % 360) / 180.0f * (float)M_PI;
+
+			m_builder->addMatrix(modelMatrix, attributes);
+		}
+	}
+
+	return !(cancelled && *cancelled);
+}
+
+ProceduralInstanceGenerator InstancingScene::createGenerator(unsigned int x, unsigned int y, unsigned int seed, bool density) const
+{
+	ProceduralInstanceGenerator generator;
+	generator.setGrid(x, y, osg::Vec2((float)m_fileLoader.getWidth() / (float)x, (float)m_fileLoader.getHeight() / (float)y));
+	generator.setHeightMap(m_fileLoader.getHeightMap(), m_fileLoader.getWidth(), m_fileLoader.getHeight());
+	generator.setSeed(seed);
+	generator.setNumTextureLayers(NUM_TEXTURE_LAYERS);
+	if (density && !m_densityMap.empty())
+		generator.setDensityMap(&m_densityMap.front());
+
+	return generator;
+}
+
+unsigned int InstancingScene::getNumTechniques()
+{
+	return NUM_TECHNIQUES;
+}
+
+const char* InstancingScene::getTechniqueName(unsigned int technique)
+{
+	return technique < NUM_TECHNIQUES ? TECHNIQUES[technique].name : "";
+}
+
+const char* InstancingScene::getTechniqueDescription(unsigned int technique)
+{
+	return technique < NUM_TECHNIQUES ? TECHNIQUES[technique].description : "";
+}
+
+unsigned int InstancingScene::findTechnique(const std::string& name)
+{
+	for (unsigned int i = 0; i < NUM_TECHNIQUES; ++i)
+	{
+		if (name == TECHNIQUES[i].name)
+			return i;
+	}
+	return NUM_TECHNIQUES;
+}
+
+void InstancingScene::selectTechnique(osg::Switch* switchNode, unsigned int technique)
+{
+	switchNode->setSingleChildOn(technique);
+	switchNode->setValue(switchNode->getNumChildren()-1, true);
+}
+
+unsigned int InstancingScene::getSelectedTechnique(const osg::Switch* switchNode)
+{
+	for (unsigned int i = 0; i < NUM_TECHNIQUES && i < switchNode->getNumChildren(); ++i)
+	{
+		if (switchNode->getValue(i))
+			return i;
+	}
+	return NUM_TECHNIQUES;
+}
+
+void InstancingScene::computeMemoryUsage(osg::Switch* switchNode, unsigned int technique, MemoryUsage& usage) const
+{
+	usage.add(MemoryUsage::HEIGHT_MAP, m_fileLoader.getWidth() * m_fileLoader.getHeight() * sizeof(float) + m_densityMap.capacity(), 0);
+	const BuilderMemoryUsage* builderUsage = dynamic_cast<const BuilderMemoryUsage*>(switchNode->getUserData());
+	if (builderUsage)
+		usage.add(builderUsage->usage);
+
+	// the texture array of the vegetation is in the state of the switch
+	ComputeMemoryUsageVisitor visitor(usage);
+	visitor.applyStateSet(switchNode->getStateSet());
+	if (technique < switchNode->getNumChildren())
+		switchNode->getChild(technique)->accept(visitor);
+}
+
+}
\ No newline at end of file
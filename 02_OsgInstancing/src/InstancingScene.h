@@ -0,0 +1,112 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _INSTANCING_SCENE_H
+#define _INSTANCING_SCENE_H
+
+// std
+#include <vector>
+#include <string>
+
+// osg
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osg/Geometry>
+#include <osg/GraphicsContext>
+#include <osg/ArgumentParser>
+#include <OpenThreads/Atomic>
+
+// osgExample
+#include "InstancedGeometryBuilder.h"
+#include "ASCFileLoader.h"
+#include "ProceduralInstanceGenerator.h"
+#include "MemoryUsage.h"
+
+namespace osgExample
+{
+
+// The terrain, the instanced geometry builder and the scene with one switch child per technique, shared by
+// the example and the benchmark.
+class InstancingScene : public osg::Referenced
+{
+public:
+	InstancingScene();
+
+	// queries the limits of the context, loads the terrain and configures the builder from the command line
+	void initialize(osg::GraphicsContext* context, osg::ArgumentParser& arguments);
+	// without a graphics context the builder keeps its default limits and the instances are placed on the cpu
+	void initialize(osg::ArgumentParser& arguments);
+
+	// x * y instances of every technique with only the vertex attribute technique switched on, the light source is
+	// always the last child, the same seed gives the same instances, returns NULL as soon as cancelled becomes non zero
+	osg::ref_ptr<osg::Switch> createScene(unsigned int x, unsigned int y, unsigned int seed, const OpenThreads::Atomic* cancelled) const;
+
+	// the node of a single technique for the instances in the builder, the procedural and placed techniques
+	// generate the x * y grid themselves from the generator seed
+	osg::ref_ptr<osg::Node> createTechniqueNode(unsigned int technique, unsigned int x, unsigned int y, unsigned int generatorSeed) const;
+	// only fills the builder with the x * y instances of the scene
+	bool generateInstances(unsigned int x, unsigned int y, unsigned int seed, const OpenThreads::Atomic* cancelled) const;
+	// generator of the procedural instances on the same grid, density thins them out like the placed technique
+	ProceduralInstanceGenerator createGenerator(unsigned int x, unsigned int y, unsigned int seed, bool density) const;
+
+	// the mesh of every instance, two crossed quads
+	static osg::ref_ptr<osg::Geometry> createQuads();
+
+	inline osg::ref_ptr<InstancedGeometryBuilder> getBuilder() const { return m_builder; }
+	inline const ASCFileLoader& getFileLoader() const { return m_fileLoader; }
+	inline bool getGpuPlacement() const { return m_gpuPlacement; }
+
+	// the techniques in the order of the switch children
+	static unsigned int getNumTechniques();
+	// short name for benchmark results
+	static const char* getTechniqueName(unsigned int technique);
+	static const char* getTechniqueDescription(unsigned int technique);
+	// index of the technique with the given short name, getNumTechniques() if there is none
+	static unsigned int findTechnique(const std::string& name);
+
+	// the light source is the last child and has to stay on
+	static void selectTechnique(osg::Switch* switchNode, unsigned int technique);
+	// the first technique that is switched on, getNumTechniques() if there is none
+	static unsigned int getSelectedTechnique(const osg::Switch* switchNode);
+
+	// the terrain, the builder and everything the technique node and the state of the scene hold, the builder
+	// figures are those createScene stored with the switch, so a rebuild in the background doesn't interfere
+	void computeMemoryUsage(osg::Switch* switchNode, unsigned int technique, MemoryUsage& usage) const;
+
+private:
+	// loads the terrain and applies the command line to the builder
+	void setup(osg::ArgumentParser& arguments);
+	void createDensityMap();
+
+	ASCFileLoader				m_fileLoader;
+	osg::ref_ptr<InstancedGeometryBuilder> m_builder;
+	// vegetation density for the placed instances, one byte per height map sample
+	std::vector<unsigned char>	m_densityMap;
+	// place the instances with transform feedback, the cpu fallback produces the same ones
+	bool						m_gpuPlacement;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -10,35 +10,36 @@
 #include <osg/Matrix>
 #include <osg/Vec3>
 
+// osgExample
+#include "PerCameraUniformCallback.h"
+
 namespace osgExample
 {
 
-class LightUniformUpdateCallback : public osg::NodeCallback
+// Transforms the world space light direction into the view space of every camera.
+class LightUniformUpdateCallback : public PerCameraUniformCallback
 {
 public:
-	LightUniformUpdateCallback(osg::ref_ptr<osg::Uniform> lightDirection)
-		:	m_lightDirection(lightDirection)
+	LightUniformUpdateCallback(const osg::Vec3& worldLightDirection)
+		:	m_worldLightDirection(worldLightDirection, 0.0f)
+	{
+	}
+
+protected:
+	virtual void createUniforms(osg::StateSet& stateSet) const
 	{
-		osg::Vec3 worldLightDirection;
-		lightDirection->get(worldLightDirection);
-		m_worldLightDirection = osg::Vec4(worldLightDirection, 0.0f);
+		stateSet.addUniform(new osg::Uniform("lightDirection", osg::Vec3()));
 	}
 
-	virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
-    {
-		osg::ref_ptr<osgUtil::CullVisitor> cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
-		
-		if(cv)
-		{
-			osg::Matrixd modelViewMatrix = *cv->getModelViewMatrix();
-			osg::Vec4 newLightDirection = m_worldLightDirection * modelViewMatrix;
+	virtual void updateUniforms(osg::StateSet& stateSet, osgUtil::CullVisitor& cv) const
+	{
+		osg::Matrixd modelViewMatrix = *cv.getModelViewMatrix();
+		osg::Vec4 newLightDirection = m_worldLightDirection * modelViewMatrix;
 
-			m_lightDirection->set(osg::Vec3(newLightDirection.x(), newLightDirection.y(), newLightDirection.z()));
-		}
-    }
+		stateSet.getUniform("lightDirection")->set(osg::Vec3(newLightDirection.x(), newLightDirection.y(), newLightDirection.z()));
+	}
 
 private:
-	osg::ref_ptr<osg::Uniform> m_lightDirection;
 	osg::Vec4				   m_worldLightDirection;
 };
 
@@ -0,0 +1,122 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MemoryUsage.h"
+
+// std
+#include <iomanip>
+
+namespace osgExample
+{
+
+namespace
+{
+	const char* SUBSYSTEM_NAMES[MemoryUsage::NUM_SUBSYSTEMS] =
+	{
+		"height and density map",
+		"instance store",
+		"bounds matrix copies",
+		"osg arrays",
+		"textures",
+		"uniform arrays",
+		"uniform and storage buffers",
+		"raw gl buffers"
+	};
+}
+
+MemoryUsage::MemoryUsage()
+{
+	for (unsigned int i = 0; i < NUM_SUBSYSTEMS; ++i)
+	{
+		m_cpuBytes[i] = 0;
+		m_gpuBytes[i] = 0;
+	}
+}
+
+void MemoryUsage::add(Subsystem subsystem, size_t cpuBytes, size_t gpuBytes)
+{
+	m_cpuBytes[subsystem] += cpuBytes;
+	m_gpuBytes[subsystem] += gpuBytes;
+}
+
+bool MemoryUsage::addOnce(const void* object, Subsystem subsystem, size_t cpuBytes, size_t gpuBytes)
+{
+	if (!object || !m_counted.insert(object).second)
+		return false;
+
+	add(subsystem, cpuBytes, gpuBytes);
+	return true;
+}
+
+void MemoryUsage::add(const MemoryUsage& other)
+{
+	for (unsigned int i = 0; i < NUM_SUBSYSTEMS; ++i)
+	{
+		m_cpuBytes[i] += other.m_cpuBytes[i];
+		m_gpuBytes[i] += other.m_gpuBytes[i];
+	}
+	m_counted.insert(other.m_counted.begin(), other.m_counted.end());
+}
+
+size_t MemoryUsage::getTotalCpuBytes() const
+{
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < NUM_SUBSYSTEMS; ++i)
+		bytes += m_cpuBytes[i];
+	return bytes;
+}
+
+size_t MemoryUsage::getTotalGpuBytes() const
+{
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < NUM_SUBSYSTEMS; ++i)
+		bytes += m_gpuBytes[i];
+	return bytes;
+}
+
+const char* MemoryUsage::getSubsystemName(Subsystem subsystem)
+{
+	return subsystem < NUM_SUBSYSTEMS ? SUBSYSTEM_NAMES[subsystem] : "unknown";
+}
+
+void MemoryUsage::print(std::ostream& stream) const
+{
+	std::ios::fmtflags flags = stream.flags();
+	std::streamsize precision = stream.precision();
+	stream << std::fixed << std::setprecision(1);
+
+	stream << std::left << std::setw(30) << "subsystem" << std::right << std::setw(14) << "cpu KB" << std::setw(14) << "gpu KB" << std::endl;
+	for (unsigned int i = 0; i < NUM_SUBSYSTEMS; ++i)
+	{
+		stream << std::left << std::setw(30) << SUBSYSTEM_NAMES[i] << std::right
+			   << std::setw(14) << m_cpuBytes[i] / 1024.0 << std::setw(14) << m_gpuBytes[i] / 1024.0 << std::endl;
+	}
+	stream << std::left << std::setw(30) << "total" << std::right
+		   << std::setw(14) << getTotalCpuBytes() / 1024.0 << std::setw(14) << getTotalGpuBytes() / 1024.0 << std::endl;
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+}
\ No newline at end of file
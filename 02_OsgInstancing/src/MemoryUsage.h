@@ -0,0 +1,78 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MEMORY_USAGE_H
+#define _MEMORY_USAGE_H
+
+// std
+#include <set>
+#include <ostream>
+
+namespace osgExample
+{
+
+// Bytes held by the scene on the cpu and the gpu, broken down by subsystem. The gpu figures are what
+// the gl objects were created with, the driver may round them up.
+class MemoryUsage
+{
+public:
+	enum Subsystem
+	{
+		HEIGHT_MAP,			// terrain heights and density map, also their textures for the gpu placement
+		INSTANCE_STORE,		// matrices, attributes and instance data of the builder and the drawables
+		BOUNDS_MATRICES,	// matrix copies and block bounds held by the bounding box callbacks
+		OSG_ARRAYS,			// vertex arrays and primitive sets of osg geometries and of the mesh pool
+		TEXTURES,			// images of textures, texture arrays and buffer textures
+		UNIFORMS,			// uniform arrays of the uniform technique
+		BUFFER_BINDINGS,	// ranges of uniform and shader storage buffers
+		GL_BUFFERS,			// buffers the InstancedDrawable creates without osg
+		NUM_SUBSYSTEMS
+	};
+
+	MemoryUsage();
+
+	void add(Subsystem subsystem, size_t cpuBytes, size_t gpuBytes);
+	// for objects that several nodes share, e.g. the instance data, only the first call counts
+	bool addOnce(const void* object, Subsystem subsystem, size_t cpuBytes, size_t gpuBytes);
+	// all figures of other, the shared objects it counted won't be counted again
+	void add(const MemoryUsage& other);
+
+	inline size_t getCpuBytes(Subsystem subsystem) const { return m_cpuBytes[subsystem]; }
+	inline size_t getGpuBytes(Subsystem subsystem) const { return m_gpuBytes[subsystem]; }
+	size_t getTotalCpuBytes() const;
+	size_t getTotalGpuBytes() const;
+
+	static const char* getSubsystemName(Subsystem subsystem);
+
+	// a table of all subsystems in KB
+	void print(std::ostream& stream) const;
+private:
+	size_t					m_cpuBytes[NUM_SUBSYSTEMS];
+	size_t					m_gpuBytes[NUM_SUBSYSTEMS];
+	std::set<const void*>	m_counted;
+};
+
+}
+
+#endif
\ No newline at end of file
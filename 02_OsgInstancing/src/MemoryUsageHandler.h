@@ -0,0 +1,78 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MEMORY_USAGE_HANDLER_H
+#define _MEMORY_USAGE_HANDLER_H
+
+// std
+#include <iostream>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osgViewer/Viewer>
+
+// osgExample
+#include "InstancingScene.h"
+#include "MemoryUsage.h"
+
+namespace osgExample {
+
+// prints the memory of the current technique, broken down by subsystem, whenever m is pressed
+class MemoryUsageHandler : public osgGA::GUIEventHandler
+{
+public:
+	MemoryUsageHandler(osg::ref_ptr<osgViewer::Viewer> viewer, osg::ref_ptr<InstancingScene> scene)
+		:	m_viewer(viewer),
+			m_scene(scene)
+	{
+	}
+
+	virtual bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa)
+	{
+		if (ea.getEventType() != osgGA::GUIEventAdapter::KEYUP || ea.getKey() != osgGA::GUIEventAdapter::KEY_M)
+			return false;
+
+		// rebuilt scenes replace the scene data, so the switch is looked up every time
+		osg::Switch* switchNode = dynamic_cast<osg::Switch*>(m_viewer->getSceneData());
+		if (!switchNode)
+			return false;
+
+		unsigned int technique = InstancingScene::getSelectedTechnique(switchNode);
+		MemoryUsage usage;
+		m_scene->computeMemoryUsage(switchNode, technique, usage);
+
+		std::cout << "Memory usage of " << (technique < InstancingScene::getNumTechniques() ? InstancingScene::getTechniqueDescription(technique) : "no technique") << std::endl;
+		usage.print(std::cout);
+		return true;
+	}
+
+private:
+	osg::ref_ptr<osgViewer::Viewer>	m_viewer;
+	osg::ref_ptr<InstancingScene>	m_scene;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,366 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MeshOptimizer.h"
+
+// std
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+
+const int CACHE_SIZE = 32;
+
+float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	// vertices without triangles left must never pull a triangle in
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// the last triangle's vertices get a fixed score so we don't just repeat them
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+	}
+
+	// prefer vertices with few triangles left to get rid of lonely triangles early
+	score += 2.0f / sqrtf((float)remainingTriangles);
+
+	return score;
+}
+
+template<class ArrayType>
+bool remapArray(osg::Array* array, const std::vector<unsigned int>& remap)
+{
+	ArrayType* typedArray = dynamic_cast<ArrayType*>(array);
+	if (!typedArray || typedArray->size() != remap.size())
+		return false;
+
+	osg::ref_ptr<ArrayType> original = new ArrayType(*typedArray);
+	for (unsigned int i = 0; i < remap.size(); ++i)
+	{
+		(*typedArray)[remap[i]] = (*original)[i];
+	}
+	typedArray->dirty();
+
+	return true;
+}
+
+bool remapAnyArray(osg::Array* array, const std::vector<unsigned int>& remap)
+{
+	return remapArray<osg::Vec2Array>(array, remap) ||
+		   remapArray<osg::Vec3Array>(array, remap) ||
+		   remapArray<osg::Vec4Array>(array, remap) ||
+		   remapArray<osg::Vec4ubArray>(array, remap) ||
+		   remapArray<osg::FloatArray>(array, remap);
+}
+
+}
+
+namespace osgExample
+{
+
+namespace MeshOptimizer
+{
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices)
+{
+	unsigned int numTriangles = indices.size() / 3;
+	if (numTriangles == 0)
+		return;
+
+	// adjacency: triangles of every vertex
+	std::vector<unsigned int> remaining(numVertices, 0u);
+	for (unsigned int i = 0; i < numTriangles * 3; ++i)
+	{
+		++remaining[indices[i]];
+	}
+
+	std::vector<unsigned int> offsets(numVertices + 1, 0u);
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		offsets[i+1] = offsets[i] + remaining[i];
+	}
+
+	std::vector<unsigned int> vertexTriangles(numTriangles * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < numTriangles * 3; ++i)
+	{
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int>   cachePosition(numVertices, -1);
+	std::vector<float> score(numVertices);
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		score[i] = vertexScore(-1, remaining[i]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool>  emitted(numTriangles, false);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		triangleScore[i] = score[indices[i*3]] + score[indices[i*3+1]] + score[indices[i*3+2]];
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(numTriangles * 3);
+	std::vector<unsigned int> cache;
+	cache.reserve(CACHE_SIZE + 3);
+	unsigned int scanPosition = 0u;
+
+	int bestTriangle = 0;
+	for (unsigned int i = 1; i < numTriangles; ++i)
+	{
+		if (triangleScore[i] > triangleScore[bestTriangle])
+			bestTriangle = i;
+	}
+
+	while (bestTriangle >= 0)
+	{
+		// emit the triangle and remove it from the adjacency of its vertices
+		emitted[bestTriangle] = true;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			unsigned int vertex = indices[bestTriangle*3+i];
+			result.push_back(vertex);
+
+			unsigned int* begin = &vertexTriangles[offsets[vertex]];
+			unsigned int* end = begin + remaining[vertex];
+			std::remove(begin, end, (unsigned int)bestTriangle);
+			--remaining[vertex];
+		}
+
+		// move its vertices to the front of the simulated lru cache
+		std::vector<unsigned int> newCache;
+		newCache.reserve(CACHE_SIZE + 3);
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			newCache.push_back(indices[bestTriangle*3+i]);
+		}
+		for (auto it = cache.begin(); it != cache.end(); ++it)
+		{
+			if (std::find(newCache.begin(), newCache.end(), *it) == newCache.end())
+				newCache.push_back(*it);
+		}
+
+		// vertices pushed out of the cache lose their cache bonus
+		for (unsigned int i = CACHE_SIZE; i < newCache.size(); ++i)
+		{
+			cachePosition[newCache[i]] = -1;
+			score[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+		}
+		if (newCache.size() > (unsigned int)CACHE_SIZE)
+			newCache.resize(CACHE_SIZE);
+		cache.swap(newCache);
+
+		for (unsigned int i = 0; i < cache.size(); ++i)
+		{
+			cachePosition[cache[i]] = i;
+			score[cache[i]] = vertexScore(i, remaining[cache[i]]);
+		}
+
+		// only triangles touching the cache changed their score, the best one of them comes next
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cache.size(); ++i)
+		{
+			unsigned int vertex = cache[i];
+			for (unsigned int j = 0; j < remaining[vertex]; ++j)
+			{
+				unsigned int triangle = vertexTriangles[offsets[vertex] + j];
+				triangleScore[triangle] = score[indices[triangle*3]] + score[indices[triangle*3+1]] + score[indices[triangle*3+2]];
+				if (triangleScore[triangle] > bestScore)
+				{
+					bestScore = triangleScore[triangle];
+					bestTriangle = triangle;
+				}
+			}
+		}
+
+		// the cache ran dry, continue with the next triangle which hasn't been emitted yet
+		if (bestTriangle < 0)
+		{
+			while (scanPosition < numTriangles && emitted[scanPosition])
+			{
+				++scanPosition;
+			}
+			if (scanPosition < numTriangles)
+				bestTriangle = scanPosition;
+		}
+	}
+
+	// keep a trailing incomplete triangle if there was one
+	result.insert(result.end(), indices.begin() + numTriangles * 3, indices.end());
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& remap)
+{
+	const unsigned int unused = ~0u;
+	remap.assign(numVertices, unused);
+
+	unsigned int next = 0u;
+	for (auto it = indices.begin(); it != indices.end(); ++it)
+	{
+		if (remap[*it] == unused)
+			remap[*it] = next++;
+		*it = remap[*it];
+	}
+
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		if (remap[i] == unused)
+			remap[i] = next++;
+	}
+}
+
+bool optimizeGeometry(osg::Geometry& geometry)
+{
+	osg::Array* vertices = geometry.getVertexArray();
+	if (!vertices || geometry.getNumPrimitiveSets() != 1)
+		return false;
+
+	osg::DrawElements* drawElements = geometry.getPrimitiveSet(0)->getDrawElements();
+	if (!drawElements || drawElements->getMode() != GL_TRIANGLES)
+		return false;
+
+	// every other array has to be bound per vertex, otherwise we can't reorder the vertices
+	std::vector<osg::Array*> arrays;
+	arrays.push_back(vertices);
+	if (geometry.getNormalArray())
+	{
+		if (geometry.getNormalBinding() != osg::Geometry::BIND_PER_VERTEX)
+			return false;
+		arrays.push_back(geometry.getNormalArray());
+	}
+	if (geometry.getColorArray())
+	{
+		if (geometry.getColorBinding() != osg::Geometry::BIND_PER_VERTEX)
+			return false;
+		arrays.push_back(geometry.getColorArray());
+	}
+	for (unsigned int i = 0; i < geometry.getNumTexCoordArrays(); ++i)
+	{
+		if (geometry.getTexCoordArray(i))
+			arrays.push_back(geometry.getTexCoordArray(i));
+	}
+	for (auto it = arrays.begin(); it != arrays.end(); ++it)
+	{
+		if ((*it)->getNumElements() != vertices->getNumElements())
+			return false;
+	}
+
+	std::vector<unsigned int> indices(drawElements->getNumIndices());
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = drawElements->index(i);
+	}
+
+	std::vector<unsigned int> remap;
+	optimizeVertexCache(indices, vertices->getNumElements());
+	optimizeVertexFetch(indices, vertices->getNumElements(), remap);
+
+	// check all arrays first, so we never leave a half reordered geometry behind
+	for (auto it = arrays.begin(); it != arrays.end(); ++it)
+	{
+		if (!dynamic_cast<osg::Vec2Array*>(*it) && !dynamic_cast<osg::Vec3Array*>(*it) && !dynamic_cast<osg::Vec4Array*>(*it) &&
+			!dynamic_cast<osg::Vec4ubArray*>(*it) && !dynamic_cast<osg::FloatArray*>(*it))
+			return false;
+	}
+	for (auto it = arrays.begin(); it != arrays.end(); ++it)
+	{
+		remapAnyArray(*it, remap);
+	}
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		drawElements->setElement(i, indices[i]);
+	}
+	drawElements->dirty();
+	geometry.dirtyBound();
+
+	return true;
+}
+
+GLuint packNormal(const osg::Vec3& normal)
+{
+	GLuint packed = 0u;
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		int component = (int)floorf(std::min(std::max(normal[i], -1.0f), 1.0f) * 511.0f + 0.5f);
+		packed |= ((GLuint)component & 0x3ffu) << (i * 10);
+	}
+
+	return packed;
+}
+
+GLushort floatToHalf(float value)
+{
+	GLuint bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	GLuint sign = (bits >> 16) & 0x8000u;
+	int exponent = (int)((bits >> 23) & 0xffu) - 127 + 15;
+	GLuint mantissa = bits & 0x7fffffu;
+
+	// nan and infinity
+	if (((bits >> 23) & 0xffu) == 0xffu)
+		return (GLushort)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+
+	// too large, clamp to infinity
+	if (exponent >= 31)
+		return (GLushort)(sign | 0x7c00u);
+
+	// too small for a normalized half, produce a denormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (GLushort)sign;
+
+		mantissa |= 0x800000u;
+		GLuint shift = 14 - exponent;
+		GLuint half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1u)
+			++half;
+		return (GLushort)(sign | half);
+	}
+
+	// round to nearest, a carry into the exponent is still correct
+	GLuint half = sign | ((GLuint)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000u)
+		++half;
+
+	return (GLushort)half;
+}
+
+}
+
+}
\ No newline at end of file
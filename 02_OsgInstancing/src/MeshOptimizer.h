@@ -0,0 +1,60 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MESH_OPTIMIZER_H
+#define _MESH_OPTIMIZER_H
+
+// std
+#include <vector>
+
+// osg
+#include <osg/Geometry>
+
+namespace osgExample
+{
+
+namespace MeshOptimizer
+{
+
+// Reorders the triangles of an indexed triangle list for the post transform vertex cache
+// (Tom Forsyth's linear speed vertex cache optimisation).
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices);
+
+// Renumbers the vertices in the order they are first used by the index list, so vertex fetches walk
+// through memory linearly. remap[oldIndex] is the new position of a vertex, unused vertices go last.
+void optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& remap);
+
+// Runs both optimizations on a geometry with one triangle list and per vertex arrays,
+// returns false and leaves the geometry untouched if it has any other layout.
+bool optimizeGeometry(osg::Geometry& geometry);
+
+// compressed vertex formats
+GLuint packNormal(const osg::Vec3& normal);	// GL_INT_2_10_10_10_REV, normalized
+GLushort floatToHalf(float value);			// GL_HALF_FLOAT
+
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MeshPool.h"
+
+// std
+#include <algorithm>
+
+// osg
+#include <osg/Image>
+#include <osg/PrimitiveSet>
+
+// single channel integer format of buffer textures, not defined by older gl headers
+#ifndef GL_R32UI
+#define GL_R32UI 0x8236
+#endif
+#ifndef GL_RED_INTEGER
+#define GL_RED_INTEGER 0x8D94
+#endif
+
+namespace osgExample
+{
+
+MeshPool::MeshPool()
+	:	m_vertices(new osg::Vec4Array),
+		m_indices(new osg::UIntArray)
+{
+}
+
+MeshPool::~MeshPool()
+{
+}
+
+MeshPool::MeshRange MeshPool::addMesh(const osg::Geometry& geometry)
+{
+	MeshRange range;
+	const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry.getVertexArray());
+	const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>(geometry.getNormalArray());
+	const osg::Vec2Array* texCoords = dynamic_cast<const osg::Vec2Array*>(geometry.getTexCoordArray(0));
+	const osg::DrawElements* primitive = geometry.getNumPrimitiveSets() ? geometry.getPrimitiveSet(0)->getDrawElements() : NULL;
+	if (!vertices || !primitive)
+		return range;
+
+	range.numVertices = vertices->size();
+	range.numIndices = primitive->getNumIndices();
+	range.mode = primitive->getMode();
+	range.firstVertex = m_vertexAllocator.allocate(range.numVertices);
+	range.firstIndex = m_indexAllocator.allocate(range.numIndices);
+
+	// the scene on screen may draw arrays a texture was created for, including ranges the rebuild just freed,
+	// so the mesh goes into copies of them, arrays without a texture are written in place until they are full
+	unsigned int numVertexTexels = m_vertices->size();
+	if (m_vertexAllocator.getCapacity() * TEXELS_PER_VERTEX > numVertexTexels)
+		numVertexTexels = std::max(m_vertexAllocator.getCapacity() * TEXELS_PER_VERTEX, numVertexTexels * 2);
+	if (m_vertexTexture.valid() || numVertexTexels > m_vertices->size())
+	{
+		osg::ref_ptr<osg::Vec4Array> vertices = new osg::Vec4Array(numVertexTexels);
+		std::copy(m_vertices->begin(), m_vertices->end(), vertices->begin());
+		m_vertices = vertices;
+		m_vertexTexture = NULL;
+	}
+
+	unsigned int numIndices = m_indices->size();
+	if (m_indexAllocator.getCapacity() > numIndices)
+		numIndices = std::max(m_indexAllocator.getCapacity(), numIndices * 2);
+	if (m_indexTexture.valid() || numIndices > m_indices->size())
+	{
+		osg::ref_ptr<osg::UIntArray> indices = new osg::UIntArray(numIndices);
+		std::copy(m_indices->begin(), m_indices->end(), indices->begin());
+		m_indices = indices;
+		m_indexTexture = NULL;
+	}
+
+	for (unsigned int i = 0; i < range.numVertices; ++i)
+	{
+		osg::Vec3 normal = (normals && i < normals->size()) ? (*normals)[i] : osg::Vec3(0.0f, 0.0f, 1.0f);
+		osg::Vec2 texCoord = (texCoords && i < texCoords->size()) ? (*texCoords)[i] : osg::Vec2();
+
+		(*m_vertices)[(range.firstVertex + i) * TEXELS_PER_VERTEX]     = osg::Vec4((*vertices)[i], texCoord.x());
+		(*m_vertices)[(range.firstVertex + i) * TEXELS_PER_VERTEX + 1] = osg::Vec4(normal, texCoord.y());
+	}
+
+	for (unsigned int i = 0; i < range.numIndices; ++i)
+	{
+		(*m_indices)[range.firstIndex + i] = primitive->index(i);
+	}
+
+	return range;
+}
+
+void MeshPool::removeMesh(const MeshRange& range)
+{
+	// the data stays where it is, the range is only reused in copies of the arrays or before any texture points to them
+	m_vertexAllocator.free(range.firstVertex, range.numVertices);
+	m_indexAllocator.free(range.firstIndex, range.numIndices);
+}
+
+void MeshPool::computeMemoryUsage(MemoryUsage& usage) const
+{
+	usage.addOnce(m_vertices.get(), MemoryUsage::OSG_ARRAYS, m_vertices->getTotalDataSize(), 0);
+	usage.addOnce(m_indices.get(), MemoryUsage::OSG_ARRAYS, m_indices->getTotalDataSize(), 0);
+}
+
+osg::ref_ptr<osg::TextureBuffer> MeshPool::getVertexTexture()
+{
+	if (!m_vertexTexture.valid())
+	{
+		osg::ref_ptr<osg::Image> image = new osg::Image;
+		image->setImage(std::max((unsigned int)m_vertices->size(), 1u), 1, 1, GL_RGBA32F_ARB, GL_RGBA, GL_FLOAT,
+						m_vertices->empty() ? NULL : (unsigned char*)&m_vertices->front(), osg::Image::NO_DELETE);
+		image->setUserData(m_vertices.get());
+
+		m_vertexTexture = new osg::TextureBuffer(image);
+		m_vertexTexture->setInternalFormat(GL_RGBA32F_ARB);
+	}
+
+	return m_vertexTexture;
+}
+
+osg::ref_ptr<osg::TextureBuffer> MeshPool::getIndexTexture()
+{
+	if (!m_indexTexture.valid())
+	{
+		osg::ref_ptr<osg::Image> image = new osg::Image;
+		image->setImage(std::max((unsigned int)m_indices->size(), 1u), 1, 1, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+						m_indices->empty() ? NULL : (unsigned char*)&m_indices->front(), osg::Image::NO_DELETE);
+		image->setUserData(m_indices.get());
+
+		m_indexTexture = new osg::TextureBuffer(image);
+		m_indexTexture->setInternalFormat(GL_R32UI);
+	}
+
+	return m_indexTexture;
+}
+
+}
\ No newline at end of file
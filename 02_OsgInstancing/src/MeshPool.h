@@ -0,0 +1,91 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MESH_POOL_H
+#define _MESH_POOL_H
+
+// osg
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Geometry>
+#include <osg/Array>
+#include <osg/TextureBuffer>
+
+// osgExample
+#include "BufferSubAllocator.h"
+#include "MemoryUsage.h"
+
+namespace osgExample
+{
+
+// Keeps the vertices and indices of all meshes in two large buffers, so shaders can pull any mesh by
+// its offsets without a vertex array object of its own. Every vertex takes two RGBA32F texels:
+// (position, s) and (normal, t). Indices are R32UI and relative to the first vertex of their mesh.
+// The arrays are copied on write once a texture points to them, so the rebuild thread can add meshes while
+// nodes with the textures of earlier arrays are drawn.
+class MeshPool : public osg::Referenced
+{
+public:
+	static const unsigned int TEXELS_PER_VERTEX = 2u;
+
+	struct MeshRange
+	{
+		MeshRange() : firstVertex(0u), numVertices(0u), firstIndex(0u), numIndices(0u), mode(GL_TRIANGLES) {}
+
+		unsigned int	firstVertex;
+		unsigned int	numVertices;
+		unsigned int	firstIndex;
+		unsigned int	numIndices;
+		GLenum			mode;
+	};
+
+	MeshPool();
+
+	// copies the first primitive set of the geometry and its per vertex normals and texture coordinates into the pool,
+	// add the new mesh before removing the one it replaces so nodes that still draw the old one keep it
+	MeshRange addMesh(const osg::Geometry& geometry);
+	void removeMesh(const MeshRange& range);
+
+	// buffer textures of the current contents
+	osg::ref_ptr<osg::TextureBuffer> getVertexTexture();
+	osg::ref_ptr<osg::TextureBuffer> getIndexTexture();
+
+	// the arrays behind the buffer textures, which only point into them
+	void computeMemoryUsage(MemoryUsage& usage) const;
+
+protected:
+	virtual ~MeshPool();
+
+private:
+	BufferSubAllocator				m_vertexAllocator;
+	BufferSubAllocator				m_indexAllocator;
+	osg::ref_ptr<osg::Vec4Array>	m_vertices;
+	osg::ref_ptr<osg::UIntArray>	m_indices;
+	osg::ref_ptr<osg::TextureBuffer> m_vertexTexture;
+	osg::ref_ptr<osg::TextureBuffer> m_indexTexture;
+};
+
+}
+
+#endif
\ No newline at end of file
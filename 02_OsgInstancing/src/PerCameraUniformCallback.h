@@ -0,0 +1,104 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _PER_CAMERA_UNIFORM_CALLBACK_H
+#define _PER_CAMERA_UNIFORM_CALLBACK_H
+
+// std
+#include <map>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Node>
+#include <osg/Camera>
+#include <osg/StateSet>
+#include <osgUtil/CullVisitor>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+namespace osgExample
+{
+
+// Cull callback that pushes its own StateSet for every camera while the subgraph is culled. Every camera
+// owns two StateSets used in alternating frames, so the draw thread can still read the uniforms of the
+// last frame while the next cull traversal writes the other set. It has to sit on a group above the
+// geodes, because a geode adds its drawables after the cull callback returned.
+class PerCameraUniformCallback : public osg::NodeCallback
+{
+public:
+	virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+	{
+		osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+		if (!cv)
+		{
+			traverse(node, nv);
+			return;
+		}
+
+		osg::StateSet* stateSet = getStateSet(*cv);
+		updateUniforms(*stateSet, *cv);
+
+		cv->pushStateSet(stateSet);
+		traverse(node, nv);
+		cv->popStateSet();
+	}
+
+protected:
+	virtual void createUniforms(osg::StateSet& stateSet) const = 0;
+	virtual void updateUniforms(osg::StateSet& stateSet, osgUtil::CullVisitor& cv) const = 0;
+
+private:
+	struct CameraStateSets
+	{
+		osg::ref_ptr<osg::StateSet> stateSets[2];
+	};
+
+	osg::StateSet* getStateSet(osgUtil::CullVisitor& cv)
+	{
+		unsigned int frame = cv.getFrameStamp() ? cv.getFrameStamp()->getFrameNumber() % 2 : 0;
+
+		// cameras may be culled by different threads, only the lookup needs the lock
+		CameraStateSets* cameraStateSets;
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+			cameraStateSets = &m_cameraStateSets[cv.getCurrentCamera()];
+		}
+
+		osg::ref_ptr<osg::StateSet>& stateSet = cameraStateSets->stateSets[frame];
+		if (!stateSet.valid())
+		{
+			stateSet = new osg::StateSet;
+			createUniforms(*stateSet);
+		}
+
+		return stateSet.get();
+	}
+
+	std::map<const osg::Camera*, CameraStateSets>	m_cameraStateSets;
+	OpenThreads::Mutex								m_mutex;
+};
+
+} // namespace osgExample
+
+#endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#define _USE_MATH_DEFINES 1 // fix for visual studio
+#include <cmath>
+#include <algorithm>
+#include <cfloat>
+
+#include "ProceduralInstanceGenerator.h"
+
+// osg
+#include <osg/Image>
+#include <osg/TextureRectangle>
+#include <osg/Uniform>
+
+namespace osgExample
+{
+
+ProceduralInstanceGenerator::ProceduralInstanceGenerator()
+	:	m_numX(0u),
+		m_numY(0u),
+		m_stepX(0u),
+		m_stepY(0u),
+		m_seed(0u),
+		m_numTextureLayers(1u),
+		m_heights(NULL),
+		m_density(NULL),
+		m_width(0u),
+		m_height(0u),
+		m_minHeight(0.0f),
+		m_maxHeight(0.0f)
+{
+	// the shader gets the same table, so it doesn't need to evaluate sin and cos itself
+	for (unsigned int i = 0; i < NUM_YAW_STEPS; ++i)
+	{
+		double angle = i * 2.0 * M_PI / NUM_YAW_STEPS;
+		m_yawTable[i].set((float)cos(angle), (float)sin(angle));
+	}
+}
+
+void ProceduralInstanceGenerator::setGrid(unsigned int numX, unsigned int numY, const osg::Vec2& blockSize)
+{
+	m_numX = numX;
+	m_numY = numY;
+	m_stepX = (unsigned int)(blockSize.x() * FIXED_POINT_SCALE + 0.5f);
+	m_stepY = (unsigned int)(blockSize.y() * FIXED_POINT_SCALE + 0.5f);
+}
+
+void ProceduralInstanceGenerator::setHeightMap(const float* heights, unsigned int width, unsigned int height)
+{
+	m_heights = heights;
+	m_width = width;
+	m_height = height;
+
+	m_minHeight = m_heights ? FLT_MAX : 0.0f;
+	m_maxHeight = m_heights ? -FLT_MAX : 0.0f;
+	for (unsigned int i = 0; m_heights && i < m_width * m_height; ++i)
+	{
+		m_minHeight = std::min(m_minHeight, m_heights[i]);
+		m_maxHeight = std::max(m_maxHeight, m_heights[i]);
+	}
+}
+
+unsigned int ProceduralInstanceGenerator::hash(unsigned int x)
+{
+	// lowbias32, all operations wrap around at 32 bit just like uint in glsl
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+void ProceduralInstanceGenerator::computeFixedPosition(unsigned int instance, unsigned int random, unsigned int& x, unsigned int& y) const
+{
+	// the jittering moves the instance up to two samples away from its block origin
+	x = (instance / m_numY) * m_stepX + (random & 511u);
+	y = (instance % m_numY) * m_stepY + ((random >> 9) & 511u);
+}
+
+unsigned int ProceduralInstanceGenerator::getNearestSample(unsigned int x, unsigned int y) const
+{
+	unsigned int nearestX = std::min((x + FIXED_POINT_SCALE / 2) / FIXED_POINT_SCALE, m_width - 1);
+	unsigned int nearestY = std::min((y + FIXED_POINT_SCALE / 2) / FIXED_POINT_SCALE, m_height - 1);
+	return nearestX + nearestY * m_width;
+}
+
+osg::Matrixd ProceduralInstanceGenerator::computeMatrix(unsigned int instance) const
+{
+	unsigned int random = getRandom(instance);
+
+	unsigned int x, y;
+	computeFixedPosition(instance, random, x, y);
+
+	// the terrain is scaled by two, both factors are powers of two so the conversion is exact
+	float height = m_heights ? m_heights[getNearestSample(x, y)] : 0.0f;
+	osg::Vec3 position((float)x * (2.0f / FIXED_POINT_SCALE), (float)y * (2.0f / FIXED_POINT_SCALE), height);
+
+	const osg::Vec2& yaw = m_yawTable[(random >> 18) & (NUM_YAW_STEPS - 1)];
+	float scale = (float)((random >> 24) % 10u + 1u);
+	float scaledCos = yaw.x() * scale;
+	float scaledSin = yaw.y() * scale;
+
+	return osg::Matrixd(scaledCos, scaledSin, 0.0, 0.0,
+						-scaledSin, scaledCos, 0.0, 0.0,
+						0.0, 0.0, scale, 0.0,
+						position.x(), position.y(), position.z(), 1.0);
+}
+
+InstanceAttributes ProceduralInstanceGenerator::computeAttributes(unsigned int instance) const
+{
+	unsigned int random = hash(getRandom(instance));
+
+	// the steps are powers of two, so every product is exact and one rounding remains for each sum
+	InstanceAttributes attributes;
+	float brightness = 0.8f + (float)((random >> 18) & 255u) * (1.0f / 512.0f);
+	attributes.tint = osg::Vec4(brightness, brightness, 0.8f + (float)(random >> 26) * (1.0f / 256.0f), 1.0f);
+	attributes.textureLayer = random % m_numTextureLayers;
+	attributes.windPhase = (float)((random >> 8) & 1023u) * (6.28318530718f / 1024.0f);
+
+	return attributes;
+}
+
+bool ProceduralInstanceGenerator::isPlaced(unsigned int instance) const
+{
+	if (!m_density || !m_heights)
+		return true;
+
+	unsigned int random = getRandom(instance);
+	unsigned int x, y;
+	computeFixedPosition(instance, random, x, y);
+
+	unsigned int density = m_density[getNearestSample(x, y)];
+	return density == 255u || (hash(hash(random)) & 255u) < density;
+}
+
+void ProceduralInstanceGenerator::generate(std::vector<osg::Matrixd>& matrices, std::vector<InstanceAttributes>& attributes) const
+{
+	matrices.clear();
+	attributes.clear();
+
+	for (unsigned int i = 0; i < getNumInstances(); ++i)
+	{
+		if (!isPlaced(i))
+			continue;
+
+		matrices.push_back(computeMatrix(i));
+		attributes.push_back(computeAttributes(i));
+	}
+}
+
+osg::BoundingBox ProceduralInstanceGenerator::computeBound(const osg::BoundingBox& localBound) const
+{
+	osg::BoundingBox bound;
+	if (!getNumInstances() || !localBound.valid())
+		return bound;
+
+	// any yaw and a scale of up to 10, the sway moves the top by at most 5% of the height
+	float maxScale = 10.0f;
+	float radius = std::max(std::max(-localBound.xMin(), localBound.xMax()), std::max(-localBound.yMin(), localBound.yMax()));
+	radius = (radius * sqrtf(2.0f) + 0.05f * std::max(localBound.zMax(), 0.0f)) * maxScale;
+
+	float maxX = (float)((m_numX - 1) * m_stepX + 511u) * (2.0f / FIXED_POINT_SCALE);
+	float maxY = (float)((m_numY - 1) * m_stepY + 511u) * (2.0f / FIXED_POINT_SCALE);
+	bound.expandBy(osg::Vec3(-radius, -radius, m_minHeight + std::min(localBound.zMin(), 0.0f) * maxScale));
+	bound.expandBy(osg::Vec3(maxX + radius, maxY + radius, m_maxHeight + std::max(localBound.zMax(), 0.0f) * maxScale));
+
+	return bound;
+}
+
+void ProceduralInstanceGenerator::applyToStateSet(osg::StateSet* stateSet, unsigned int heightMapUnit) const
+{
+	stateSet->addUniform(new osg::Uniform("hashedSeed", hash(m_seed)));
+	stateSet->addUniform(new osg::Uniform("gridHeight", m_numY));
+	stateSet->addUniform(new osg::Uniform("gridStepX", m_stepX));
+	stateSet->addUniform(new osg::Uniform("gridStepY", m_stepY));
+	stateSet->addUniform(new osg::Uniform("numTextureLayers", m_numTextureLayers));
+
+	osg::ref_ptr<osg::Uniform> yawTable = new osg::Uniform(osg::Uniform::FLOAT_VEC2, "yawTable", NUM_YAW_STEPS);
+	for (unsigned int i = 0; i < NUM_YAW_STEPS; ++i)
+	{
+		yawTable->setElement(i, m_yawTable[i]);
+	}
+	stateSet->addUniform(yawTable);
+
+	// the heights are fetched without filtering, so the shader gets exactly the sample the reference uses
+	osg::ref_ptr<osg::Image> image = new osg::Image;
+	if (m_heights)
+	{
+		image->setImage(m_width, m_height, 1, GL_LUMINANCE32F_ARB, GL_LUMINANCE, GL_FLOAT, (unsigned char*)m_heights, osg::Image::NO_DELETE);
+	} else {
+		image->allocateImage(1, 1, 1, GL_LUMINANCE, GL_FLOAT);
+		image->setInternalTextureFormat(GL_LUMINANCE32F_ARB);
+		*(float*)image->data() = 0.0f;
+	}
+
+	osg::ref_ptr<osg::TextureRectangle> texture = new osg::TextureRectangle(image);
+	texture->setInternalFormat(GL_LUMINANCE32F_ARB);
+	texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+	texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+	stateSet->setTextureAttribute(heightMapUnit, texture, osg::StateAttribute::ON);
+	stateSet->addUniform(new osg::Uniform("heightMap", (int)heightMapUnit));
+}
+
+}
\ No newline at end of file
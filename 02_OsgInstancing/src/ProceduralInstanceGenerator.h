@@ -0,0 +1,121 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _PROCEDURAL_INSTANCE_GENERATOR_H
+#define _PROCEDURAL_INSTANCE_GENERATOR_H
+
+// std
+#include <vector>
+
+// osg
+#include <osg/Matrixd>
+#include <osg/Vec2>
+#include <osg/BoundingBox>
+#include <osg/StateSet>
+
+// osgExample
+#include "InstanceAttributes.h"
+
+namespace osgExample
+{
+
+// Generates the instances of a jittered grid on a height map from nothing but the instance id and a seed.
+// The vertex shader of the procedural technique runs the same code, so this is the CPU reference for culling
+// and picking and the fallback of the transform feedback placement. Positions are computed in fixed point,
+// the yaw is taken from a table and the attributes only use steps that are exact in float, so the results
+// match the shaders bit by bit.
+class ProceduralInstanceGenerator
+{
+public:
+	// number of distinct yaw angles
+	static const unsigned int NUM_YAW_STEPS = 64u;
+	// positions are stored in 1/FIXED_POINT_SCALE height map samples
+	static const unsigned int FIXED_POINT_SCALE = 256u;
+
+	ProceduralInstanceGenerator();
+
+	// numX * numY instances, one in each block of the grid
+	void setGrid(unsigned int numX, unsigned int numY, const osg::Vec2& blockSize);
+	// the heights are not copied and have to stay valid
+	void setHeightMap(const float* heights, unsigned int width, unsigned int height);
+	// one byte per height map sample, a candidate survives with a probability of density/256 or always
+	// for 255, without a density map every candidate survives
+	inline void setDensityMap(const unsigned char* density) { m_density = density; }
+	inline void setSeed(unsigned int seed) { m_seed = seed; }
+	inline unsigned int getSeed() const { return m_seed; }
+	inline void setNumTextureLayers(unsigned int numTextureLayers) { m_numTextureLayers = numTextureLayers; }
+
+	inline unsigned int getNumInstances() const { return m_numX * m_numY; }
+
+	osg::Matrixd computeMatrix(unsigned int instance) const;
+	InstanceAttributes computeAttributes(unsigned int instance) const;
+	// whether the candidate passes the density map
+	bool isPlaced(unsigned int instance) const;
+	// all surviving candidates in the order of their ids
+	void generate(std::vector<osg::Matrixd>& matrices, std::vector<InstanceAttributes>& attributes) const;
+	// bound of all instances of a mesh with the given bound
+	osg::BoundingBox computeBound(const osg::BoundingBox& localBound) const;
+
+	// uniforms and height texture the vertex shader needs to generate the same instances
+	void applyToStateSet(osg::StateSet* stateSet, unsigned int heightMapUnit) const;
+
+	// integer hash which the shader reproduces exactly
+	static unsigned int hash(unsigned int x);
+
+	// the shader inputs for code that sets them up without osg
+	inline unsigned int getGridHeight() const { return m_numY; }
+	inline unsigned int getStepX() const { return m_stepX; }
+	inline unsigned int getStepY() const { return m_stepY; }
+	inline unsigned int getNumTextureLayers() const { return m_numTextureLayers; }
+	inline const osg::Vec2* getYawTable() const { return m_yawTable; }
+	inline const float* getHeightMap() const { return m_heights; }
+	inline const unsigned char* getDensityMap() const { return m_density; }
+	inline unsigned int getHeightMapWidth() const { return m_width; }
+	inline unsigned int getHeightMapHeight() const { return m_height; }
+
+private:
+	inline unsigned int getRandom(unsigned int instance) const { return hash(instance ^ hash(m_seed)); }
+	// position in fixed point height map samples
+	void computeFixedPosition(unsigned int instance, unsigned int random, unsigned int& x, unsigned int& y) const;
+	// index of the nearest height map sample
+	unsigned int getNearestSample(unsigned int x, unsigned int y) const;
+
+	unsigned int	m_numX;
+	unsigned int	m_numY;
+	unsigned int	m_stepX;
+	unsigned int	m_stepY;
+	unsigned int	m_seed;
+	unsigned int	m_numTextureLayers;
+	const float*	m_heights;
+	const unsigned char* m_density;
+	unsigned int	m_width;
+	unsigned int	m_height;
+	float			m_minHeight;
+	float			m_maxHeight;
+	osg::Vec2		m_yawTable[NUM_YAW_STEPS];
+};
+
+}
+
+#endif
\ No newline at end of file
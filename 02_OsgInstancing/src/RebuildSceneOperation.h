@@ -0,0 +1,97 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _REBUILD_SCENE_OPERATION_H
+#define _REBUILD_SCENE_OPERATION_H
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osg/OperationThread>
+#include <osg/Timer>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+namespace osgExample
+{
+
+// builds a scene of x * y instances, returns NULL as soon as cancelled becomes non zero(it may be NULL)
+typedef osg::ref_ptr<osg::Switch> (*SetupSceneFuncPtr)(unsigned int, unsigned int, const OpenThreads::Atomic*);
+
+// Runs the scene setup on an osg::OperationThread. The result is picked up by the event traversal once the
+// operation is done, a cancelled operation stops at the next check and never delivers a scene. The setup runs
+// while the previous scene is drawn, so it may only write into arrays that scene doesn't use: the builder
+// replaces its instance data and the mesh pool copies the arrays it handed out before adding a mesh.
+class RebuildSceneOperation : public osg::Operation
+{
+public:
+	RebuildSceneOperation(SetupSceneFuncPtr setupScene, unsigned int size)
+		:	osg::Operation("RebuildSceneOperation", false),
+			m_setupScene(setupScene),
+			m_size(size),
+			m_buildTime(0.0)
+	{
+	}
+
+	virtual void operator()(osg::Object*)
+	{
+		osg::ref_ptr<osg::Switch> scene;
+		osg::Timer_t startTick = osg::Timer::instance()->tick();
+		if (!m_cancelled)
+			scene = m_setupScene(m_size, m_size, &m_cancelled);
+		m_buildTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		if (!m_cancelled)
+			m_scene = scene;
+		m_done.exchange(1);
+	}
+
+	inline void cancel() { m_cancelled.exchange(1); }
+	inline bool isDone() const { return m_done != 0; }
+	inline unsigned int getSize() const { return m_size; }
+	// milliseconds the scene setup took, valid once the operation is done
+	inline double getBuildTime() const { return m_buildTime; }
+
+	osg::ref_ptr<osg::Switch> takeScene()
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+		osg::ref_ptr<osg::Switch> scene = m_scene;
+		m_scene = NULL;
+		return scene;
+	}
+
+private:
+	SetupSceneFuncPtr			m_setupScene;
+	unsigned int				m_size;
+	double						m_buildTime;
+	OpenThreads::Atomic			m_cancelled;
+	OpenThreads::Atomic			m_done;
+	OpenThreads::Mutex			m_mutex;
+	osg::ref_ptr<osg::Switch>	m_scene;
+};
+
+}
+
+#endif
\ No newline at end of file
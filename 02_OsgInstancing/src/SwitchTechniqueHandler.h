@@ -24,80 +24,145 @@
 #ifndef _SWITCH_TECHNIQUE_HANDLER_H
 #define _SWITCH_TECHNIQUE_HANDLER_H
 
-namespace osgExample {
-
 // std
 #include <iostream>
 
 // osg
 #include <osg/ref_ptr>
 #include <osg/Switch>
+#include <osg/OperationThread>
 #include <osgViewer/Viewer>
 #include <osgViewer/ViewerEventHandlers>
+#include <osgUtil/IncrementalCompileOperation>
+
+// osgExample
+#include "RebuildSceneOperation.h"
+#include "InstancingScene.h"
+#include "InstanceStatistics.h"
+
+namespace osgExample {
 
 class SwitchInstancingHandler : public osgGA::GUIEventHandler
 {
 public:
-	typedef osg::ref_ptr<osg::Switch> (*SetupSceneFuncPtr)(unsigned int, unsigned int);
-
 	SwitchInstancingHandler(osg::ref_ptr<osgViewer::Viewer> viewer, osg::ref_ptr<osg::Switch> switchNode, SetupSceneFuncPtr setupScene)
 		:	m_viewer(viewer),
 			m_switch(switchNode),
 			m_size(64.0f),
+			m_rebuildTime(0.0),
 			m_setupScene(setupScene)
 	{
+		// scenes are rebuilt in the background while the current one keeps rendering
+		m_rebuildThread = new osg::OperationThread;
+		m_rebuildThread->startThread();
+	}
+
+	~SwitchInstancingHandler()
+	{
+		if (m_rebuildOperation.valid())
+			m_rebuildOperation->cancel();
+
+		m_rebuildThread->setDone(true);
+		m_rebuildThread->join();
 	}
 
 	virtual bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa)
 	{
+		// a finished rebuild goes on to the incremental compile
+		if (ea.getEventType() == osgGA::GUIEventAdapter::FRAME && m_rebuildOperation.valid() && m_rebuildOperation->isDone())
+		{
+			osg::ref_ptr<osg::Switch> switchNode = m_rebuildOperation->takeScene();
+			m_rebuildTime = m_rebuildOperation->getBuildTime();
+			std::cout << "Built scene of size " << m_rebuildOperation->getSize() << "x" << m_rebuildOperation->getSize() << " in " << m_rebuildTime << " ms" << std::endl;
+			m_rebuildOperation = NULL;
+
+			if (switchNode.valid())
+				compileScene(switchNode);
+		}
+
+		// the stats overlay shows the duration of the last rebuild in every frame
+		if (ea.getEventType() == osgGA::GUIEventAdapter::FRAME && m_viewer->getViewerStats() && m_viewer->getFrameStamp())
+			m_viewer->getViewerStats()->setAttribute(m_viewer->getFrameStamp()->getFrameNumber(), InstanceStatistics::REBUILD_TIME, m_rebuildTime);
+
+		// swap in a rebuilt scene at the start of the frame after its last object was compiled
+		if (ea.getEventType() == osgGA::GUIEventAdapter::FRAME && m_pendingSwitch.valid() && m_compileSet->compiled())
+		{
+			swapScene(m_pendingSwitch);
+			std::cout << "Compiled new scene" << std::endl;
+		}
+
 		if (ea.getEventType() == osgGA::GUIEventAdapter::KEYUP)
 		{
 			switch(ea.getKey())
 			{
 			case osgGA::GUIEventAdapter::KEY_1:
-				m_switch->setSingleChildOn(0);
-				m_switch->setValue(5, true);
-				std::cout << "Switched to software instancing" << std::endl;
+				selectTechnique(0);
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_2:
-				m_switch->setSingleChildOn(1);
-				m_switch->setValue(5, true);
-				std::cout << "Switched to hardware instancing with uniforms" << std::endl;
+				selectTechnique(1);
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_3:
-				m_switch->setSingleChildOn(2);
-				m_switch->setValue(5, true);
-				std::cout << "Switched to hardware instancing with textures" << std::endl;
+				selectTechnique(2);
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_4:
-				m_switch->setSingleChildOn(3);
-				m_switch->setValue(5, true);
-				std::cout << "Switched to hardware instancing with uniform buffer objects" << std::endl;
+				selectTechnique(3);
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_5:
-				m_switch->setSingleChildOn(4);
-				m_switch->setValue(5, true);
-				std::cout << "Switched to hardware instancing with vertex attribute divisor" << std::endl;
+				selectTechnique(4);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_6:
+				selectTechnique(5);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_7:
+				selectTechnique(6);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_8:
+				selectTechnique(7);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_9:
+				selectTechnique(8);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_0:
+				selectTechnique(9);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_P:
+				selectTechnique(10);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_V:
+				selectTechnique(11);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_G:
+				selectTechnique(12);
+				return true;
+				break;
+			case osgGA::GUIEventAdapter::KEY_F:
+				selectTechnique(13);
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_Plus:
 				m_size *= 2.0f;
 				m_size = std::min(std::max(m_size, 8.0f), 1024.0f);
-				m_switch = m_setupScene((unsigned int)m_size, (unsigned int)m_size);
-				m_viewer->setSceneData(m_switch);
-				std::cout << "Increased scene size to " << m_size << "x" << m_size << std::endl;
+				rebuildScene();
+				std::cout << "Increasing scene size to " << m_size << "x" << m_size << std::endl;
 				return true;
 				break;
 			case osgGA::GUIEventAdapter::KEY_Minus:
 				m_size *= 0.5f;
 				m_size = std::min(std::max(m_size, 8.0f), 1024.0f);
-				m_switch = m_setupScene((unsigned int)m_size, (unsigned int)m_size);
-				m_viewer->setSceneData(m_switch);
-				std::cout << "Decreased scene size to " << m_size << "x" << m_size << std::endl;
+				rebuildScene();
+				std::cout << "Decreasing scene size to " << m_size << "x" << m_size << std::endl;
 				return true;
 				break;
 			default:
@@ -109,9 +174,65 @@ public:
 		return false;
 	}
 private:
+	void selectTechnique(unsigned int index)
+	{
+		InstancingScene::selectTechnique(m_switch, index);
+		std::cout << "Switched to " << InstancingScene::getTechniqueDescription(index) << std::endl;
+	}
+
+	void rebuildScene()
+	{
+		// only the newest request matters, an older one still queued or running is cancelled
+		if (m_rebuildOperation.valid())
+		{
+			m_rebuildOperation->cancel();
+			m_rebuildThread->remove(m_rebuildOperation.get());
+		}
+
+		m_rebuildOperation = new RebuildSceneOperation(m_setupScene, (unsigned int)m_size);
+		m_rebuildThread->add(m_rebuildOperation.get());
+	}
+
+	void compileScene(osg::ref_ptr<osg::Switch> switchNode)
+	{
+		osgUtil::IncrementalCompileOperation* compileOperation = m_viewer->getIncrementalCompileOperation();
+		if (!compileOperation)
+		{
+			swapScene(switchNode);
+			return;
+		}
+
+		// the old scene keeps rendering while the new one compiles within the per frame budget,
+		// a scene that is still compiling gets replaced by the newer one
+		if (m_compileSet.valid())
+			compileOperation->remove(m_compileSet);
+
+		m_compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(switchNode);
+		m_pendingSwitch = switchNode;
+		compileOperation->add(m_compileSet);
+	}
+
+	void swapScene(osg::ref_ptr<osg::Switch> switchNode)
+	{
+		m_switch = switchNode;
+		m_viewer->setSceneData(m_switch);
+		m_pendingSwitch = NULL;
+		m_compileSet = NULL;
+	}
+
 	osg::ref_ptr<osg::Switch>		m_switch;
 	osg::ref_ptr<osgViewer::Viewer> m_viewer;
 	float							m_size;
+	// milliseconds of the last scene setup on the rebuild thread
+	double							m_rebuildTime;
+
+	// background thread for the scene setup and the newest rebuild request
+	osg::ref_ptr<osg::OperationThread>		m_rebuildThread;
+	osg::ref_ptr<RebuildSceneOperation>	m_rebuildOperation;
+
+	// rebuilt scene that waits for the incremental compile operation
+	osg::ref_ptr<osg::Switch>		m_pendingSwitch;
+	osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> m_compileSet;
 
 	SetupSceneFuncPtr				m_setupScene;
 };
@@ -0,0 +1,128 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+// Counts the heap allocations of a scene rebuild with the AllocationCounter. The instance store is
+// refilled in place and the techniques with a single drawable don't copy the instances, so refilling the
+// store and creating those techniques must allocate as often for 2n x 2n instances as for n x n. Runs from
+// the source directory like ctest starts it, it returns non zero if a check fails.
+
+// c-std
+#include <iostream>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osg/ArgumentParser>
+
+// osgExample
+#include "InstancingScene.h"
+#include "AllocationCounter.h"
+
+namespace
+{
+
+// generateInstances replaces the instance array, which may still be drawn by the previous scene: the array
+// object, its storage and the reservation for the new instances
+const unsigned int MAX_REBUILD_ALLOCATIONS = 3u;
+
+// techniques whose nodes don't depend on the number of instances
+const char* CONSTANT_TECHNIQUES[] = { "attribute", "procedural" };
+const unsigned int NUM_CONSTANT_TECHNIQUES = sizeof(CONSTANT_TECHNIQUES) / sizeof(CONSTANT_TECHNIQUES[0]);
+
+struct RebuildAllocations
+{
+	unsigned int instanceStore;
+	unsigned int techniques[NUM_CONSTANT_TECHNIQUES];
+};
+
+// a scene of the size is built first, it loads the textures, fills the caches of osg and stays alive like
+// the drawn one during a rebuild
+bool countRebuild(osgExample::InstancingScene* scene, unsigned int size, unsigned int seed, RebuildAllocations& allocations)
+{
+	osg::ref_ptr<osg::Switch> currentScene = scene->createScene(size, size, seed, NULL);
+	if (!currentScene.valid())
+		return false;
+
+	osgExample::AllocationCounter::start();
+	scene->generateInstances(size, size, seed, NULL);
+	osgExample::AllocationCounter::stop();
+	allocations.instanceStore = osgExample::AllocationCounter::getNumAllocations();
+
+	for (unsigned int i = 0; i < NUM_CONSTANT_TECHNIQUES; ++i)
+	{
+		unsigned int technique = osgExample::InstancingScene::findTechnique(CONSTANT_TECHNIQUES[i]);
+		osgExample::AllocationCounter::start();
+		osg::ref_ptr<osg::Node> node = scene->createTechniqueNode(technique, size, size, seed);
+		osgExample::AllocationCounter::stop();
+		allocations.techniques[i] = osgExample::AllocationCounter::getNumAllocations();
+		if (!node.valid())
+			return false;
+	}
+
+	return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+	unsigned int size = 64;
+	arguments.read("--size", size);
+	unsigned int seed = 1;
+	arguments.read("--seed", seed);
+
+	osg::ref_ptr<osgExample::InstancingScene> scene = new osgExample::InstancingScene;
+	scene->initialize(arguments);
+
+	RebuildAllocations smallScene, largeScene;
+	if (!countRebuild(scene, size, seed, smallScene) || !countRebuild(scene, size * 2, seed, largeScene))
+	{
+		std::cerr << "The scene could not be created" << std::endl;
+		return 1;
+	}
+
+	int result = 0;
+	std::cout << "instance store: " << smallScene.instanceStore << " allocations for " << size * size << " instances, "
+			  << largeScene.instanceStore << " for " << size * size * 4 << std::endl;
+	if (smallScene.instanceStore != largeScene.instanceStore || largeScene.instanceStore > MAX_REBUILD_ALLOCATIONS)
+	{
+		std::cerr << "Refilling the instance store depends on the number of instances or allocates more than "
+				  << MAX_REBUILD_ALLOCATIONS << " times" << std::endl;
+		result = 1;
+	}
+
+	for (unsigned int i = 0; i < NUM_CONSTANT_TECHNIQUES; ++i)
+	{
+		std::cout << CONSTANT_TECHNIQUES[i] << ": " << smallScene.techniques[i] << " allocations for " << size * size << " instances, "
+				  << largeScene.techniques[i] << " for " << size * size * 4 << std::endl;
+		if (smallScene.techniques[i] != largeScene.techniques[i])
+		{
+			std::cerr << "Creating the " << CONSTANT_TECHNIQUES[i] << " technique depends on the number of instances" << std::endl;
+			result = 1;
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
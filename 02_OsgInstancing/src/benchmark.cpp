@@ -0,0 +1,408 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Renders every instancing technique offscreen for a range of scene sizes and seeds and writes the averaged
+// timings to <output>.json and <output>.csv. Uses a pbuffer, so on a machine without a gpu run it with Mesa's
+// software rasterizer on a virtual display, e.g. xvfb-run -a ./OsgInstancingBenchmark.
+
+// c-std
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osg/Timer>
+#include <osg/Stats>
+#include <osg/GraphicsContext>
+#include <osgViewer/Viewer>
+
+// osgExample
+#include "InstancingScene.h"
+#include "InstanceStatistics.h"
+
+struct BenchmarkResult
+{
+	std::string		technique;
+	unsigned int	size;
+	unsigned int	seed;
+	unsigned int	instances;
+	// averaged over the measured frames
+	double			visibleInstances;
+	double			drawCalls;
+	// gpu milliseconds of all chunks and of the slowest one, measured with timer queries
+	double			techniqueGpuTime;
+	double			maxChunkGpuTime;
+	// averaged over the measured frames, in milliseconds, the median of all repetitions
+	double			frameTime;
+	double			cullTime;
+	double			drawTime;
+	double			gpuTime;
+	// milliseconds to build the scene of this size and seed, the median of all repetitions
+	double			rebuildTime;
+	// median absolute deviation of the repetitions, the noise of the measurement
+	double			frameTimeDeviation;
+	double			rebuildTimeDeviation;
+	unsigned int	repetitions;
+	// resident set size of the process after the measured frames, the median of all repetitions and its deviation
+	size_t			residentMemory;
+	size_t			residentMemoryDeviation;
+};
+
+std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::istringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+	return items;
+}
+
+std::vector<unsigned int> splitNumbers(const std::string& list)
+{
+	std::vector<unsigned int> numbers;
+	std::vector<std::string> items = splitList(list);
+	for (std::vector<std::string>::const_iterator itr = items.begin(); itr != items.end(); ++itr)
+		numbers.push_back((unsigned int)strtoul(itr->c_str(), NULL, 10));
+	return numbers;
+}
+
+size_t getResidentMemory()
+{
+	// only available on linux, 0 everywhere else
+#ifdef __linux__
+	size_t residentPages = 0;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file)
+	{
+		unsigned long size = 0, resident = 0;
+		if (fscanf(file, "%lu %lu", &size, &resident) == 2)
+			residentPages = resident;
+		fclose(file);
+	}
+	// statm counts pages, which aren't 4 KB on every system
+	return residentPages * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+double getMedian(std::vector<double> values)
+{
+	if (values.empty())
+		return -1.0;
+
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+}
+
+// median of the distances to the median, one outlier doesn't change it like it changes the range
+double getMedianDeviation(const std::vector<double>& values)
+{
+	if (values.empty())
+		return 0.0;
+
+	double median = getMedian(values);
+	std::vector<double> deviations;
+	for (std::vector<double>::const_iterator itr = values.begin(); itr != values.end(); ++itr)
+		deviations.push_back(fabs(*itr - median));
+	return getMedian(deviations);
+}
+
+double getAveragedMilliseconds(osg::Stats* stats, unsigned int startFrame, unsigned int endFrame, const std::string& attribute)
+{
+	double value = 0.0;
+	if (!stats->getAveragedAttribute(startFrame, endFrame, attribute, value))
+		return -1.0;
+
+	return value * 1000.0;
+}
+
+void writeJSON(const std::string& fileName, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream file(fileName.c_str());
+	file << "[" << std::endl;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& result = results[i];
+		file << "\t{ \"technique\": \"" << result.technique << "\""
+			 << ", \"size\": " << result.size
+			 << ", \"seed\": " << result.seed
+			 << ", \"instances\": " << result.instances
+			 << ", \"visible_instances\": " << result.visibleInstances
+			 << ", \"draw_calls\": " << result.drawCalls
+			 << ", \"frame_ms\": " << result.frameTime
+			 << ", \"cull_ms\": " << result.cullTime
+			 << ", \"draw_ms\": " << result.drawTime
+			 << ", \"gpu_ms\": " << result.gpuTime
+			 << ", \"technique_gpu_ms\": " << result.techniqueGpuTime
+			 << ", \"max_chunk_gpu_ms\": " << result.maxChunkGpuTime
+			 << ", \"rebuild_ms\": " << result.rebuildTime
+			 << ", \"frame_ms_mad\": " << result.frameTimeDeviation
+			 << ", \"rebuild_ms_mad\": " << result.rebuildTimeDeviation
+			 << ", \"repetitions\": " << result.repetitions
+			 << ", \"resident_bytes\": " << result.residentMemory
+			 << ", \"resident_bytes_mad\": " << result.residentMemoryDeviation
+			 << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	file << "]" << std::endl;
+}
+
+void writeCSV(const std::string& fileName, const std::vector<BenchmarkResult>& results)
+{
+	std::ofstream file(fileName.c_str());
+	file << "technique,size,seed,instances,visible_instances,draw_calls,frame_ms,cull_ms,draw_ms,gpu_ms,technique_gpu_ms,max_chunk_gpu_ms,rebuild_ms,frame_ms_mad,rebuild_ms_mad,repetitions,resident_bytes,resident_bytes_mad" << std::endl;
+	for (std::vector<BenchmarkResult>::const_iterator itr = results.begin(); itr != results.end(); ++itr)
+	{
+		file << itr->technique << "," << itr->size << "," << itr->seed << "," << itr->instances << ","
+			 << itr->visibleInstances << "," << itr->drawCalls << ","
+			 << itr->frameTime << "," << itr->cullTime << "," << itr->drawTime << "," << itr->gpuTime << ","
+			 << itr->techniqueGpuTime << "," << itr->maxChunkGpuTime << ","
+			 << itr->rebuildTime << "," << itr->frameTimeDeviation << "," << itr->rebuildTimeDeviation << "," << itr->repetitions << ","
+			 << itr->residentMemory << "," << itr->residentMemoryDeviation << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+	if (arguments.read("--help"))
+	{
+		std::cout << "OpenSceneGraph Instancing Benchmark" << std::endl;
+		std::cout << "===================================" << std::endl << std::endl;
+		std::cout << "--techniques <a,b,...>  techniques to run, all by default:";
+		for (unsigned int i = 0; i < osgExample::InstancingScene::getNumTechniques(); ++i)
+			std::cout << " " << osgExample::InstancingScene::getTechniqueName(i);
+		std::cout << std::endl;
+		std::cout << "--sizes <a,b,...>       scenes of size x size instances, 16,64,256 by default" << std::endl;
+		std::cout << "--seeds <a,b,...>       random seeds of the instances, 1 by default" << std::endl;
+		std::cout << "--frames <n>            measured frames per configuration, 100 by default" << std::endl;
+		std::cout << "--warmup <n>            frames before the measurement that compile the scene, 20 by default" << std::endl;
+		std::cout << "--repetitions <n>       measurements of every configuration, the median counts, 3 by default" << std::endl;
+		std::cout << "--width <n> --height <n> size of the pbuffer, 1280x720 by default" << std::endl;
+		std::cout << "--output <prefix>       writes <prefix>.json and <prefix>.csv, benchmark by default" << std::endl;
+		std::cout << "The options of the example(--dynamic, --cpu-placement, --static-batch-cells, ...) apply as well" << std::endl;
+		return 0;
+	}
+
+	std::vector<unsigned int> techniques;
+	std::string techniqueList;
+	if (arguments.read("--techniques", techniqueList))
+	{
+		std::vector<std::string> names = splitList(techniqueList);
+		for (std::vector<std::string>::const_iterator itr = names.begin(); itr != names.end(); ++itr)
+		{
+			unsigned int technique = osgExample::InstancingScene::findTechnique(*itr);
+			if (technique == osgExample::InstancingScene::getNumTechniques())
+			{
+				std::cerr << "Unknown technique " << *itr << ", see --help" << std::endl;
+				return 1;
+			}
+			techniques.push_back(technique);
+		}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < osgExample::InstancingScene::getNumTechniques(); ++i)
+			techniques.push_back(i);
+	}
+
+	std::string sizeList = "16,64,256";
+	arguments.read("--sizes", sizeList);
+	std::vector<unsigned int> sizes = splitNumbers(sizeList);
+	std::string seedList = "1";
+	arguments.read("--seeds", seedList);
+	std::vector<unsigned int> seeds = splitNumbers(seedList);
+	unsigned int numFrames = 100;
+	arguments.read("--frames", numFrames);
+	unsigned int numWarmupFrames = 20;
+	arguments.read("--warmup", numWarmupFrames);
+	unsigned int numRepetitions = 3;
+	arguments.read("--repetitions", numRepetitions);
+	numRepetitions = std::max(numRepetitions, 1u);
+	unsigned int width = 1280;
+	unsigned int height = 720;
+	arguments.read("--width", width);
+	arguments.read("--height", height);
+	std::string output = "benchmark";
+	arguments.read("--output", output);
+
+	// offscreen context, nothing ever shows up on a screen
+	osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+	traits->readDISPLAY();
+	traits->setUndefinedScreenDetailsToDefaultScreen();
+	traits->x = 0;
+	traits->y = 0;
+	traits->width = width;
+	traits->height = height;
+	traits->windowDecoration = false;
+	traits->doubleBuffer = false;
+	traits->pbuffer = true;
+	osg::ref_ptr<osg::GraphicsContext> context = osg::GraphicsContext::createGraphicsContext(traits);
+	if (!context.valid())
+	{
+		std::cerr << "Could not create a pbuffer, is DISPLAY set to a running X server(e.g. Xvfb)?" << std::endl;
+		return 1;
+	}
+
+	osg::ref_ptr<osgExample::InstancingScene> scene = new osgExample::InstancingScene;
+	scene->initialize(context, arguments);
+
+	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer;
+	// everything happens on this thread, so the times of one frame do not overlap with the next
+	viewer->setThreadingModel(osgViewer::Viewer::SingleThreaded);
+	osg::Camera* camera = viewer->getCamera();
+	camera->setGraphicsContext(context);
+	camera->setViewport(0, 0, width, height);
+	camera->setProjectionMatrixAsPerspective(30.0, (double)width / (double)height, 1.0, 10000.0);
+	camera->setDrawBuffer(GL_FRONT);
+	camera->setReadBuffer(GL_FRONT);
+
+	// keep the stats of every measured frame plus the frames the gpu timer queries lag behind
+	const unsigned int numLagFrames = 4;
+	if (!camera->getStats())
+		camera->setStats(new osg::Stats("Camera"));
+	osg::Stats* stats = camera->getStats();
+	stats->allocate(numFrames + numLagFrames + 1);
+	stats->collectStats("rendering", true);
+	stats->collectStats("gpu", true);
+
+	// the instance counters of the scene go into the viewer stats
+	osg::Stats* viewerStats = viewer->getViewerStats();
+	viewerStats->allocate(numFrames + numLagFrames + 1);
+	osg::ref_ptr<osgExample::InstanceStatistics> statistics = new osgExample::InstanceStatistics(viewerStats);
+	scene->getBuilder()->setStatistics(statistics);
+	scene->getBuilder()->setGpuTimer(new osgExample::GpuTimer(statistics));
+
+	std::vector<BenchmarkResult> results;
+	for (std::vector<unsigned int>::const_iterator size = sizes.begin(); size != sizes.end(); ++size)
+	{
+		for (std::vector<unsigned int>::const_iterator seed = seeds.begin(); seed != seeds.end(); ++seed)
+		{
+			// the scene is built several times as well, the last one is rendered
+			osg::ref_ptr<osg::Switch> switchNode;
+			std::vector<double> rebuildTimes;
+			for (unsigned int i = 0; i < numRepetitions; ++i)
+			{
+				osg::Timer_t startTick = osg::Timer::instance()->tick();
+				switchNode = scene->createScene(*size, *size, *seed, NULL);
+				rebuildTimes.push_back(osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick()));
+			}
+			viewer->setSceneData(switchNode);
+			if (!viewer->isRealized())
+				viewer->realize();
+
+			// the same view of the whole scene for every technique
+			const osg::BoundingSphere& bound = switchNode->getBound();
+			camera->setViewMatrixAsLookAt(bound.center() + osg::Vec3(0.0f, -1.5f, 0.8f) * bound.radius(), bound.center(), osg::Vec3(0.0f, 0.0f, 1.0f));
+
+			for (std::vector<unsigned int>::const_iterator technique = techniques.begin(); technique != techniques.end(); ++technique)
+			{
+				osgExample::InstancingScene::selectTechnique(switchNode, *technique);
+
+				// the first frames compile the gl objects of the technique
+				for (unsigned int i = 0; i < numWarmupFrames; ++i)
+					viewer->frame();
+
+				// a single run is too noisy to compare against a baseline, so every measurement is repeated
+				std::vector<double> frameTimes, cullTimes, drawTimes, gpuTimes, techniqueGpuTimes, maxChunkGpuTimes, residentMemories;
+				unsigned int startFrame = 0;
+				unsigned int endFrame = 0;
+				for (unsigned int repetition = 0; repetition < numRepetitions; ++repetition)
+				{
+					startFrame = viewer->getFrameStamp()->getFrameNumber() + 1;
+					osg::Timer_t startTick = osg::Timer::instance()->tick();
+					for (unsigned int i = 0; i < numFrames; ++i)
+						viewer->frame();
+					osg::Timer_t endTick = osg::Timer::instance()->tick();
+					endFrame = viewer->getFrameStamp()->getFrameNumber();
+
+					// the gpu times of the last measured frames arrive a few frames later
+					for (unsigned int i = 0; i < numLagFrames; ++i)
+						viewer->frame();
+
+					frameTimes.push_back(osg::Timer::instance()->delta_m(startTick, endTick) / std::max(numFrames, 1u));
+					cullTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "Cull traversal time taken"));
+					drawTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "Draw traversal time taken"));
+					gpuTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "GPU draw time taken"));
+					// the timer queries are in milliseconds already
+					double techniqueGpuTime = -1.0;
+					double maxChunkGpuTime = -1.0;
+					viewerStats->getAveragedAttribute(startFrame, endFrame, osgExample::InstanceStatistics::TECHNIQUE_GPU_TIME, techniqueGpuTime);
+					viewerStats->getAveragedAttribute(startFrame, endFrame, osgExample::InstanceStatistics::MAX_CHUNK_GPU_TIME, maxChunkGpuTime);
+					techniqueGpuTimes.push_back(techniqueGpuTime);
+					maxChunkGpuTimes.push_back(maxChunkGpuTime);
+					residentMemories.push_back((double)getResidentMemory());
+				}
+
+				BenchmarkResult result;
+				result.technique = osgExample::InstancingScene::getTechniqueName(*technique);
+				result.size = *size;
+				result.seed = *seed;
+				result.instances = *size * *size;
+				result.visibleInstances = 0.0;
+				result.drawCalls = 0.0;
+				viewerStats->getAveragedAttribute(startFrame, endFrame, osgExample::InstanceStatistics::VISIBLE_INSTANCES, result.visibleInstances);
+				viewerStats->getAveragedAttribute(startFrame, endFrame, osgExample::InstanceStatistics::DRAW_CALLS, result.drawCalls);
+				result.frameTime = getMedian(frameTimes);
+				result.cullTime = getMedian(cullTimes);
+				result.drawTime = getMedian(drawTimes);
+				result.gpuTime = getMedian(gpuTimes);
+				result.techniqueGpuTime = getMedian(techniqueGpuTimes);
+				result.maxChunkGpuTime = getMedian(maxChunkGpuTimes);
+				result.rebuildTime = getMedian(rebuildTimes);
+				result.frameTimeDeviation = getMedianDeviation(frameTimes);
+				result.rebuildTimeDeviation = getMedianDeviation(rebuildTimes);
+				result.repetitions = numRepetitions;
+				result.residentMemory = (size_t)getMedian(residentMemories);
+				result.residentMemoryDeviation = (size_t)getMedianDeviation(residentMemories);
+				results.push_back(result);
+
+				std::cout << result.technique << " " << *size << "x" << *size << " seed " << *seed << ": "
+						  << result.frameTime << " ms per frame, cull " << result.cullTime << " ms, draw " << result.drawTime
+						  << " ms, gpu " << result.gpuTime << " ms, technique gpu " << result.techniqueGpuTime << " ms" << std::endl;
+			}
+		}
+	}
+
+	writeJSON(output + ".json", results);
+	writeCSV(output + ".csv", results);
+	std::cout << "Wrote " << results.size() << " results to " << output << ".json and " << output << ".csv" << std::endl;
+
+	return 0;
+}
\ No newline at end of file
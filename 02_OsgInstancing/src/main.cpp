@@ -23,190 +23,40 @@
 
 // c-std
 #include <ctime>
-#include <cstdlib>
-#define _USE_MATH_DEFINES 1 // fix for visual studio
-#include <cmath>
 #include <iostream>
-
-// glew
-#include <GL/glew.h>
+#include <string>
 
 // osg
 #include <osg/ref_ptr>
 #include <osg/Switch>
-#include <osg/Group>
-#include <osg/Geode>
-#include <osg/Geometry>
-#include <osg/AlphaFunc>
 #include <osgGA/StateSetManipulator>
 #include <osgViewer/Viewer>
 #include <osgViewer/ViewerEventHandlers>
-#include <osgDB/ReadFile>
-#include <osg/Light>
-#include <osg/LightSource>
+#include <osgUtil/IncrementalCompileOperation>
+#include <OpenThreads/Atomic>
 
 // osgExample
-#include "InstancedGeometryBuilder.h"
+#include "InstancingScene.h"
 #include "SwitchTechniqueHandler.h"
-#include "ASCFileLoader.h"
-#include "LightUniformUpdateCallback.h"
-
-osgExample::ASCFileLoader g_fileLoader;
-osg::ref_ptr<osgExample::InstancedGeometryBuilder> g_builder;
-
-void initOpenGL(osg::GraphicsContext* context, GLint& maxNumUniforms, GLint& maxUniformBlockSize)
-{
-
-	context->realize();
-	context->makeCurrent();
-	maxNumUniforms = 0;
-	glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS, &maxNumUniforms);
-	maxUniformBlockSize = 0;
-	glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxUniformBlockSize);
-
-	// init glew
-	glewInit();
-	context->releaseContext();
-
-	// ATI driver 11.6 didn't return right number of uniforms which lead to a crash, when the vertex shader was compiled(WTF?!)
-#ifdef ATI_FIX
-	maxNumUniforms      = 576;
-	maxUniformBlockSize = 16384;
-#endif
-}
+#include "InstanceStatistics.h"
+#include "CameraPathReplay.h"
+#include "MemoryUsageHandler.h"
 
-osg::ref_ptr<osg::Geometry> createQuads()
-{
-	// create two quads as geometry
-	osg::ref_ptr<osg::Vec3Array>	vertexArray = new osg::Vec3Array;
-	vertexArray->push_back(osg::Vec3(-1.0f, 0.0f, 0.0f));
-	vertexArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
-	vertexArray->push_back(osg::Vec3(-1.0f, 0.0f, 2.0f));
-	vertexArray->push_back(osg::Vec3(1.0f, 0.0f, 2.0f));
-
-	vertexArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
-	vertexArray->push_back(osg::Vec3(0.0f, 1.0f, 0.0f));
-	vertexArray->push_back(osg::Vec3(0.0f, -1.0f, 2.0f));
-	vertexArray->push_back(osg::Vec3(0.0f, 1.0f, 2.0f));
-
-	osg::ref_ptr<osg::DrawElementsUByte> primitive = new osg::DrawElementsUByte(GL_TRIANGLES);
-	primitive->push_back(0); primitive->push_back(1); primitive->push_back(2);
-	primitive->push_back(3); primitive->push_back(2); primitive->push_back(1);
-	primitive->push_back(4); primitive->push_back(5); primitive->push_back(6);
-	primitive->push_back(7); primitive->push_back(6); primitive->push_back(5);
-
-	osg::ref_ptr<osg::Vec3Array>        normalArray = new osg::Vec3Array;
-	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(0.0f, -1.0f, 0.0f));
-
-	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
-	normalArray->push_back(osg::Vec3(1.0f, 0.0f, 0.0f));
-
-	osg::ref_ptr<osg::Vec2Array>		texCoords = new osg::Vec2Array;
-	texCoords->push_back(osg::Vec2(0.0f, 0.0f));
-	texCoords->push_back(osg::Vec2(1.0f, 0.0f));
-	texCoords->push_back(osg::Vec2(0.0f, 1.0f));
-	texCoords->push_back(osg::Vec2(1.0f, 1.0f));
-
-	texCoords->push_back(osg::Vec2(0.0f, 0.0f));
-	texCoords->push_back(osg::Vec2(1.0f, 0.0f));
-	texCoords->push_back(osg::Vec2(0.0f, 1.0f));
-	texCoords->push_back(osg::Vec2(1.0f, 1.0f));
-
-
-	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
-	geometry->setVertexArray(vertexArray);
-	geometry->setNormalArray(normalArray);
-	geometry->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
-	geometry->setTexCoordArray(0, texCoords);
-	geometry->addPrimitiveSet(primitive);
-		
-	return geometry;
-}
+osg::ref_ptr<osgExample::InstancingScene> g_scene;
+// every scene gets new random instances unless a seed is given
+unsigned int g_seed = 0;
+bool g_fixedSeed = false;
 
-osg::ref_ptr<osg::Switch> setupScene(unsigned int x, unsigned int y)
+// runs on the rebuild thread of the SwitchInstancingHandler, everything it touches belongs to the new scene
+osg::ref_ptr<osg::Switch> setupScene(unsigned int x, unsigned int y, const OpenThreads::Atomic* cancelled)
 {
-	osg::ref_ptr<osg::Switch>	switchNode = new osg::Switch;
-
-	// setup the instanced geometry builder
-	g_builder->setGeometry(createQuads());
-	
-	osg::Vec2 blockSize((float)g_fileLoader.getWidth() / (float)x, (float)g_fileLoader.getHeight() / (float)y);
-	osg::Vec3 scale(2.0f, 2.0f, 1.0f);
-
-	// create some matrices
-	std::vector<osg::Matrixd> matrices;
-	g_builder->clearMatrices();
-	srand(time(NULL));
-	for (unsigned int i = 0; i < x; ++i)
-	{
-		for (unsigned int j = 0; j < y; ++j)
-		{
-			// get random angle and random scale
-			double angle = (rand() % 360) / 180.0 * M_PI;
-			double scale = (rand() % 10)  + 1.0;
-
-			// calculate position
-			osg::Vec3 position(i * blockSize.x(), j * blockSize.y(), 0.0f);
-			osg::Vec3 jittering((rand() % 100) * 0.02f, (rand() % 100) * 0.02f, 0.0f);
-			position += jittering;
-			position.z() = g_fileLoader.getNearestHeight(position.x(), position.y());
-			position.x() *= 2.0f;
-			position.y() *= 2.0f;
-
-			osg::Matrixd modelMatrix =  osg::Matrixd::scale(scale, scale, scale) * osg::Matrixd::rotate(angle, osg::Vec3d(0.0, 0.0, 1.0)) * osg::Matrixd::translate(position);
-			g_builder->addMatrix(modelMatrix);
-			matrices.push_back(modelMatrix);
-		}
-	}
-	
-	switchNode->addChild(g_builder->getSoftwareInstancedNode(), false);
-	switchNode->addChild(g_builder->getHardwareInstancedNode(), false);
-	switchNode->addChild(g_builder->getTextureHardwareInstancedNode(), false);
-	switchNode->addChild(g_builder->getUBOHardwareInstancedNode(), false);
-	switchNode->addChild(g_builder->getVertexAttribHardwareInstancedNode(), true);
-
-	// load texture and add it to the quad
-	osg::ref_ptr<osg::Image> image = osgDB::readImageFile("../data/grass.png");
-	osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(image);
-	texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
-	texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
-	texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
-	texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
-	texture->setUseHardwareMipMapGeneration(true);
-
-	osg::ref_ptr<osg::StateSet> stateSet = switchNode->getOrCreateStateSet();
-	stateSet->setTextureAttributeAndModes(0, texture, osg::StateAttribute::ON);
-	stateSet->addUniform(new osg::Uniform("colorTexture", 0));
-	stateSet->setAttributeAndModes(new osg::AlphaFunc(osg::AlphaFunc::GEQUAL, 0.8f), osg::StateAttribute::ON);
-
-	// add light source
-	osg::ref_ptr<osg::Light> light = new osg::Light(0);
-	light->setAmbient(osg::Vec4(0.4f, 0.4f, 0.4f, 1.0f));
-	light->setDiffuse(osg::Vec4(0.8f, 0.8f, 0.2f, 1.0f));
-	light->setPosition(osg::Vec4(-1.0f, -1.0f, -1.0f, 0.0f));
-	
-	osg::ref_ptr<osg::LightSource> lightSource = new osg::LightSource;
-	lightSource->setLight(light);
-	switchNode->addChild(lightSource);
-
-	// create uniforms for attribute instancing shader
-	stateSet->addUniform(new osg::Uniform("diffuseLightColor", light->getDiffuse()));
-	stateSet->addUniform(new osg::Uniform("ambientLightColor", light->getAmbient()));
-	osg::ref_ptr<osg::Uniform> lightDirection = new osg::Uniform("lightDirection", osg::Vec3(-1.0f, -1.0f, -1.0f));
-	stateSet->addUniform(lightDirection);
-	lightSource->addCullCallback(new osgExample::LightUniformUpdateCallback(lightDirection));
-
-	return switchNode;
+	return g_scene->createScene(x, y, g_fixedSeed ? g_seed : (unsigned int)time(NULL), cancelled);
 }
 
 int main(int argc, char** argv)
 {
-	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer;
+	osg::ArgumentParser arguments(&argc, argv);
+	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer(arguments);
 
 	viewer->setUpViewInWindow(100, 100, 800, 600);
 
@@ -215,38 +65,96 @@ int main(int argc, char** argv)
 	viewer->getWindows(windows);
 	windows[0]->setWindowName("OpenSceneGraph Instancing Example");
 
-	// get context to determine max number of uniforms in vertex shader
+	// get context to determine max number of uniforms in vertex shader, load the terrain and setup the instanced geometry builder
 	osgViewer::ViewerBase::Contexts contexts;
 	viewer->getContexts(contexts);
-	GLint maxNumUniforms = 0;
-	GLint maxUniformBlockSize = 0;
-	initOpenGL(contexts[0], maxNumUniforms, maxUniformBlockSize);
-	//contexts[0]->getState()->setUseModelViewAndProjectionUniforms(true);
-
-	// we need to reserve some space for modelViewMatrix, projectionMatrix, modelViewProjectionMatrix and normalMatrix, we also need 16 float uniforms per matrix
-	unsigned int maxInstanceMatrices = (maxNumUniforms-64) / 16;
-
-	// load elevation model from asc
-	g_fileLoader.loadFromFile("../data/crater.asc");
+	g_scene = new osgExample::InstancingScene;
+	g_scene->initialize(contexts[0], arguments);
+	// instance counts, draw calls and uploads of every frame go into the viewer stats next to the frame times
+	osg::ref_ptr<osgExample::InstanceStatistics> statistics = new osgExample::InstanceStatistics(viewer->getViewerStats());
+	g_scene->getBuilder()->setStatistics(statistics);
+	// the gpu time of every chunk draw goes into the same stats
+	g_scene->getBuilder()->setGpuTimer(new osgExample::GpuTimer(statistics));
 
 	// create scene
-	g_builder = new osgExample::InstancedGeometryBuilder(maxInstanceMatrices, maxUniformBlockSize);
-	osg::ref_ptr<osg::Switch> scene = setupScene(64, 64);
+	g_fixedSeed = arguments.read("--seed", g_seed);
+	osg::ref_ptr<osg::Switch> scene = setupScene(64, 64, NULL);
 	viewer->setSceneData(scene);
 
+	std::string techniqueName;
+	if (arguments.read("--technique", techniqueName))
+	{
+		unsigned int technique = osgExample::InstancingScene::findTechnique(techniqueName);
+		if (technique < osgExample::InstancingScene::getNumTechniques())
+			osgExample::InstancingScene::selectTechnique(scene, technique);
+		else
+			std::cout << "Unknown technique " << techniqueName << std::endl;
+	}
+
+	// rebuilt scenes are compiled over several frames and swapped in once they are complete,
+	// every frame spends at least the given budget(in milliseconds) on compiling
+	double compileBudget = 4.0;
+	arguments.read("--compile-budget", compileBudget);
+	osg::ref_ptr<osgUtil::IncrementalCompileOperation> compileOperation = new osgUtil::IncrementalCompileOperation;
+	compileOperation->setTargetFrameRate(60.0);
+	compileOperation->setMinimumTimeAvailableForGLCompileAndDeletePerFrame(compileBudget / 1000.0);
+	viewer->setIncrementalCompileOperation(compileOperation);
+
 	 // add the state manipulator
     viewer->addEventHandler(new osgGA::StateSetManipulator(viewer->getCamera()->getOrCreateStateSet()));
 
 	// add the stats handler
-    viewer->addEventHandler(new osgViewer::StatsHandler);
+	osg::ref_ptr<osgViewer::StatsHandler> statsHandler = new osgViewer::StatsHandler;
+	osgExample::InstanceStatistics::addStatsLines(*statsHandler);
+    viewer->addEventHandler(statsHandler);
 	viewer->addEventHandler(new osgExample::SwitchInstancingHandler(viewer, scene, setupScene));
+	viewer->addEventHandler(new osgExample::MemoryUsageHandler(viewer, g_scene));
+
+	// z starts and stops recording the camera path, Z plays it back
+	std::string cameraPathFile = "camera.path";
+	arguments.read("--record-path", cameraPathFile);
+	viewer->addEventHandler(new osgViewer::RecordCameraPathHandler(cameraPathFile));
+
+	// replay a recorded path with a fixed time step per frame instead of the interactive navigation
+	std::string replayFile;
+	if (arguments.read("--replay", replayFile))
+	{
+		osg::ref_ptr<osgExample::CameraPathReplay> replay = new osgExample::CameraPathReplay;
+		if (!replay->load(replayFile))
+			return 1;
+
+		double frameStep = replay->getFrameStep();
+		arguments.read("--frame-step", frameStep);
+		replay->setFrameStep(frameStep);
+		std::string timingFile = "replay_timing.csv";
+		arguments.read("--timing", timingFile);
+
+		replay->run(*viewer);
+		replay->printSummary();
+		if (!replay->writeTiming(timingFile))
+			std::cout << "Error could not write " << timingFile << std::endl;
+		return 0;
+	}
 
 	// print usage
 	std::cout << "OpenSceneraph Instancing Example" << std::endl;
 	std::cout << "================================" << std::endl << std::endl;
-	std::cout << "Switch between instancing techniques: 1, 2, 3, 4, 5" << std::endl;
+	std::cout << "Switch between instancing techniques: 1, 2, 3, 4, 5, 6, 7, 8, 9, 0" << std::endl;
+	std::cout << "Switch to geometry shader point expansion: p" << std::endl;
+	std::cout << "Switch to vertex pulling from shared buffers: v" << std::endl;
+	std::cout << "Switch to procedural instances generated in the vertex shader: g" << std::endl;
+	std::cout << "Switch to instances placed with transform feedback: f" << std::endl;
 	std::cout << "Increase/decrease scene complexety: +/-" << std::endl;
 	std::cout << "Cycle through different status informations(FPS and other stats): s" << std::endl;
+	std::cout << "Print the memory of the current technique by subsystem: m" << std::endl;
+	std::cout << "Start with --dynamic to animate the vertex attribute instances every frame" << std::endl;
+	std::cout << "Start with --wind-gust to animate a band of the vertex attribute instances and upload only its range" << std::endl;
+	std::cout << "Start with --compile-budget <ms> to set the time spent compiling rebuilt scenes per frame" << std::endl;
+	std::cout << "Start with --cpu-placement to place the instances on the cpu instead of with transform feedback" << std::endl;
+	std::cout << "Start with --static-batch-cells <n> and --static-batch-memory <MB> to configure the static batching grid" << std::endl;
+	std::cout << "Start/stop recording the camera path to camera.path(or --record-path <file>): z" << std::endl;
+	std::cout << "Start with --seed <n> for the same instances in every run and --technique <name> to pick the first technique" << std::endl;
+	std::cout << "Start with --replay <file> [--frame-step <s>] [--timing <csv>] to fly along a recorded path and write the frame times" << std::endl;
 
 	return viewer->run();
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+// Checks the memory figures against real allocations: the AllocationCounter measures the bytes generateInstances
+// allocates, which is all the instance store the builder reports plus the array object and the first row of an
+// instance array that grew. A scene also keeps its figures while the builder already holds the instances of the
+// next one. Runs from the source directory like ctest starts it, it returns non zero if a check fails.
+
+// c-std
+#include <vector>
+#include <iostream>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Switch>
+#include <osg/Array>
+#include <osg/ArgumentParser>
+
+// osgExample
+#include "InstancingScene.h"
+#include "InstancedGeometryBuilder.h"
+#include "MemoryUsage.h"
+#include "AllocationCounter.h"
+
+namespace
+{
+
+// bookkeeping of the array object beyond its own size, e.g. a mutex of the reference count
+const size_t MAX_UNREPORTED_BYTES = 256u;
+
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+	unsigned int size = 64;
+	arguments.read("--size", size);
+	unsigned int seed = 1;
+	arguments.read("--seed", seed);
+
+	osg::ref_ptr<osgExample::InstancingScene> scene = new osgExample::InstancingScene;
+	scene->initialize(arguments);
+	osg::ref_ptr<osgExample::InstancedGeometryBuilder> builder = scene->getBuilder();
+
+	// an empty builder holds one row of the instance texture, generateInstances starts with a new one and
+	// reserves the rows it needs, which frees that first row again if more than one is needed
+	size_t rowBytes = builder->getInstanceData()->getTotalDataSize();
+
+	osgExample::AllocationCounter::start();
+	bool generated = scene->generateInstances(size, size, seed, NULL);
+	osgExample::AllocationCounter::stop();
+	size_t allocatedBytes = osgExample::AllocationCounter::getNumBytes();
+	if (!generated)
+	{
+		std::cerr << "The instances could not be generated" << std::endl;
+		return 1;
+	}
+
+	osgExample::MemoryUsage builderUsage;
+	builder->computeMemoryUsage(builderUsage);
+	size_t reportedBytes = builderUsage.getCpuBytes(osgExample::MemoryUsage::INSTANCE_STORE);
+	size_t unreportedBytes = sizeof(osg::FloatArray);
+	if (builder->getInstanceData()->getTotalDataSize() > rowBytes)
+		unreportedBytes += rowBytes;
+
+	int result = 0;
+	std::cout << "instance store: " << reportedBytes << " bytes reported, " << allocatedBytes << " allocated for "
+			  << size * size << " instances" << std::endl;
+	if (allocatedBytes < reportedBytes + unreportedBytes || allocatedBytes > reportedBytes + unreportedBytes + MAX_UNREPORTED_BYTES)
+	{
+		std::cerr << "The instance store reports " << reportedBytes << " bytes, but generateInstances allocated "
+				  << allocatedBytes << " of which " << unreportedBytes << " are not part of it" << std::endl;
+		result = 1;
+	}
+
+	// the builder starts on the next scene while the current one is shown, its figures stay with the switch
+	osg::ref_ptr<osg::Switch> switchNode = scene->createScene(size, size, seed, NULL);
+	if (!switchNode.valid())
+	{
+		std::cerr << "The scene could not be created" << std::endl;
+		return 1;
+	}
+
+	std::vector<osgExample::MemoryUsage> sceneUsage(osgExample::InstancingScene::getNumTechniques());
+	for (unsigned int i = 0; i < sceneUsage.size(); ++i)
+	{
+		scene->computeMemoryUsage(switchNode, i, sceneUsage[i]);
+	}
+
+	scene->generateInstances(size * 2, size * 2, seed + 1, NULL);
+	for (unsigned int i = 0; i < sceneUsage.size(); ++i)
+	{
+		osgExample::MemoryUsage usage;
+		scene->computeMemoryUsage(switchNode, i, usage);
+		std::cout << osgExample::InstancingScene::getTechniqueName(i) << ": " << usage.getTotalCpuBytes() << " bytes during a rebuild, "
+				  << sceneUsage[i].getTotalCpuBytes() << " before" << std::endl;
+		if (usage.getTotalCpuBytes() != sceneUsage[i].getTotalCpuBytes())
+		{
+			std::cerr << "The figures of the " << osgExample::InstancingScene::getTechniqueName(i) << " technique change with the next scene" << std::endl;
+			result = 1;
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,268 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Times the cpu hot paths of the example without a graphics context: loading the terrain, the height lookups,
+// the matrix generation, the bounding box computations and the scene graph setup of every technique.
+// Run it from the bin directory like the example, it prints the fastest of all repetitions in milliseconds.
+
+// c-std
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Timer>
+#include <osg/Uniform>
+#include <osg/Geometry>
+
+// osgExample
+#include "InstancingScene.h"
+#include "ASCFileLoader.h"
+#include "ComputeInstanceBoundingBoxCallback.h"
+#include "ComputeTextureBoundingBoxCallback.h"
+#include "InstancedDrawable.h"
+#include "MemoryUsage.h"
+#include "ComputeMemoryUsageVisitor.h"
+
+// keeps the fastest of several runs, the others include page faults, cache misses and other noise
+class RepetitionTimer
+{
+public:
+	RepetitionTimer()
+		:	m_startTick(0),
+			m_minimum(-1.0)
+	{
+	}
+
+	inline void start() { m_startTick = osg::Timer::instance()->tick(); }
+	inline void stop()
+	{
+		double time = osg::Timer::instance()->delta_m(m_startTick, osg::Timer::instance()->tick());
+		m_minimum = m_minimum < 0.0 ? time : std::min(m_minimum, time);
+	}
+
+	inline double getMinimum() const { return m_minimum; }
+private:
+	osg::Timer_t	m_startTick;
+	double			m_minimum;
+};
+
+struct MicrobenchmarkResult
+{
+	std::string		name;
+	unsigned int	instances;
+	double			time;
+};
+
+std::vector<MicrobenchmarkResult> g_results;
+
+void report(const std::string& name, unsigned int instances, const RepetitionTimer& timer)
+{
+	MicrobenchmarkResult result;
+	result.name = name;
+	result.instances = instances;
+	result.time = timer.getMinimum();
+	g_results.push_back(result);
+
+	std::cout << std::left << std::setw(48) << name << std::right << std::setw(10) << instances
+			  << std::setw(14) << std::fixed << std::setprecision(3) << result.time << " ms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+	if (arguments.read("--help"))
+	{
+		std::cout << "OpenSceneGraph Instancing Microbenchmark" << std::endl;
+		std::cout << "========================================" << std::endl << std::endl;
+		std::cout << "--size <n>          adds a scene of n x n instances, may be repeated, 64 up to 1024 by default" << std::endl;
+		std::cout << "--repetitions <n>   runs of every measurement, the fastest counts, 3 by default" << std::endl;
+		std::cout << "--seed <n>          random seed of the instances, 1 by default" << std::endl;
+		std::cout << "--csv <file>        also writes the results to a csv file" << std::endl;
+		std::cout << "--memory            prints the cpu memory of every technique node, gl objects need a context" << std::endl;
+		return 0;
+	}
+
+	std::vector<unsigned int> sizes;
+	unsigned int size = 0;
+	while (arguments.read("--size", size))
+		sizes.push_back(size);
+	if (sizes.empty())
+	{
+		// 4K up to 1M instances
+		for (size = 64; size <= 1024; size *= 2)
+			sizes.push_back(size);
+	}
+	unsigned int repetitions = 3;
+	arguments.read("--repetitions", repetitions);
+	repetitions = std::max(repetitions, 1u);
+	unsigned int seed = 1;
+	arguments.read("--seed", seed);
+	std::string csvFile;
+	arguments.read("--csv", csvFile);
+	bool printMemory = arguments.read("--memory");
+
+	{
+		RepetitionTimer timer;
+		for (unsigned int i = 0; i < repetitions; ++i)
+		{
+			osgExample::ASCFileLoader fileLoader;
+			timer.start();
+			fileLoader.loadFromFile("../data/crater.asc");
+			timer.stop();
+		}
+		report("ASCFileLoader::loadFromFile", 0, timer);
+	}
+
+	osg::ref_ptr<osgExample::InstancingScene> scene = new osgExample::InstancingScene;
+	scene->initialize(arguments);
+	osg::ref_ptr<osgExample::InstancedGeometryBuilder> builder = scene->getBuilder();
+	const osgExample::ASCFileLoader& fileLoader = scene->getFileLoader();
+
+	for (std::vector<unsigned int>::const_iterator itr = sizes.begin(); itr != sizes.end(); ++itr)
+	{
+		unsigned int x = *itr;
+		unsigned int y = *itr;
+		unsigned int numInstances = x * y;
+
+		{
+			// scattered over the whole terrain like the instances
+			RepetitionTimer timer;
+			float sum = 0.0f;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				float stepX = (float)fileLoader.getWidth() / (float)x;
+				float stepY = (float)fileLoader.getHeight() / (float)y;
+				timer.start();
+				for (unsigned int j = 0; j < x; ++j)
+				{
+					for (unsigned int k = 0; k < y; ++k)
+						sum += fileLoader.getNearestHeight(j * stepX + (k % 100) * 0.02f, k * stepY + (j % 100) * 0.02f);
+				}
+				timer.stop();
+			}
+			report("ASCFileLoader::getNearestHeight", numInstances, timer);
+			// keeps the compiler from dropping the lookups
+			if (sum == -1.0f)
+				std::cout << sum << std::endl;
+		}
+
+		{
+			RepetitionTimer timer;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				timer.start();
+				scene->generateInstances(x, y, seed, NULL);
+				timer.stop();
+			}
+			report("InstancingScene::generateInstances", numInstances, timer);
+		}
+
+		builder->setGeometry(osgExample::InstancingScene::createQuads());
+		osg::ref_ptr<osg::Geometry> geometry = builder->getGeometry();
+		std::vector<osg::Matrixd> matrices(numInstances);
+		for (unsigned int i = 0; i < numInstances; ++i)
+			matrices[i] = builder->getMatrix(i);
+
+		{
+			osg::ref_ptr<osg::Uniform> instanceMatrices = new osg::Uniform(osg::Uniform::FLOAT_MAT4, "instanceModelMatrix", numInstances);
+			for (unsigned int i = 0; i < numInstances; ++i)
+				instanceMatrices->setElement(i, osg::Matrixf(matrices[i]));
+
+			// a new callback every time, otherwise only the cached bound is returned
+			RepetitionTimer timer;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				osg::ref_ptr<osgExample::ComputeInstancedBoundingBoxCallback> callback = new osgExample::ComputeInstancedBoundingBoxCallback(instanceMatrices);
+				timer.start();
+				callback->computeBound(*geometry);
+				timer.stop();
+			}
+			report("ComputeInstancedBoundingBoxCallback::computeBound", numInstances, timer);
+		}
+
+		{
+			RepetitionTimer timer;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				osg::ref_ptr<osgExample::ComputeTextureBoundingBoxCallback> callback = new osgExample::ComputeTextureBoundingBoxCallback(builder->getInstanceData(), 0u, numInstances);
+				timer.start();
+				callback->computeBound(*geometry);
+				timer.stop();
+			}
+			report("ComputeTextureBoundingBoxCallback::computeBound", numInstances, timer);
+		}
+
+		{
+			RepetitionTimer timer;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				osg::ref_ptr<osgExample::InstancedDrawable> drawable = new osgExample::InstancedDrawable;
+				drawable->setVertexArray(dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray()));
+				drawable->setInstances(numInstances, builder->getInstanceData());
+				timer.start();
+				drawable->computeBound();
+				timer.stop();
+			}
+			report("InstancedDrawable::computeBound", numInstances, timer);
+		}
+
+		// the scene graph of every technique, the gl objects are created on the first draw and not part of it
+		for (unsigned int technique = 0; technique < osgExample::InstancingScene::getNumTechniques(); ++technique)
+		{
+			RepetitionTimer timer;
+			osg::ref_ptr<osg::Node> node;
+			for (unsigned int i = 0; i < repetitions; ++i)
+			{
+				timer.start();
+				node = scene->createTechniqueNode(technique, x, y, seed);
+				timer.stop();
+			}
+			report(std::string("createTechniqueNode ") + osgExample::InstancingScene::getTechniqueName(technique), numInstances, timer);
+
+			if (printMemory)
+			{
+				osgExample::MemoryUsage usage;
+				scene->getBuilder()->computeMemoryUsage(usage);
+				osgExample::ComputeMemoryUsageVisitor visitor(usage);
+				node->accept(visitor);
+				std::cout << "Memory of " << osgExample::InstancingScene::getTechniqueName(technique) << " with " << numInstances << " instances" << std::endl;
+				usage.print(std::cout);
+			}
+		}
+	}
+
+	if (!csvFile.empty())
+	{
+		std::ofstream file(csvFile.c_str());
+		file << "name,instances,ms" << std::endl;
+		for (std::vector<MicrobenchmarkResult>::const_iterator itr = g_results.begin(); itr != g_results.end(); ++itr)
+			file << itr->name << "," << itr->instances << "," << itr->time << std::endl;
+	}
+
+	return 0;
+}
\ No newline at end of file
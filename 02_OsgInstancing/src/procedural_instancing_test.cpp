@@ -0,0 +1,278 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+// glew
+#include <GL/glew.h>
+
+// Renders a few procedural instances with transform feedback and compares the matrices generated by
+// procedural_instancing.vert with ProceduralInstanceGenerator::computeMatrix. The shader multiplies the four
+// unit vectors with the instance matrix and an identity model view projection matrix, so the captured
+// positions are its columns. The fixed point grid position, the height, the yaw step, the scale and the texture
+// layer have to match exactly, only the sway goes through the approximate sin of the gpu and is allowed a few
+// ulps. Uses a pbuffer like the benchmark and runs from the bin directory, it returns non zero if an instance
+// differs.
+
+// c-std
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// osg
+#include <osg/ref_ptr>
+#include <osg/Matrixd>
+#include <osg/GraphicsContext>
+#include <osg/ArgumentParser>
+
+// osgExample
+#include "InstancingScene.h"
+#include "ProceduralInstanceGenerator.h"
+#include "InstancedGeometryBuilder.h"
+#include "InstanceBounds.h"
+
+namespace
+{
+
+// the sway is measured in ulps of the instance scale, the column it moves is at most that large
+const float MAX_SWAY_ULPS = 4.0f;
+
+// every vertex captures its position and the texture layer
+const unsigned int CAPTURED_FLOATS = 5;
+
+float getUlp(float value)
+{
+	value = fabsf(value);
+	return nextafterf(value, FLT_MAX) - value;
+}
+
+// returns the yaw step whose scaled sine and cosine are the given column, NUM_YAW_STEPS if there is none
+unsigned int findYawStep(const osg::Vec2* yawTable, float scale, float scaledCos, float scaledSin)
+{
+	for (unsigned int i = 0; i < osgExample::ProceduralInstanceGenerator::NUM_YAW_STEPS; ++i)
+	{
+		if (yawTable[i].x() * scale == scaledCos && yawTable[i].y() * scale == scaledSin)
+			return i;
+	}
+
+	return osgExample::ProceduralInstanceGenerator::NUM_YAW_STEPS;
+}
+
+GLuint createProgram(const std::string& source)
+{
+	GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+	const char* sourcePtr = source.c_str();
+	glShaderSource(shader, 1, &sourcePtr, NULL);
+	glCompileShader(shader);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	const char* varyings[] = { "gl_Position", "textureLayer" };
+	glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[4096];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cerr << "Could not link the procedural instancing shader" << std::endl << log << std::endl;
+		glDeleteProgram(program);
+		return 0u;
+	}
+
+	return program;
+}
+
+// renders numInstances instances of the four unit vectors and returns the captured positions and layers
+std::vector<float> captureColumns(GLuint program, const osgExample::ProceduralInstanceGenerator& generator, unsigned int numInstances)
+{
+	GLuint heightTexture = 0u;
+	glGenTextures(1, &heightTexture);
+	glBindTexture(GL_TEXTURE_RECTANGLE, heightTexture);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R32F, generator.getHeightMapWidth(), generator.getHeightMapHeight(), 0, GL_RED, GL_FLOAT, generator.getHeightMap());
+
+	osg::Matrixf identity;
+	const GLfloat normalMatrix[] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	glUseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "hashedSeed"), osgExample::ProceduralInstanceGenerator::hash(generator.getSeed()));
+	glUniform1ui(glGetUniformLocation(program, "gridHeight"), generator.getGridHeight());
+	glUniform1ui(glGetUniformLocation(program, "gridStepX"), generator.getStepX());
+	glUniform1ui(glGetUniformLocation(program, "gridStepY"), generator.getStepY());
+	glUniform1ui(glGetUniformLocation(program, "numTextureLayers"), generator.getNumTextureLayers());
+	glUniform2fv(glGetUniformLocation(program, "yawTable"), osgExample::ProceduralInstanceGenerator::NUM_YAW_STEPS, generator.getYawTable()[0].ptr());
+	glUniform1i(glGetUniformLocation(program, "heightMap"), 0);
+	glUniform1f(glGetUniformLocation(program, "osg_SimulationTime"), 0.0f);
+	glUniformMatrix4fv(glGetUniformLocation(program, "osg_ModelViewProjectionMatrix"), 1, GL_FALSE, identity.ptr());
+	glUniformMatrix3fv(glGetUniformLocation(program, "osg_NormalMatrix"), 1, GL_FALSE, normalMatrix);
+
+	// the unit vectors, the last one is the origin
+	const GLfloat vertices[] = { 1.0f, 0.0f, 0.0f, 0.0f,
+								 0.0f, 1.0f, 0.0f, 0.0f,
+								 0.0f, 0.0f, 1.0f, 0.0f,
+								 0.0f, 0.0f, 0.0f, 1.0f };
+	GLuint buffers[] = { 0u, 0u };
+	GLuint vao = 0u;
+	glGenBuffers(2, buffers);
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+	// instances are captured one after the other, every one with its four vertices
+	std::vector<float> columns(numInstances * 4 * CAPTURED_FLOATS);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, buffers[1]);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, columns.size() * sizeof(float), NULL, GL_STATIC_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1]);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArraysInstanced(GL_POINTS, 0, 4, numInstances);
+	glEndTransformFeedback();
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, columns.size() * sizeof(float), &columns.front());
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(2, buffers);
+	glDeleteTextures(1, &heightTexture);
+
+	return columns;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+	unsigned int size = 16;
+	arguments.read("--size", size);
+	unsigned int seed = 1;
+	arguments.read("--seed", seed);
+
+	osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+	traits->readDISPLAY();
+	traits->setUndefinedScreenDetailsToDefaultScreen();
+	traits->width = 64;
+	traits->height = 64;
+	traits->windowDecoration = false;
+	traits->doubleBuffer = false;
+	traits->pbuffer = true;
+	osg::ref_ptr<osg::GraphicsContext> context = osg::GraphicsContext::createGraphicsContext(traits);
+	if (!context.valid())
+	{
+		std::cerr << "Could not create a pbuffer, is DISPLAY set to a running X server(e.g. Xvfb)?" << std::endl;
+		return 1;
+	}
+
+	// loads the terrain and initializes glew
+	osg::ref_ptr<osgExample::InstancingScene> scene = new osgExample::InstancingScene;
+	scene->initialize(context, arguments);
+	context->makeCurrent();
+
+	// the same source as the procedural technique, with the shared outputs and wind sway
+	std::stringstream preprocessorDefinition;
+	preprocessorDefinition << "#define NUM_YAW_STEPS " << osgExample::ProceduralInstanceGenerator::NUM_YAW_STEPS;
+	GLuint program = createProgram(osgExample::InstancedGeometryBuilder::readShaderSource("../shader/procedural_instancing.vert", preprocessorDefinition.str()));
+	if (!program)
+		return 1;
+
+	osgExample::ProceduralInstanceGenerator generator = scene->createGenerator(size, size, seed, false);
+	std::vector<float> columns = captureColumns(program, generator, generator.getNumInstances());
+	glDeleteProgram(program);
+	context->releaseContext();
+
+	unsigned int numFailed = 0u;
+	for (unsigned int instance = 0; instance < generator.getNumInstances(); ++instance)
+	{
+		// the rows of an osg matrix are the columns of the glsl one, the conversions to float are exact
+		osg::Matrixd expected = generator.computeMatrix(instance);
+		osgExample::InstanceAttributes attributes = generator.computeAttributes(instance);
+		const float* captured = &columns[instance * 4 * CAPTURED_FLOATS];
+		const float* capturedColumns[4];
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			capturedColumns[i] = captured + i * CAPTURED_FLOATS;
+		}
+
+		// both factors of the grid position are powers of two, so the fixed point values come back exactly
+		const float toFixedPoint = osgExample::ProceduralInstanceGenerator::FIXED_POINT_SCALE / 2.0f;
+		float scale = (float)expected(2, 2);
+		bool gridMatches = capturedColumns[3][0] * toFixedPoint == (float)expected(3, 0) * toFixedPoint &&
+						   capturedColumns[3][1] * toFixedPoint == (float)expected(3, 1) * toFixedPoint;
+		bool heightMatches = capturedColumns[3][2] == (float)expected(3, 2) && capturedColumns[3][3] == 1.0f;
+		bool scaleMatches = capturedColumns[2][2] == scale && capturedColumns[2][3] == 0.0f;
+
+		unsigned int yawStep = findYawStep(generator.getYawTable(), scale, (float)expected(0, 0), (float)expected(0, 1));
+		bool yawMatches = yawStep < osgExample::ProceduralInstanceGenerator::NUM_YAW_STEPS &&
+						  findYawStep(generator.getYawTable(), scale, capturedColumns[0][0], capturedColumns[0][1]) == yawStep &&
+						  capturedColumns[1][0] == (float)expected(1, 0) && capturedColumns[1][1] == (float)expected(1, 1);
+		for (unsigned int i = 0; i < 2; ++i)
+		{
+			yawMatches = yawMatches && capturedColumns[i][2] == 0.0f && capturedColumns[i][3] == 0.0f;
+		}
+
+		bool layerMatches = true;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			layerMatches = layerMatches && capturedColumns[i][4] == (float)attributes.textureLayer;
+		}
+
+		// the vertex sway of the shader moves the third unit vector
+		float sway = sinf(attributes.windPhase) * osgExample::InstanceBounds::WIND_SWAY;
+		float swayError = std::max(fabsf(capturedColumns[2][0] - sway * (float)expected(0, 0)), fabsf(capturedColumns[2][1] - sway * (float)expected(0, 1)));
+		bool swayMatches = swayError <= MAX_SWAY_ULPS * getUlp(scale);
+
+		if (!(gridMatches && heightMatches && scaleMatches && yawMatches && layerMatches && swayMatches))
+		{
+			if (numFailed < 10)
+			{
+				std::cerr << "Instance " << instance << " differs in"
+						  << (gridMatches ? "" : " grid position") << (heightMatches ? "" : " height")
+						  << (scaleMatches ? "" : " scale") << (yawMatches ? "" : " yaw step")
+						  << (layerMatches ? "" : " texture layer")
+						  << (swayMatches ? "" : " sway") << std::endl;
+			}
+			++numFailed;
+		}
+	}
+
+	std::cout << generator.getNumInstances() - numFailed << " of " << generator.getNumInstances() << " procedural instances match" << std::endl;
+
+	return numFailed ? 1 : 0;
+}
\ No newline at end of file
@@ -1,7 +1,15 @@
 #include <ctime>
+#include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #include <osg/ref_ptr>
 #include <osg/Switch>
@@ -15,6 +23,129 @@
 #include <osgDB/ReadFile>
 #include <osg/Light>
 #include <osg/LightSource>
+#include <osg/Timer>
+#include <osg/Stats>
+#include <osg/GraphicsContext>
+#include <osg/GLExtensions>
+#include <osg/buffered_value>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+// Milliseconds of the shadow pass in the viewer stats.
+const char* SHADOW_PASS_GPU_TIME = "Shadow pass GPU time taken";
+
+// Width and height of the depth texture, the benchmark reports it as its size.
+const int SHADOW_MAP_SIZE = 1024;
+
+// Measures the gpu time of a camera with GL_TIME_ELAPSED queries. Every context has two queries that take turns
+// frame by frame, the result of a query is read when its turn comes again two frames later, so reading it never
+// waits for the gpu. The result goes into the stats of the frame it was measured in.
+class GpuPassTimer : public osg::Referenced
+{
+public:
+	class BeginCallback : public osg::Camera::DrawCallback
+	{
+	public:
+		BeginCallback(GpuPassTimer* timer) : _timer(timer) {}
+		virtual void operator()(osg::RenderInfo& renderInfo) const { _timer->begin(renderInfo); }
+	private:
+		osg::ref_ptr<GpuPassTimer> _timer;
+	};
+
+	class EndCallback : public osg::Camera::DrawCallback
+	{
+	public:
+		EndCallback(GpuPassTimer* timer) : _timer(timer) {}
+		virtual void operator()(osg::RenderInfo& renderInfo) const { _timer->end(renderInfo); }
+	private:
+		osg::ref_ptr<GpuPassTimer> _timer;
+	};
+
+	GpuPassTimer(osg::Stats* stats, const std::string& attribute)
+		: _stats(stats), _attribute(attribute)
+	{
+	}
+
+	// Wraps the draw of the camera, nothing inside may use another GL_TIME_ELAPSED query.
+	void attach(osg::Camera* camera)
+	{
+		camera->setInitialDrawCallback(new BeginCallback(this));
+		camera->setFinalDrawCallback(new EndCallback(this));
+	}
+
+	void begin(osg::RenderInfo& renderInfo)
+	{
+		osg::State* state = renderInfo.getState();
+		osg::GLExtensions* extensions = state->get<osg::GLExtensions>();
+		if (!extensions->isARBTimerQuerySupported || !state->getFrameStamp())
+			return;
+
+		unsigned int frameNumber = state->getFrameStamp()->getFrameNumber();
+		Query& query = _queries[renderInfo.getContextID()].queries[frameNumber % 2];
+		if (!query.id)
+			extensions->glGenQueries(1, &query.id);
+
+		// The previous result of this query is two frames old.
+		if (query.pending)
+		{
+			GLint available = 0;
+			extensions->glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint64 nanoseconds = 0;
+				extensions->glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+				_stats->setAttribute(query.frameNumber, _attribute, nanoseconds / 1000000.0);
+			}
+		}
+
+		extensions->glBeginQuery(GL_TIME_ELAPSED, query.id);
+		query.frameNumber = frameNumber;
+		query.pending = false;
+		_queries[renderInfo.getContextID()].active = true;
+	}
+
+	void end(osg::RenderInfo& renderInfo)
+	{
+		osg::State* state = renderInfo.getState();
+		ContextQueries& contextQueries = _queries[renderInfo.getContextID()];
+		if (!contextQueries.active || !state->getFrameStamp())
+			return;
+
+		state->get<osg::GLExtensions>()->glEndQuery(GL_TIME_ELAPSED);
+		contextQueries.queries[state->getFrameStamp()->getFrameNumber() % 2].pending = true;
+		contextQueries.active = false;
+	}
+
+private:
+	struct Query
+	{
+		Query() : id(0), frameNumber(0), pending(false) {}
+
+		GLuint			id;
+		unsigned int	frameNumber;
+		bool			pending;
+	};
+
+	struct ContextQueries
+	{
+		ContextQueries() : active(false) {}
+
+		Query	queries[2];
+		bool	active;
+	};
+
+	osg::ref_ptr<osg::Stats>				_stats;
+	std::string								_attribute;
+	osg::buffered_object<ContextQueries>	_queries;
+};
 
 osg::ref_ptr<osg::Geometry> createQuads()
 {
@@ -51,14 +182,15 @@ osg::ref_ptr<osg::Geometry> createQuads()
 	return geometry;
 }
 
-int main(int argc, char** argv)
+// The shadow pass is timed on the gpu if stats are given.
+osg::ref_ptr<osg::Group> createScene(osg::Stats* stats)
 {
 	// Cow.
 	osg::ref_ptr<osg::Node> cow = osgDB::readNodeFile("data/cow.osg");
 	osg::BoundingSphere bs = cow->getBound();
 	// Depth texture.
 	osg::ref_ptr<osg::Texture2D> depthTexture = new osg::Texture2D;
-	depthTexture->setTextureSize(1024, 1024);
+	depthTexture->setTextureSize(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
 	depthTexture->setInternalFormat(GL_RGBA16F);
 	depthTexture->setSourceType(GL_FLOAT);
 	depthTexture->setSourceFormat(GL_RGBA);
@@ -73,7 +205,7 @@ int main(int argc, char** argv)
 	shadowPassCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
 	shadowPassCamera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
 	shadowPassCamera->setRenderOrder(osg::Camera::PRE_RENDER);
-	shadowPassCamera->setViewport(0, 0, 1024, 1024);
+	shadowPassCamera->setViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
 	osg::Matrixf projectionMatrix = osg::Matrixf::ortho(-bs.radius(),
                                                         bs.radius(),
                                                         -bs.radius(),
@@ -88,6 +220,11 @@ int main(int argc, char** argv)
 	shadowPassCamera->setViewMatrix(viewMatrix);
 	shadowPassCamera->attach(osg::Camera::COLOR_BUFFER, depthTexture);
 	shadowPassCamera->addChild(cow);
+	if (stats)
+	{
+		osg::ref_ptr<GpuPassTimer> shadowPassTimer = new GpuPassTimer(stats, SHADOW_PASS_GPU_TIME);
+		shadowPassTimer->attach(shadowPassCamera);
+	}
 	osg::Matrixf shadowMatrix = viewMatrix *
                                 projectionMatrix *
                                 osg::Matrixf::translate(1.0, 1.0, 1.0) *
@@ -129,9 +266,196 @@ int main(int argc, char** argv)
 	scene->addChild(cow);
 	scene->addChild(shadowPassCamera);
 	scene->getOrCreateStateSet()->addUniform(new osg::Uniform("lightDir", lightDirection));
+	return scene;
+}
+
+// Resident set size of the process, only available on linux.
+size_t getResidentMemory()
+{
+#ifdef __linux__
+	size_t residentPages = 0;
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file)
+	{
+		unsigned long size = 0, resident = 0;
+		if (fscanf(file, "%lu %lu", &size, &resident) == 2)
+			residentPages = resident;
+		fclose(file);
+	}
+	// /proc/self/statm counts pages, which aren't 4 KB on every system.
+	return residentPages * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+double getMedian(std::vector<double> values)
+{
+	if (values.empty())
+		return -1.0;
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+}
+
+// Median absolute deviation, unlike the range it ignores a single outlier.
+double getMedianDeviation(const std::vector<double>& values)
+{
+	if (values.empty())
+		return 0.0;
+	double median = getMedian(values);
+	std::vector<double> deviations;
+	for (std::vector<double>::const_iterator itr = values.begin(); itr != values.end(); ++itr)
+		deviations.push_back(fabs(*itr - median));
+	return getMedian(deviations);
+}
+
+// Average of a stats attribute in milliseconds, -1 if it was never recorded.
+double getAveragedMilliseconds(osg::Stats* stats, unsigned int startFrame, unsigned int endFrame, const std::string& attribute)
+{
+	double value = 0.0;
+	if (!stats->getAveragedAttribute(startFrame, endFrame, attribute, value))
+		return -1.0;
+	return value * 1000.0;
+}
+
+// Renders the scene offscreen and writes the median timings of all repetitions in the format
+// of the instancing benchmark, so both can be compared against a baseline with PerfCompare.
+int runBenchmark(osg::ArgumentParser& arguments, const std::string& output)
+{
+	unsigned int numFrames = 100;
+	arguments.read("--frames", numFrames);
+	unsigned int numWarmupFrames = 20;
+	arguments.read("--warmup", numWarmupFrames);
+	unsigned int numRepetitions = 3;
+	arguments.read("--repetitions", numRepetitions);
+	numRepetitions = std::max(numRepetitions, 1u);
+	unsigned int width = 1280;
+	unsigned int height = 720;
+	arguments.read("--width", width);
+	arguments.read("--height", height);
+
+	// Offscreen context.
+	osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+	traits->readDISPLAY();
+	traits->setUndefinedScreenDetailsToDefaultScreen();
+	traits->x = 0;
+	traits->y = 0;
+	traits->width = width;
+	traits->height = height;
+	traits->windowDecoration = false;
+	traits->doubleBuffer = false;
+	traits->pbuffer = true;
+	osg::ref_ptr<osg::GraphicsContext> context = osg::GraphicsContext::createGraphicsContext(traits);
+	if (!context.valid())
+	{
+		std::cerr << "Could not create a pbuffer, is DISPLAY set to a running X server(e.g. Xvfb)?" << std::endl;
+		return 1;
+	}
+
 	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer;
-	viewer->setUpViewInWindow(100, 100, 800, 600);
+	viewer->setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+	// Scene setup, repeated like the frames.
+	osg::ref_ptr<osg::Group> scene;
+	std::vector<double> rebuildTimes;
+	for (unsigned int i = 0; i < numRepetitions; ++i)
+	{
+		osg::Timer_t startTick = osg::Timer::instance()->tick();
+		scene = createScene(viewer->getViewerStats());
+		rebuildTimes.push_back(osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick()));
+	}
+
+	osg::Camera* camera = viewer->getCamera();
+	camera->setGraphicsContext(context);
+	camera->setViewport(0, 0, width, height);
+	camera->setProjectionMatrixAsPerspective(30.0, (double)width / (double)height, 1.0, 10000.0);
+	camera->setDrawBuffer(GL_FRONT);
+	camera->setReadBuffer(GL_FRONT);
 	viewer->setSceneData(scene);
+	viewer->realize();
+
+	// The same view of the whole scene in every run.
+	const osg::BoundingSphere& bound = scene->getBound();
+	camera->setViewMatrixAsLookAt(bound.center() + osg::Vec3(0.0f, -2.0f, 1.0f) * bound.radius(), bound.center(), osg::Vec3(0.0f, 0.0f, 1.0f));
+
+	// Keep the stats of all measured frames, gpu timer queries lag a few frames behind.
+	const unsigned int numLagFrames = 4;
+	if (!camera->getStats())
+		camera->setStats(new osg::Stats("Camera"));
+	osg::Stats* stats = camera->getStats();
+	stats->allocate(numFrames + numLagFrames + 1);
+	stats->collectStats("rendering", true);
+	stats->collectStats("gpu", true);
+	viewer->getViewerStats()->allocate(numFrames + numLagFrames + 1);
+
+	for (unsigned int i = 0; i < numWarmupFrames; ++i)
+		viewer->frame();
+
+	std::vector<double> frameTimes, cullTimes, drawTimes, gpuTimes, shadowPassTimes, residentMemories;
+	for (unsigned int repetition = 0; repetition < numRepetitions; ++repetition)
+	{
+		unsigned int startFrame = viewer->getFrameStamp()->getFrameNumber() + 1;
+		osg::Timer_t startTick = osg::Timer::instance()->tick();
+		for (unsigned int i = 0; i < numFrames; ++i)
+			viewer->frame();
+		osg::Timer_t endTick = osg::Timer::instance()->tick();
+		unsigned int endFrame = viewer->getFrameStamp()->getFrameNumber();
+		for (unsigned int i = 0; i < numLagFrames; ++i)
+			viewer->frame();
+
+		frameTimes.push_back(osg::Timer::instance()->delta_m(startTick, endTick) / std::max(numFrames, 1u));
+		cullTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "Cull traversal time taken"));
+		drawTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "Draw traversal time taken"));
+		gpuTimes.push_back(getAveragedMilliseconds(stats, startFrame, endFrame, "GPU draw time taken"));
+		// The timer queries of the shadow pass are in milliseconds already.
+		double shadowPassTime = -1.0;
+		viewer->getViewerStats()->getAveragedAttribute(startFrame, endFrame, SHADOW_PASS_GPU_TIME, shadowPassTime);
+		shadowPassTimes.push_back(shadowPassTime);
+		residentMemories.push_back((double)getResidentMemory());
+	}
+
+	// Size is the resolution of the shadow map, the scene has nothing random so there is no seed.
+	std::ofstream file((output + ".json").c_str());
+	file << "[" << std::endl;
+	file << "\t{ \"technique\": \"shadow_mapping\""
+		 << ", \"size\": " << SHADOW_MAP_SIZE
+		 << ", \"frame_ms\": " << getMedian(frameTimes)
+		 << ", \"cull_ms\": " << getMedian(cullTimes)
+		 << ", \"draw_ms\": " << getMedian(drawTimes)
+		 << ", \"gpu_ms\": " << getMedian(gpuTimes)
+		 << ", \"shadow_pass_gpu_ms\": " << getMedian(shadowPassTimes)
+		 << ", \"rebuild_ms\": " << getMedian(rebuildTimes)
+		 << ", \"frame_ms_mad\": " << getMedianDeviation(frameTimes)
+		 << ", \"rebuild_ms_mad\": " << getMedianDeviation(rebuildTimes)
+		 << ", \"repetitions\": " << numRepetitions
+		 << ", \"resident_bytes\": " << (size_t)getMedian(residentMemories)
+		 << ", \"resident_bytes_mad\": " << (size_t)getMedianDeviation(residentMemories)
+		 << " }" << std::endl;
+	file << "]" << std::endl;
+
+	std::cout << "Shadow mapping: " << getMedian(frameTimes) << " ms per frame, shadow pass gpu " << getMedian(shadowPassTimes)
+			  << " ms, setup " << getMedian(rebuildTimes) << " ms, wrote " << output << ".json" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	osg::ArgumentParser arguments(&argc, argv);
+
+	// Offscreen benchmark instead of the interactive viewer.
+	std::string output;
+	if (arguments.read("--benchmark", output))
+		return runBenchmark(arguments, output);
+
+	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer;
+	viewer->setUpViewInWindow(100, 100, 800, 600);
+	viewer->setSceneData(createScene(viewer->getViewerStats()));
+	// The stats overlay(key s) shows the gpu time of the shadow pass next to the one of the whole frame.
+	osg::ref_ptr<osgViewer::StatsHandler> statsHandler = new osgViewer::StatsHandler;
+	statsHandler->addUserStatsLine("Shadow pass GPU ms: ", osg::Vec4(1.0f, 1.0f, 0.5f, 1.0f), osg::Vec4(1.0f, 1.0f, 0.5f, 0.5f),
+								   SHADOW_PASS_GPU_TIME, 1.0, true, false, "", "", 0.0);
+	viewer->addEventHandler(statsHandler);
 	return viewer->run();
 }
 
@@ -0,0 +1,41 @@
+# Performance regression check shared by the examples. After including this file
+#
+#   add_perf_check(<benchmark target> <output option> <working directory> <default benchmark arguments>)
+#
+# adds make perf_baseline, which stores a run as the baseline of this machine, and make perf_check, which fails
+# if a new run regressed. The benchmark writes <file>.json when it gets "<output option> <file>". Once a baseline
+# exists, cmake also adds perf_check as a test, call enable_testing() before.
+
+set(PERF_CHECK_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+function(add_perf_check benchmark outputOption workingDirectory defaultArguments)
+	add_executable(PerfCompare ${PERF_CHECK_DIR}/perf_compare.cpp)
+
+	set(PERF_BASELINE "${CMAKE_CURRENT_BINARY_DIR}/perf_baseline.json" CACHE FILEPATH "Baseline of the performance regression check")
+	set(PERF_BENCHMARK_ARGS "${defaultArguments}" CACHE STRING "Arguments of the benchmark in the performance regression check")
+	set(PERF_COMPARE_ARGS "" CACHE STRING "Tolerances of the performance regression check, e.g. --frame-tolerance 0.1")
+	set(benchmarkArguments ${PERF_BENCHMARK_ARGS})
+	set(compareArguments ${PERF_COMPARE_ARGS})
+	separate_arguments(benchmarkArguments)
+	separate_arguments(compareArguments)
+	get_filename_component(baselineDir ${PERF_BASELINE} PATH)
+	get_filename_component(baselineName ${PERF_BASELINE} NAME_WE)
+
+	add_custom_target(perf_baseline
+		COMMAND ${benchmark} ${outputOption} ${baselineDir}/${baselineName} ${benchmarkArguments}
+		WORKING_DIRECTORY ${workingDirectory}
+		DEPENDS ${benchmark}
+		COMMENT "Recording the performance baseline ${PERF_BASELINE}")
+
+	add_custom_target(perf_check
+		COMMAND ${benchmark} ${outputOption} ${CMAKE_CURRENT_BINARY_DIR}/perf_run ${benchmarkArguments}
+		COMMAND PerfCompare ${PERF_BASELINE} ${CMAKE_CURRENT_BINARY_DIR}/perf_run.json ${compareArguments}
+		WORKING_DIRECTORY ${workingDirectory}
+		DEPENDS ${benchmark} PerfCompare
+		COMMENT "Comparing a benchmark run against ${PERF_BASELINE}")
+
+	# without a baseline there is nothing to compare against, re-run cmake after make perf_baseline
+	if(EXISTS ${PERF_BASELINE})
+		add_test(NAME perf_check COMMAND ${CMAKE_COMMAND} --build ${CMAKE_BINARY_DIR} --target perf_check)
+	endif(EXISTS ${PERF_BASELINE})
+endfunction(add_perf_check)
\ No newline at end of file
@@ -0,0 +1,343 @@
+/*
+	The MIT License (MIT)
+
+	Copyright (c) 2013 Marcel Pursche
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+// Compares a benchmark run against a stored baseline and fails if frame time, rebuild time or memory regressed.
+// Both files are the json arrays written by the benchmarks of the examples, one flat object per configuration.
+// A metric regresses if it exceeds baseline * (1 + tolerance) plus the noise of both runs, which is the larger
+// median absolute deviation of their repetitions times the noise factor. Unlike the spread between the slowest and
+// the fastest repetition, a single outlier doesn't widen it.
+
+// c-std
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+// one configuration of a benchmark run
+struct Result
+{
+	std::map<std::string, std::string>	strings;
+	std::map<std::string, double>		numbers;
+
+	double getNumber(const std::string& name, double defaultValue) const
+	{
+		std::map<std::string, double>::const_iterator itr = numbers.find(name);
+		return itr != numbers.end() ? itr->second : defaultValue;
+	}
+};
+
+typedef std::map<std::string, Result> Results;
+
+// metric that is gated and the tolerated relative increase
+struct Metric
+{
+	std::string	name;
+	std::string	deviation;
+	std::string	unit;
+	double		tolerance;
+};
+
+void skipWhitespace(const std::string& text, size_t& pos)
+{
+	while (pos < text.size() && isspace((unsigned char)text[pos]))
+		++pos;
+}
+
+bool parseString(const std::string& text, size_t& pos, std::string& value)
+{
+	if (pos >= text.size() || text[pos] != '"')
+		return false;
+
+	value.clear();
+	for (++pos; pos < text.size() && text[pos] != '"'; ++pos)
+	{
+		if (text[pos] == '\\' && pos + 1 < text.size())
+			++pos;
+		value += text[pos];
+	}
+	if (pos >= text.size())
+		return false;
+
+	++pos;
+	return true;
+}
+
+// only what the benchmarks write: an array of flat objects with string and number values
+bool parseResults(const std::string& text, const std::vector<std::string>& keys, Results& results, std::string& error)
+{
+	size_t pos = 0;
+	skipWhitespace(text, pos);
+	if (pos >= text.size() || text[pos] != '[')
+	{
+		error = "expected an array";
+		return false;
+	}
+	++pos;
+
+	for (;;)
+	{
+		skipWhitespace(text, pos);
+		if (pos < text.size() && text[pos] == ']')
+			return true;
+		if (pos >= text.size() || text[pos] != '{')
+		{
+			error = "expected an object";
+			return false;
+		}
+		++pos;
+
+		Result result;
+		for (;;)
+		{
+			skipWhitespace(text, pos);
+			if (pos < text.size() && text[pos] == '}')
+			{
+				++pos;
+				break;
+			}
+
+			std::string name;
+			if (!parseString(text, pos, name))
+			{
+				error = "expected a member name";
+				return false;
+			}
+			skipWhitespace(text, pos);
+			if (pos >= text.size() || text[pos] != ':')
+			{
+				error = "expected ':' after " + name;
+				return false;
+			}
+			++pos;
+			skipWhitespace(text, pos);
+
+			if (pos < text.size() && text[pos] == '"')
+			{
+				std::string value;
+				if (!parseString(text, pos, value))
+				{
+					error = "unterminated string in " + name;
+					return false;
+				}
+				result.strings[name] = value;
+			}
+			else
+			{
+				const char* start = text.c_str() + pos;
+				char* end = NULL;
+				double value = strtod(start, &end);
+				if (end == start)
+				{
+					error = "expected a string or number for " + name;
+					return false;
+				}
+				pos += end - start;
+				result.numbers[name] = value;
+			}
+
+			skipWhitespace(text, pos);
+			if (pos < text.size() && text[pos] == ',')
+				++pos;
+		}
+
+		// the key members identify the configuration in both files
+		std::string key;
+		for (std::vector<std::string>::const_iterator itr = keys.begin(); itr != keys.end(); ++itr)
+		{
+			std::ostringstream value;
+			if (result.strings.count(*itr))
+				value << result.strings[*itr];
+			else if (result.numbers.count(*itr))
+				value << result.numbers[*itr];
+			else
+				value << "?";
+			key += (key.empty() ? "" : " ") + *itr + "=" + value.str();
+		}
+		results[key] = result;
+
+		skipWhitespace(text, pos);
+		if (pos < text.size() && text[pos] == ',')
+			++pos;
+	}
+}
+
+bool readResults(const std::string& fileName, const std::vector<std::string>& keys, Results& results)
+{
+	std::ifstream file(fileName.c_str());
+	if (!file)
+	{
+		std::cout << "Error could not open " << fileName << std::endl;
+		return false;
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string error;
+	if (!parseResults(text.str(), keys, results, error))
+	{
+		std::cout << "Error could not parse " << fileName << ": " << error << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+	return items;
+}
+
+// reads --name <value>, returns false if the option is not given
+bool readOption(std::vector<std::string>& arguments, const std::string& name, std::string& value)
+{
+	std::vector<std::string>::iterator itr = std::find(arguments.begin(), arguments.end(), name);
+	if (itr == arguments.end() || itr + 1 == arguments.end())
+		return false;
+
+	value = *(itr + 1);
+	arguments.erase(itr, itr + 2);
+	return true;
+}
+
+bool readOption(std::vector<std::string>& arguments, const std::string& name, double& value)
+{
+	std::string text;
+	if (!readOption(arguments, name, text))
+		return false;
+
+	value = atof(text.c_str());
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> arguments(argv + 1, argv + argc);
+
+	std::string keyList = "technique,size,seed";
+	readOption(arguments, "--key", keyList);
+	double noiseFactor = 3.0;
+	readOption(arguments, "--noise-factor", noiseFactor);
+
+	std::vector<Metric> metrics(3);
+	metrics[0].name = "frame_ms";
+	metrics[0].deviation = "frame_ms_mad";
+	metrics[0].unit = "ms";
+	metrics[0].tolerance = 0.05;
+	readOption(arguments, "--frame-tolerance", metrics[0].tolerance);
+	metrics[1].name = "rebuild_ms";
+	metrics[1].deviation = "rebuild_ms_mad";
+	metrics[1].unit = "ms";
+	metrics[1].tolerance = 0.10;
+	readOption(arguments, "--rebuild-tolerance", metrics[1].tolerance);
+	metrics[2].name = "resident_bytes";
+	metrics[2].deviation = "resident_bytes_mad";
+	metrics[2].unit = "bytes";
+	metrics[2].tolerance = 0.05;
+	readOption(arguments, "--memory-tolerance", metrics[2].tolerance);
+
+	if (arguments.size() != 2)
+	{
+		std::cout << "Usage: PerfCompare <baseline.json> <run.json> [options]" << std::endl;
+		std::cout << "--key <a,b,...>             members that identify a configuration, technique,size,seed by default" << std::endl;
+		std::cout << "--frame-tolerance <f>       tolerated relative increase of frame_ms, 0.05 by default" << std::endl;
+		std::cout << "--rebuild-tolerance <f>     tolerated relative increase of rebuild_ms, 0.10 by default" << std::endl;
+		std::cout << "--memory-tolerance <f>      tolerated relative increase of resident_bytes, 0.05 by default" << std::endl;
+		std::cout << "--noise-factor <f>          multiple of the median absolute deviation that is tolerated on top, 3 by default" << std::endl;
+		return 2;
+	}
+
+	std::vector<std::string> keys = splitList(keyList);
+	Results baseline, run;
+	if (!readResults(arguments[0], keys, baseline) || !readResults(arguments[1], keys, run))
+		return 2;
+
+	unsigned int numRegressions = 0;
+	unsigned int numCompared = 0;
+	std::cout << "Comparing " << arguments[1] << " against the baseline " << arguments[0] << std::endl << std::endl;
+	for (Results::const_iterator itr = run.begin(); itr != run.end(); ++itr)
+	{
+		Results::const_iterator base = baseline.find(itr->first);
+		if (base == baseline.end())
+		{
+			std::cout << "Warning " << itr->first << " is not in the baseline" << std::endl;
+			continue;
+		}
+
+		++numCompared;
+		std::cout << itr->first << std::endl;
+		for (std::vector<Metric>::const_iterator metric = metrics.begin(); metric != metrics.end(); ++metric)
+		{
+			// negative values mark metrics the benchmark could not measure
+			double baseValue = base->second.getNumber(metric->name, -1.0);
+			double value = itr->second.getNumber(metric->name, -1.0);
+			if (baseValue < 0.0 || value < 0.0)
+				continue;
+
+			double noise = noiseFactor * std::max(base->second.getNumber(metric->deviation, 0.0), itr->second.getNumber(metric->deviation, 0.0));
+			double limit = baseValue * (1.0 + metric->tolerance) + noise;
+			double delta = baseValue > 0.0 ? (value - baseValue) / baseValue * 100.0 : 0.0;
+			bool regressed = value > limit;
+			if (regressed)
+				++numRegressions;
+
+			std::ostringstream line;
+			line.setf(std::ios::fixed);
+			line.precision(metric->unit == "bytes" ? 0 : 3);
+			line << "  " << (regressed ? "REGRESSED " : "ok        ") << metric->name << ": " << baseValue << " -> " << value << " " << metric->unit;
+			line.precision(1);
+			line << " (" << (delta >= 0.0 ? "+" : "") << delta << "%, limit ";
+			line.precision(metric->unit == "bytes" ? 0 : 3);
+			line << limit << ")";
+			std::cout << line.str() << std::endl;
+		}
+	}
+
+	for (Results::const_iterator itr = baseline.begin(); itr != baseline.end(); ++itr)
+	{
+		if (!run.count(itr->first))
+			std::cout << "Warning " << itr->first << " is missing in the run" << std::endl;
+	}
+
+	std::cout << std::endl << numCompared << " configurations compared, " << numRegressions << " regressions" << std::endl;
+	if (numCompared == 0)
+	{
+		std::cout << "Error no configuration of the run is in the baseline" << std::endl;
+		return 2;
+	}
+	return numRegressions ? 1 : 0;
+}
\ No newline at end of file